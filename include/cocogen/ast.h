@@ -49,7 +49,7 @@ enum AttrValueType {
 
 enum PhaseType { PH_subphases, PH_passes };
 
-enum PhaseLeafType { PL_pass, PL_traversal };
+enum PhaseLeafType { PL_pass, PL_traversal, PL_fusion };
 
 typedef struct Config {
     array *phases;
@@ -59,6 +59,62 @@ typedef struct Config {
     array *nodesets;
     array *nodes;
 
+    // array of (struct Rules *), their traversals are in traversals.
+    array *rules;
+
+    // array of (struct Tiles *).
+    array *tiles;
+
+    // Fused traversal groups, computed from the phase tree.
+    array *fusions;
+
+    // Nodes keep track of changes for incremental traversals.
+    bool incremental;
+
+    // Nodes keep a pointer to their parent, implied by incremental.
+    bool parents;
+
+    // Live nodes of every type are kept in an index.
+    bool census;
+
+    // Mutations are logged, so that they can be rolled back.
+    bool journal;
+
+    // Live nodes of every type are counted, so that the phasedriver skips
+    // traversals of absent types.
+    bool presence;
+
+    // Some nodes have computed attributes, implies incremental.
+    bool computed;
+
+    // Some attributes are columns.
+    bool columns;
+
+    // A batch phasedriver runs the phases on many trees in parallel, so the
+    // state of the generated code is thread-local.
+    bool batch;
+
+    // Some phases are cycles, so the changes to the tree are counted.
+    bool cycles;
+
+    // Maximum number of iterations of a cycle phase.
+    int cycle_limit;
+
+    // The tree is written after checkpoint phases, so that the phasedriver
+    // can resume from it.
+    bool checkpoints;
+
+    // Some phases run independent steps on a pool of threads, so the state
+    // of the generated code is thread-local.
+    bool parallel;
+
+    // Visit counts of a profile run, NULL if no profile is given.
+    struct smap_t *profile;
+
+    // Small functions of at most this many lines are defined static inline
+    // in the headers, 0 if none are.
+    int inline_limit;
+
     struct Node *root_node;
     struct Phase *phase_tree;
 
@@ -72,6 +128,9 @@ typedef struct Phase {
     enum PhaseType type;
     bool cycle;
     bool root;
+    bool fuse;
+    bool checkpoint;
+    bool parallel;
 
     array *passes;
     array *subphases;
@@ -84,14 +143,34 @@ typedef struct PhaseLeaf {
     union {
         struct Pass *pass;
         struct Traversal *traversal;
+        struct Fusion *fusion;
     } value;
 } PhaseLeaf;
 
+// Consecutive traversals of a fuse phase that run as a single tree walk.
+typedef struct Fusion {
+    char *id;
+
+    // array of (struct Traversal *), in phase order.
+    array *traversals;
+} Fusion;
+
+// Node types read and written by a pass or traversal, by which the steps of
+// a parallel phase are ordered.
+typedef struct NodeAccess {
+    // array of (char *), names of nodes and nodesets.
+    array *reads;
+    array *writes;
+} NodeAccess;
+
 typedef struct Pass {
     char *id;
     char *info;
     char *func;
 
+    // NULL if the pass may read and write any node.
+    struct NodeAccess *access;
+
     struct NodeCommonInfo *common_info;
 } Pass;
 
@@ -102,9 +181,106 @@ typedef struct Traversal {
 
     array *nodes;
 
+    // Only visit subtrees changed since the previous run.
+    bool incremental;
+
+    // Handlers return the node to store in the parent.
+    bool rewrite;
+
+    // Handlers do not replace nodes.
+    bool readonly;
+
+    // Can be started with trav_start_scoped_<Node>.
+    bool scoped;
+
+    // Rules matched by the generated handlers, NULL if the handlers are
+    // written by the user.
+    struct Rules *rules;
+
+    // NULL if the traversal may read and write any node.
+    struct NodeAccess *access;
+
     struct NodeCommonInfo *common_info;
 } Traversal;
 
+// Rewrite rules which are matched together in a single traversal.
+typedef struct Rules {
+    char *id;
+    char *info;
+
+    // array of (struct Rule *), in order of priority.
+    array *rules;
+
+    // Rewrite traversal running the matcher, shares the id of the rules.
+    struct Traversal *traversal;
+
+    struct NodeCommonInfo *common_info;
+} Rules;
+
+// Tiles covering trees of nodes, in the style of a BURS grammar. The
+// cheapest cover deriving a nonterminal is found by dynamic programming.
+typedef struct Tiles {
+    char *id;
+    char *info;
+
+    // array of (struct Rule *), every rule derives a nonterminal.
+    array *rules;
+
+    // array of (char *), the nonterminals in order of first derivation,
+    // computed when checking the ast.
+    array *nonterminals;
+
+    struct NodeCommonInfo *common_info;
+} Tiles;
+
+typedef struct Rule {
+    char *id;
+    struct Pattern *pattern;
+
+    // Nonterminal derived by a rule of tiles, NULL in rewrite rules.
+    char *nonterminal;
+    uint64_t cost;
+
+    struct NodeCommonInfo *common_info;
+} Rule;
+
+// Matches a node of type 'type' whose fields match the fields of the
+// pattern.
+typedef struct Pattern {
+    char *type;
+
+    // array of (struct PatternField *), NULL if no fields are matched.
+    array *fields;
+
+    // One of these becomes a link to the matched node(set), other NULL after
+    // checking the ast.
+    struct Node *node;
+    struct Nodeset *nodeset;
+
+    // Matches any tree deriving the nonterminal 'type' in tiles, has no
+    // fields.
+    bool nonterminal;
+
+    struct NodeCommonInfo *common_info;
+} Pattern;
+
+typedef struct PatternField {
+    char *id;
+
+    // Pattern of a child or value of an attribute, both NULL to match a NULL
+    // child or attribute. Enum values are parsed as a pattern and become a
+    // value after checking the ast.
+    struct Pattern *pattern;
+    struct AttrValue *value;
+
+    // One of these becomes a link to the matched child or attribute, other
+    // NULL after checking the ast.
+    struct Child *child;
+    struct Attr *attr;
+
+    struct NodeCommonInfo *common_info;
+} PatternField;
+
 typedef struct Enum {
     char *id;
     char *prefix;
@@ -135,6 +311,10 @@ typedef struct Node {
     // array of (struct Attr *)
     array *attrs;
 
+    // array of (struct Attr *), attributes computed on demand and cached in
+    // the node. Moved out of attrs when checking the ast.
+    array *computed;
+
     bool root;
 
     struct NodeCommonInfo *common_info;
@@ -181,6 +361,12 @@ typedef struct Attr {
     char *id;
     struct AttrValue *default_value;
 
+    // Computed by a user function on first access, instead of set.
+    bool computed;
+
+    // Copied to and from arrays of values by the column functions.
+    bool column;
+
     struct NodeCommonInfo *common_info;
 } Attr;
 
@@ -16,6 +16,27 @@
 // Prefix of functions to replace nodes in the AST
 #define REPLACE_NODE_FUNC_PREFIX    "replace_"
 
+// Prefix of functions to set children and attributes of nodes in the AST
+#define SET_FUNC_PREFIX             "set_"
+
+// Prefix of functions to get computed attributes of nodes in the AST
+#define GET_FUNC_PREFIX             "get_"
+
+// Prefix of the user functions computing attributes of nodes in the AST
+#define COMPUTE_FUNC_PREFIX         "compute_"
+
+// Prefix of functions keeping track of the parents of nodes
+#define PARENT_PREFIX               "parent_"
+
+// Prefix of functions indexing the live nodes of every type
+#define CENSUS_PREFIX               "census_"
+
+// Prefix of functions logging mutations of the AST, to roll them back
+#define TX_PREFIX                   "tx_"
+
+// Prefix of functions keeping track of changes for incremental traversals
+#define INCREMENTAL_PREFIX          "incremental_"
+
 // Prefix of functions traversal related functions
 #define TRAV_PREFIX                 "trav_"
 
@@ -31,6 +52,84 @@
 // Prefix of serialization functions
 #define SERIALIZATION_PREFIX        "serialization_"
 
+// Prefix of the functions editing lists of nodes linked to their own type
+#define LIST_PREFIX                 "list_"
+
+// Prefix of the functions copying attributes to and from arrays of values
+#define COLUMN_PREFIX               "column_"
+
+// Prefix of the functions iterating over the nodes of a subtree
+#define CURSOR_PREFIX               "cursor_"
+
+// Prefix of the functions telling which node types occur below others
+#define REACH_PREFIX                "reach_"
+
+// Prefix of the functions on sets of node types
+#define TYPEMASK_PREFIX             "typemask_"
+
+// Prefix of the functions rewriting the tree with rules
+#define RULES_PREFIX                "rules_"
+
+// Prefix of the functions covering trees with tiles
+#define TILES_PREFIX                "tiles_"
+
+// Prefix of the profiling functions of traversals
+#define PROFILE_PREFIX              "trav_profile_"
+
+// Prefix of the functions checking the mandatory children after phases
+#define CONSISTENCY_PREFIX          "consistency_"
+
+// Prefix of the functions keeping track of the node types with live nodes
+#define PRESENCE_PREFIX             "presence_"
+
+// Prefix of the functions reporting the cost of every phase
+#define PHASE_REPORT_PREFIX         "phasedriver_report_"
+
+// ******************** Preprocessor macros ********************
+
+// Macro enabling the visit counters of traversals in the generated code
+#define PROFILE_MACRO               "COCONUT_PROFILE"
+
+// Macro enabling the cycle counters of traversals, implies PROFILE_MACRO
+#define PROFILE_CYCLES_MACRO        "COCONUT_PROFILE_CYCLES"
+
+// Macro telling the compiler which value a switch most likely has
+#define EXPECT_MACRO                "COCONUT_EXPECT"
+
+// Macros marking functions as often or never executed in a profile run
+#define HOT_MACRO                   "COCONUT_HOT"
+#define COLD_MACRO                  "COCONUT_COLD"
+
+// Macro marking the label of a path that was never taken in a profile run
+#define COLD_LABEL_MACRO            "COCONUT_COLD_LABEL"
+
+// Macro enabling the check of the mandatory children after every phase
+#define CONSISTENCY_MACRO           "COCONUT_CONSISTENCY"
+
+// Macro checking only one of every N phases, implies CONSISTENCY_MACRO
+#define CONSISTENCY_SAMPLE_MACRO    "COCONUT_CONSISTENCY_SAMPLE"
+
+// Macro printing the name of every phase and pass when it starts
+#define PHASE_TRACE_MACRO           "COCONUT_PHASE_TRACE"
+
+// Macro enabling the time, memory and node count report of the phasedriver
+#define PHASE_REPORT_MACRO          "COCONUT_PHASE_REPORT"
+
+// Storage class of the state of the generated code, which every thread of
+// the batch phasedriver or of a parallel phase has its own copy of
+#define THREAD_LOCAL_MACRO          "COCONUT_THREAD_LOCAL"
+
+// Macro with the maximum number of iterations of a cycle phase
+#define CYCLE_LIMIT_MACRO           "COCONUT_CYCLE_LIMIT"
+
+// Macro running the steps of parallel phases one by one, checking that every
+// step only changes the node types in its writes
+#define PARALLEL_CHECK_MACRO        "COCONUT_PARALLEL_CHECK"
+
+// Macro with the number of threads of a parallel phase, the number of
+// processors by default
+#define PARALLEL_THREADS_MACRO      "COCONUT_PARALLEL_THREADS"
+
 // ******************** Names of enum types ********************
 
 // Name of the enum type containing all nodes and nodesets
@@ -39,6 +138,15 @@
 // Name of the enum type containing all traversals
 #define TRAV_ENUM_NAME              "TraversalType"
 
+// Name of the enum type containing all children of all nodes
+#define CS_ENUM_NAME                "ChildSlot"
+
+// Name of the enum type containing all phases
+#define PHASE_ENUM_NAME             "PhaseType"
+
+// Name of the enum type telling traversals to continue, skip or abort
+#define TC_ENUM_NAME                "TravControl"
+
 // ******************** Prefix of enum type values ********************
 
 // Prefix of values of the enums of nodesets containing the possible nodes
@@ -50,6 +158,15 @@
 // Prefix of values of the enum type containing all traversals
 #define TRAV_ENUM_PREFIX            "TRAV_"
 
+// Prefix of values of the enum type containing all children of all nodes
+#define CS_ENUM_PREFIX              "CS_"
+
+// Prefix of values of the enum type containing all phases
+#define PHASE_ENUM_PREFIX           "PH_"
+
+// Prefix of values of the enum type telling traversals how to continue
+#define TC_ENUM_PREFIX              "TC_"
+
 // ***************** Format of enum type names and functions *****************
 
 // Format of enum types of nodesets containing all possible nodes
@@ -68,12 +185,53 @@
 // arg1 = traversal identifier
 #define TRAV_FORMAT                 TRAV_ENUM_PREFIX "%s"
 
+// Format of values of the enum type of all children of all nodes
+// arg1 = node identifier, arg2 = child identifier
+#define CS_FORMAT                   CS_ENUM_PREFIX "%s_%s"
+
+// Format of values of the enum type of all phases
+// arg1 = phase identifier
+#define PHASE_FORMAT                PHASE_ENUM_PREFIX "%s"
+
+// Format of identifiers of fused traversals, identifiers in the ast
+// definition cannot start with an underscore.
+// arg1 = index of the fused traversal
+#define FUSION_ID_FORMAT            "_fused%d"
+
 // Format of the node handle functions of a traversal
 // arg1 = traversal identifier, arg2 = node or nodeset identifier
 #define TRAVERSAL_HANDLER_FORMAT    "%s_%s"
 
 #define TRAV_START_FORMAT           TRAV_START_FUNC_PREFIX "%s"
 
+// Format of the actions of rules
+// arg1 = rules identifier, arg2 = rule identifier
+#define RULE_ACTION_FORMAT          "%s_%s"
+
+// Format of functions rewriting a tree with rules until none apply
+// arg1 = rules identifier
+#define RULES_RUN_FORMAT            RULES_PREFIX "run_%s"
+
+// Format of the enum of the nonterminals of tiles
+// arg1 = tiles identifier
+#define TILES_NT_ENUM_FORMAT        "%sNonterminal"
+
+// Format of the nonterminals of tiles
+// arg1 = tiles identifier, arg2 = nonterminal identifier
+#define TILES_NT_FORMAT             "%s_nt_%s"
+
+// Format of functions covering a tree with tiles and reducing it
+// arg1 = tiles identifier, arg2 = node or nodeset identifier
+#define TILES_SELECT_FORMAT         TILES_PREFIX "%s_%s"
+
+// Format of functions to start a traversal limited to some node types
+// arg1 = node identifier
+#define TRAV_START_SCOPED_FORMAT    TRAV_START_FUNC_PREFIX "scoped_%s"
+
+// Format of the child edges used by one kind of traversal
+// arg1 = node identifier, arg2 = child identifier, arg3 = kind
+#define TRAV_EDGE_FORMAT            "_" TRAV_PREFIX "%s_%s_%s"
+
 // Format of functions to create a new node
 // arg1 = node identifier
 #define CREATE_NODE_FORMAT          CREATE_FUNC_PREFIX "%s"
@@ -90,6 +248,29 @@
 // arg1 = node identifier
 #define REPLACE_NODE_FORMAT         REPLACE_NODE_FUNC_PREFIX "%s"
 
+// Format of functions to set a child or attribute of a node
+// arg1 = node identifier, arg2 = child or attribute identifier
+#define SET_FIELD_FORMAT            SET_FUNC_PREFIX "%s_%s"
+
+// Format of functions to get a computed attribute, and of the user functions
+// computing it
+// arg1 = node identifier, arg2 = attribute identifier
+#define GET_FIELD_FORMAT            GET_FUNC_PREFIX "%s_%s"
+#define COMPUTE_FIELD_FORMAT        COMPUTE_FUNC_PREFIX "%s_%s"
+
+// Format of the member holding the epoch in which a computed attribute was
+// cached, identifiers in the ast definition cannot start with an underscore.
+// arg1 = attribute identifier
+#define COMPUTED_EPOCH_FORMAT       "_%s_epoch"
+
+// Format of functions to edit a list of nodes linked by a child
+// arg1 = node identifier, arg2 = child identifier, arg3 = operation
+#define LIST_FORMAT                 LIST_PREFIX "%s_%s_%s"
+
+// Format of functions to copy an attribute to or from an array of values
+// arg1 = node identifier, arg2 = attribute identifier, arg3 = operation
+#define COLUMN_FORMAT               COLUMN_PREFIX "%s_%s_%s"
+
 // Formats of functions to free a subtree or only the node
 // arg1 = node identifier
 #define FREE_TREE_FORMAT            FREE_FUNC_PREFIX "%s_tree"
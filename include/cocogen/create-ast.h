@@ -6,12 +6,29 @@
 #include <stdint.h>
 
 Config *create_config(array *phases, array *passes, array *traversals,
-                      array *attr_enums, array *nodesets, array *nodes);
+                      array *attr_enums, array *nodesets, array *nodes,
+                      array *rules, array *tiles);
 
 Pass *create_pass(char *id, char *func);
 
+NodeAccess *create_node_access(array *reads, array *writes);
+
 Traversal *create_traversal(char *id, char *func, array *nodes);
 
+Rules *create_rules(char *id, array *rules);
+
+Rule *create_rule(char *id, Pattern *pattern);
+
+Tiles *create_tiles(char *id, array *rules);
+
+Rule *create_tile(char *id, char *nonterminal, Pattern *pattern,
+                  uint64_t cost);
+
+Pattern *create_pattern(char *type, array *fields);
+
+PatternField *create_patternfield(char *id, Pattern *pattern,
+                                  AttrValue *value);
+
 Phase *create_phase_header(char *id, bool root, bool cycle);
 
 Phase *create_phase(Phase *phase_header, array *phases, array *passes);
@@ -12,6 +12,10 @@ void filegen_all_nodesets(char *fileformatter,
 
 void filegen_all_traversals(char *fileformatter,
                             void (*func)(Config *, FILE *, Traversal *));
+void filegen_all_rules(char *fileformatter,
+                       void (*func)(Config *, FILE *, Rules *));
+void filegen_all_tiles(char *fileformatter,
+                       void (*func)(Config *, FILE *, Tiles *));
 void filegen_all_passes(char *fileformatter,
                         void (*func)(Config *, FILE *, Pass *));
 
@@ -2,8 +2,24 @@
 
 #include "cocogen/ast.h"
 #include "cocogen/config.h"
+#include <stdbool.h>
 #include <stdio.h>
 
 #define out(...) fprintf(fp, __VA_ARGS__)
 
 void generate_node_header_includes(Config *, FILE *, Node *);
+void out_child_node(FILE *, char *, Child *);
+void out_track_includes(Config *, FILE *);
+void out_track_init(Config *, FILE *, char *, char *, Node *);
+void out_journal(Config *, FILE *, char *, char *, char *);
+void out_count_change(Config *, FILE *, char *);
+char *out_thread_local(Config *);
+char *out_epoch(Config *);
+char *out_epoch_advance(Config *);
+void out_track_child(Config *, FILE *, char *, char *, Node *, Child *);
+FILE *out_measure_start(void);
+int out_measure_end(FILE *);
+bool out_inline(Config *, int);
+char *out_format(const char *, ...);
+char *out_attr_literal(Config *, Attr *, AttrValue *);
+char *out_attr_cond(Config *, PatternField *, char *);
@@ -0,0 +1,4 @@
+#pragma once
+
+void generate_census_header(Config *config, FILE *fp);
+void generate_census_definitions(Config *config, FILE *fp);
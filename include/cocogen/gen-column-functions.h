@@ -0,0 +1,4 @@
+#pragma once
+
+void generate_column_header(Config *config, FILE *fp);
+void generate_column_definitions(Config *config, FILE *fp);
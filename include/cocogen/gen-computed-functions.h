@@ -0,0 +1,4 @@
+#pragma once
+
+void generate_computed_header(Config *config, FILE *fp);
+void generate_computed_definitions(Config *config, FILE *fp);
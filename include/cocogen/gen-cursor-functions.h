@@ -0,0 +1,4 @@
+#pragma once
+
+void generate_cursor_header(Config *config, FILE *fp);
+void generate_cursor_definitions(Config *config, FILE *fp);
@@ -0,0 +1,4 @@
+#pragma once
+
+void generate_incremental_header(Config *config, FILE *fp);
+void generate_incremental_definitions(Config *config, FILE *fp);
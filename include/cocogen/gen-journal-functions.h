@@ -0,0 +1,4 @@
+#pragma once
+
+void generate_journal_header(Config *config, FILE *fp);
+void generate_journal_definitions(Config *config, FILE *fp);
@@ -0,0 +1,5 @@
+#pragma once
+
+void generate_mutate_header(Config *config, FILE *fp);
+void generate_mutate_node_header(Config *config, FILE *fp, Node *node);
+void generate_mutate_node_definitions(Config *config, FILE *fp, Node *node);
@@ -0,0 +1,4 @@
+#pragma once
+
+void generate_parent_header(Config *config, FILE *fp);
+void generate_parent_definitions(Config *config, FILE *fp);
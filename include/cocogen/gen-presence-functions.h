@@ -0,0 +1,4 @@
+#pragma once
+
+void generate_presence_header(Config *config, FILE *fp);
+void generate_presence_definitions(Config *config, FILE *fp);
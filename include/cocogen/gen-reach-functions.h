@@ -0,0 +1,4 @@
+#pragma once
+
+void generate_reach_header(Config *config, FILE *fp);
+void generate_reach_definitions(Config *config, FILE *fp);
@@ -0,0 +1,5 @@
+#pragma once
+#include "cocogen/ast.h"
+#include <stdio.h>
+
+void generate_rules_definitions(Config *config, FILE *fp, Rules *rules);
@@ -0,0 +1,6 @@
+#pragma once
+#include "cocogen/ast.h"
+#include <stdio.h>
+
+void generate_tiles_header(Config *config, FILE *fp, Tiles *tiles);
+void generate_tiles_definitions(Config *config, FILE *fp, Tiles *tiles);
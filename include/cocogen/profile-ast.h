@@ -0,0 +1,7 @@
+#pragma once
+
+#include "cocogen/ast.h"
+
+void profile_config(Config *config, char *filename);
+long profile_visits(Config *config, char *traversal, char *node);
+long profile_node_visits(Config *config, char *node);
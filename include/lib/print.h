@@ -35,6 +35,13 @@ enum PrintType { PT_error, PT_warning, PT_note };
 
 void print_user_error(char *header, const char *format, ...);
 
+// Print the messages of print_user_error in the calling thread to 'fp', or
+// to stderr if 'fp' is NULL.
+void print_user_stream(FILE *fp);
+
+// Number of messages printed by print_user_error in the calling thread.
+int print_user_errors(void);
+
 void print_init_compilation_messages(char *header, char *filename,
                                      array *lines, imap_t *parser_locations);
 
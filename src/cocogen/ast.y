@@ -23,6 +23,8 @@ static array *config_enums;
 static array *config_traversals;
 static array *config_nodesets;
 static array *config_nodes;
+static array *config_rules;
+static array *config_tiles;
 
 static struct Config* parse_result = NULL;
 
@@ -69,6 +71,12 @@ static void new_location(void *ptr, struct ParserLocation *loc);
     struct Phase *phase;
     struct Pass *pass;
     struct Traversal *traversal;
+    struct NodeAccess *access;
+    struct Rules *rules;
+    struct Tiles *tiles;
+    struct Rule *rule;
+    struct Pattern *pattern;
+    struct PatternField *patternfield;
     struct Enum *attr_enum;
     struct Nodeset *nodeset;
     struct Node *node;
@@ -109,7 +117,13 @@ static void new_location(void *ptr, struct ParserLocation *loc);
 %token T_ATTRIBUTES "attributes"
 %token T_CHILDREN "children"
 %token T_CONSTRUCTOR "construct"
+%token T_COMPUTED "computed"
+%token T_COLUMN "column"
 %token T_CYCLE "cycle"
+%token T_CHECKPOINT "checkpoint"
+%token T_PARALLEL "parallel"
+%token T_READS "reads"
+%token T_WRITES "writes"
 %token T_ENUM "enum"
 %token T_MANDATORY "mandatory"
 %token T_NODE "node"
@@ -121,8 +135,17 @@ static void new_location(void *ptr, struct ParserLocation *loc);
 %token T_PHASES "phases"
 %token T_PREFIX "prefix"
 %token T_INFO "info"
+%token T_INCREMENTAL "incremental"
+%token T_REWRITE "rewrite"
+%token T_READONLY "readonly"
+%token T_SCOPED "scoped"
 %token T_FUNC "func"
+%token T_FUSE "fuse"
 %token T_ROOT "root"
+%token T_RULE "rule"
+%token T_RULES "rules"
+%token T_TILES "tiles"
+%token T_COST "cost"
 %token T_SUBPHASES "subphases"
 %token T_TO "to"
 %token T_TRAVERSAL "traversal"
@@ -136,8 +159,10 @@ static void new_location(void *ptr, struct ParserLocation *loc);
 %type<string> info func
 %type<array> idlist mandatoryarglist mandatory
              attrlist attrs childlist children enumvalues traversalnodes
+             readset writeset
+             rulelist tilelist patternfields
 %type<mandatoryphase> mandatoryarg
-%type<attrval> attrval
+%type<attrval> attrval patternvalue
 %type<attrtype> attrprimitivetype
 %type<attr> attr attrhead
 %type<child> child
@@ -147,6 +172,12 @@ static void new_location(void *ptr, struct ParserLocation *loc);
 %type<phase> phase phaseheader
 %type<attr_enum> enum
 %type<traversal> traversal
+%type<access> access accessopt
+%type<rules> rules
+%type<tiles> tiles
+%type<rule> rule tile
+%type<pattern> pattern
+%type<patternfield> patternfield
 %type<config> root
 
 %start root
@@ -159,7 +190,9 @@ root: entry { parse_result = create_config(config_phases,
                                  config_traversals,
                                  config_enums,
                                  config_nodesets,
-                                 config_nodes); }
+                                 config_nodes,
+                                 config_rules,
+                                 config_tiles); }
     ;
 
 /* For every entry in the config, append to the correct array. */
@@ -169,6 +202,12 @@ entry: entry phase { array_append(config_phases, $2); }
      | entry enum { array_append(config_enums, $2); }
      | entry nodeset { array_append(config_nodesets, $2); }
      | entry node { array_append(config_nodes, $2);  }
+     | entry rules
+     {
+         array_append(config_rules, $2);
+         array_append(config_traversals, $2->traversal);
+     }
+     | entry tiles { array_append(config_tiles, $2); }
      | %empty
      ;
 
@@ -198,45 +237,67 @@ phaseheader: T_PHASE T_ID
                new_location($$, &@$);
                new_location($2, &@2);
            }
-           | T_CYCLE T_PHASE T_ID
+           | T_ROOT phaseheader
+           {
+               $$ = $2;
+               $$->root = true;
+               new_location($$, &@$);
+           }
+           | T_CYCLE phaseheader
            {
-               $$ = create_phase_header($3, false, true);
+               $$ = $2;
+               $$->cycle = true;
                new_location($$, &@$);
-               new_location($3, &@3);
            }
-           | T_ROOT T_PHASE T_ID
+           | T_FUSE phaseheader
            {
-               $$ = create_phase_header($3, true, false);
+               $$ = $2;
+               $$->fuse = true;
                new_location($$, &@$);
-               new_location($3, &@3);
            }
-           | T_ROOT T_CYCLE T_PHASE T_ID
+           | T_CHECKPOINT phaseheader
            {
-               $$ = create_phase_header($4, true, true);
+               $$ = $2;
+               $$->checkpoint = true;
+               new_location($$, &@$);
+           }
+           | T_PARALLEL phaseheader
+           {
+               $$ = $2;
+               $$->parallel = true;
                new_location($$, &@$);
-               new_location($4, &@4);
            }
            ;
 
-pass: T_PASS T_ID '{' T_FUNC '=' T_ID '}' semicolon
+pass: T_PASS T_ID '{' T_FUNC '=' T_ID accessopt '}' semicolon
     {
         $$ = create_pass($2, $6);
+        $$->access = $7;
         new_location($$, &@$);
         new_location($2, &@2);
         new_location($6, &@6);
     }
-    | T_PASS T_ID '{' info ',' T_FUNC '=' T_ID '}' semicolon
+    | T_PASS T_ID '{' info ',' T_FUNC '=' T_ID accessopt '}' semicolon
     {
         $$ = create_pass($2, $8);
         $$->info = $4;
+        $$->access = $9;
         new_location($$, &@$);
         new_location($2, &@2);
         new_location($8, &@8);
     }
-    | T_PASS T_ID '{' info '}' semicolon
+    | T_PASS T_ID '{' info accessopt '}' semicolon
     {
         $$ = create_pass($2, NULL);
         $$->info = $4;
+        $$->access = $5;
+        new_location($$, &@$);
+        new_location($2, &@2);
+    }
+    | T_PASS T_ID '{' access '}' semicolon
+    {
+        $$ = create_pass($2, NULL);
+        $$->access = $4;
         new_location($$, &@$);
         new_location($2, &@2);
     }
@@ -255,54 +316,249 @@ traversal: T_TRAVERSAL T_ID ';'
              new_location($$, &@$);
              new_location($2, &@2);
          }
-         | T_TRAVERSAL T_ID '{' func '}' semicolon
+         | T_TRAVERSAL T_ID '{' func accessopt '}' semicolon
          {
              $$ = create_traversal($2, $4, NULL);
+             $$->access = $5;
              new_location($$, &@$);
              new_location($2, &@2);
          }
-         | T_TRAVERSAL T_ID '{' func ',' traversalnodes '}' semicolon
+         | T_TRAVERSAL T_ID '{' func ',' traversalnodes accessopt '}'
+           semicolon
          {
              $$ = create_traversal($2, $4, $6);
+             $$->access = $7;
              new_location($$, &@$);
              new_location($2, &@2);
          }
-         | T_TRAVERSAL T_ID '{' traversalnodes '}' semicolon
+         | T_TRAVERSAL T_ID '{' traversalnodes accessopt '}' semicolon
          {
              $$ = create_traversal($2, NULL, $4);
+             $$->access = $5;
              new_location($$, &@$);
              new_location($2, &@2);
          }
-         | T_TRAVERSAL T_ID '{' info '}' semicolon
+         | T_TRAVERSAL T_ID '{' info accessopt '}' semicolon
          {
              $$ = create_traversal($2, NULL, NULL);
              $$->info = $4;
+             $$->access = $5;
              new_location($$, &@$);
              new_location($2, &@2);
          }
-         | T_TRAVERSAL T_ID '{' info ',' func '}' semicolon
+         | T_TRAVERSAL T_ID '{' info ',' func accessopt '}' semicolon
          {
              $$ = create_traversal($2, $6, NULL);
              $$->info = $4;
+             $$->access = $7;
              new_location($$, &@$);
              new_location($2, &@2);
          }
-         | T_TRAVERSAL T_ID '{' info ',' func ',' traversalnodes '}' semicolon
+         | T_TRAVERSAL T_ID '{' info ',' func ',' traversalnodes accessopt '}'
+           semicolon
          {
              $$ = create_traversal($2, $6, $8);
              $$->info = $4;
+             $$->access = $9;
              new_location($$, &@$);
              new_location($2, &@2);
          }
-         | T_TRAVERSAL T_ID '{' info ',' traversalnodes '}' semicolon
+         | T_TRAVERSAL T_ID '{' info ',' traversalnodes accessopt '}'
+           semicolon
          {
              $$ = create_traversal($2, NULL, $6);
              $$->info = $4;
+             $$->access = $7;
+             new_location($$, &@$);
+             new_location($2, &@2);
+         }
+         | T_TRAVERSAL T_ID '{' access '}' semicolon
+         {
+             $$ = create_traversal($2, NULL, NULL);
+             $$->access = $4;
              new_location($$, &@$);
              new_location($2, &@2);
          }
+         | T_INCREMENTAL traversal
+         {
+             $$ = $2;
+             $$->incremental = true;
+             new_location($$, &@$);
+         }
+         | T_REWRITE traversal
+         {
+             $$ = $2;
+             $$->rewrite = true;
+             new_location($$, &@$);
+         }
+         | T_READONLY traversal
+         {
+             $$ = $2;
+             $$->readonly = true;
+             new_location($$, &@$);
+         }
+         | T_SCOPED traversal
+         {
+             $$ = $2;
+             $$->scoped = true;
+             new_location($$, &@$);
+         }
          ;
 
+rules: T_RULES T_ID '{' rulelist '}' semicolon
+     {
+         $$ = create_rules($2, $4);
+         new_location($$, &@$);
+         new_location($$->traversal, &@$);
+         new_location($2, &@2);
+     }
+     | T_RULES T_ID '{' info ',' rulelist '}' semicolon
+     {
+         $$ = create_rules($2, $6);
+         $$->info = $4;
+         $$->traversal->info = $4;
+         new_location($$, &@$);
+         new_location($$->traversal, &@$);
+         new_location($2, &@2);
+     }
+     ;
+
+rulelist: rulelist ',' rule
+        {
+            array_append($1, $3);
+            $$ = $1;
+            // $$ is an array and should not be in the locations list
+        }
+        | rule
+        {
+            array *tmp = create_array();
+            array_append(tmp, $1);
+            $$ = tmp;
+            // $$ is an array and should not be in the locations list
+        }
+        ;
+
+rule: T_RULE T_ID '=' pattern
+    {
+        $$ = create_rule($2, $4);
+        new_location($$, &@$);
+        new_location($2, &@2);
+    }
+    ;
+
+tiles: T_TILES T_ID '{' tilelist '}' semicolon
+     {
+         $$ = create_tiles($2, $4);
+         new_location($$, &@$);
+         new_location($2, &@2);
+     }
+     | T_TILES T_ID '{' info ',' tilelist '}' semicolon
+     {
+         $$ = create_tiles($2, $6);
+         $$->info = $4;
+         new_location($$, &@$);
+         new_location($2, &@2);
+     }
+     ;
+
+tilelist: tilelist ',' tile
+        {
+            array_append($1, $3);
+            $$ = $1;
+            // $$ is an array and should not be in the locations list
+        }
+        | tile
+        {
+            array *tmp = create_array();
+            array_append(tmp, $1);
+            $$ = tmp;
+            // $$ is an array and should not be in the locations list
+        }
+        ;
+
+/* Rule deriving a nonterminal, the cost defaults to zero. */
+tile: T_RULE T_ID ':' T_ID '=' pattern
+    {
+        $$ = create_tile($2, $4, $6, 0);
+        new_location($$, &@$);
+        new_location($2, &@2);
+        new_location($4, &@4);
+    }
+    | T_RULE T_ID ':' T_ID '=' pattern T_COST T_UINTVAL
+    {
+        $$ = create_tile($2, $4, $6, $8);
+        new_location($$, &@$);
+        new_location($2, &@2);
+        new_location($4, &@4);
+    }
+    ;
+
+/* Node type with optional patterns of its children and attributes. */
+pattern: T_ID
+       {
+           $$ = create_pattern($1, NULL);
+           new_location($$, &@$);
+           new_location($1, &@1);
+       }
+       | T_ID '(' patternfields ')'
+       {
+           $$ = create_pattern($1, $3);
+           new_location($$, &@$);
+           new_location($1, &@1);
+       }
+       ;
+
+patternfields: patternfields ',' patternfield
+             {
+                 array_append($1, $3);
+                 $$ = $1;
+                 // $$ is an array and should not be in the locations list
+             }
+             | patternfield
+             {
+                 array *tmp = create_array();
+                 array_append(tmp, $1);
+                 $$ = tmp;
+                 // $$ is an array and should not be in the locations list
+             }
+             ;
+
+patternfield: T_ID '=' pattern
+            {
+                $$ = create_patternfield($1, $3, NULL);
+                new_location($$, &@$);
+                new_location($1, &@1);
+            }
+            | T_ID '=' patternvalue
+            {
+                $$ = create_patternfield($1, NULL, $3);
+                new_location($$, &@$);
+                new_location($1, &@1);
+                new_location($3, &@3);
+            }
+            | T_ID '=' T_NULL
+            {
+                $$ = create_patternfield($1, NULL, NULL);
+                new_location($$, &@$);
+                new_location($1, &@1);
+            }
+            ;
+
+/* Attribute values, enum values are parsed as patterns. */
+patternvalue: T_STRINGVAL
+            { $$ = create_attrval_string($1); }
+            | T_INTVAL
+            { $$ = create_attrval_int($1); }
+            | T_UINTVAL
+            { $$ = create_attrval_uint($1); }
+            | T_FLOATVAL
+            { $$ = create_attrval_float($1); }
+            | T_TRUE
+            { $$ = create_attrval_bool(true); }
+            | T_FALSE
+            { $$ = create_attrval_bool(false); }
+            ;
+
 func: T_FUNC '=' T_ID
     {
         $$ = $3;
@@ -314,6 +570,52 @@ traversalnodes: T_NODES '{' idlist '}'
                   $$ = $3;
               }
 
+/* Node types read and written by a pass or traversal, an empty set is
+ * declared with empty braces. */
+access: readset
+      {
+          $$ = create_node_access($1, create_array());
+      }
+      | writeset
+      {
+          $$ = create_node_access(create_array(), $1);
+      }
+      | readset ',' writeset
+      {
+          $$ = create_node_access($1, $3);
+      }
+      ;
+
+readset: T_READS '{' idlist '}'
+       {
+           $$ = $3;
+       }
+       | T_READS '{' '}'
+       {
+           $$ = create_array();
+       }
+       ;
+
+writeset: T_WRITES '{' idlist '}'
+        {
+            $$ = $3;
+        }
+        | T_WRITES '{' '}'
+        {
+            $$ = create_array();
+        }
+        ;
+
+accessopt: ',' access
+         {
+             $$ = $2;
+         }
+         | %empty
+         {
+             $$ = NULL;
+         }
+         ;
+
 enum: T_ENUM T_ID '{' T_PREFIX '=' T_ID ',' enumvalues '}' semicolon
     {
         $$ = create_enum($2, $6, $8);
@@ -507,6 +809,30 @@ attr: attrhead '{' T_CONSTRUCTOR '}'
         $$ = create_attr($1, $3, 0);
         new_location($$, &@$);
     }
+    | attrhead '{' T_COMPUTED '}'
+    {
+        $$ = create_attr($1, NULL, 0);
+        $$->computed = true;
+        new_location($$, &@$);
+    }
+    | attrhead '{' T_COLUMN '}'
+    {
+        $$ = create_attr($1, NULL, 0);
+        $$->column = true;
+        new_location($$, &@$);
+    }
+    | attrhead '{' T_CONSTRUCTOR ',' T_COLUMN '}'
+    {
+        $$ = create_attr($1, NULL, 1);
+        $$->column = true;
+        new_location($$, &@$);
+    }
+    | attrhead '=' attrval '{' T_COLUMN '}'
+    {
+        $$ = create_attr($1, $3, 0);
+        $$->column = true;
+        new_location($$, &@$);
+    }
     ;
 /* Optional [construct] keyword, for adding to constructor. */
 attrhead: attrprimitivetype T_ID
@@ -653,6 +979,8 @@ struct Config* parse(FILE *fp) {
     config_traversals = create_array();
     config_nodesets = create_array();
     config_nodes = create_array();
+    config_rules = create_array();
+    config_tiles = create_array();
 
     yy_lines = array_init(32);
     yy_parser_locations = imap_init(128);
@@ -5,6 +5,7 @@
 
 #include "cocogen/ast.h"
 #include "cocogen/check-ast.h"
+#include "cocogen/create-ast.h"
 
 #include "lib/array.h"
 #include "lib/memory.h"
@@ -19,6 +20,7 @@ struct Info {
     smap_t *traversal_name;
     smap_t *phase_name;
     smap_t *pass_name;
+    smap_t *tiles_name;
 
     Node *root_node;
     Phase *root_phase;
@@ -35,6 +37,7 @@ static struct Info *create_info(void) {
     info->traversal_name = smap_init(32);
     info->phase_name = smap_init(32);
     info->pass_name = smap_init(32);
+    info->tiles_name = smap_init(32);
 
     info->root_node = NULL;
     info->root_phase = NULL;
@@ -49,6 +52,7 @@ static void free_info(struct Info *info) {
     smap_free(info->traversal_name);
     smap_free(info->phase_name);
     smap_free(info->pass_name);
+    smap_free(info->tiles_name);
     mem_free(info);
 }
 
@@ -59,6 +63,7 @@ static void *check_name_exists(struct Info *info, char *name) {
     Traversal *traversal_orig;
     Phase *phase_orig;
     Pass *pass_orig;
+    Tiles *tiles_orig;
 
     if ((enum_orig = smap_retrieve(info->enum_name, name)) != NULL)
         return enum_orig->id;
@@ -72,6 +77,8 @@ static void *check_name_exists(struct Info *info, char *name) {
         return phase_orig->id;
     if ((pass_orig = smap_retrieve(info->pass_name, name)) != NULL)
         return pass_orig->id;
+    if ((tiles_orig = smap_retrieve(info->tiles_name, name)) != NULL)
+        return tiles_orig->id;
     return NULL;
 }
 
@@ -216,6 +223,13 @@ static int check_traversals(array *traversals, struct Info *info) {
             smap_insert(info->traversal_name, cur_traversal->id,
                         cur_traversal);
         }
+
+        if (cur_traversal->readonly && cur_traversal->rewrite) {
+            print_error(cur_traversal->id,
+                        "Traversal '%s' cannot be both readonly and rewrite",
+                        cur_traversal->id);
+            error = 1;
+        }
     }
     return error;
 }
@@ -343,6 +357,38 @@ static int check_node(Node *node, struct Info *info) {
                     error = 1;
                 }
             }
+
+            // The values of a column are copied, which does not work for
+            // the owned strings and the links to other nodes.
+            if (attr->column &&
+                (attr->type == AT_string || attr->type == AT_link)) {
+                print_error(attr->id,
+                            "Column attribute '%s' of node '%s' cannot be a "
+                            "string or a node",
+                            attr->id, node->id);
+                error = 1;
+            }
+        }
+
+        // Computed attributes are not set by the generated functions, so
+        // they are kept apart from the attributes.
+        array *attrs = create_array();
+        for (int i = 0; i < array_size(node->attrs); i++) {
+            Attr *attr = array_get(node->attrs, i);
+            if (!attr->computed) {
+                array_append(attrs, attr);
+                continue;
+            }
+
+            if (node->computed == NULL)
+                node->computed = create_array();
+            array_append(node->computed, attr);
+        }
+        array_cleanup(node->attrs, NULL);
+        node->attrs = attrs;
+        if (array_size(attrs) == 0) {
+            array_cleanup(attrs, NULL);
+            node->attrs = NULL;
         }
     }
 
@@ -485,12 +531,430 @@ static int check_traversal(Traversal *traversal, struct Info *info) {
     return error;
 }
 
+static bool attr_value_matches(Attr *attr, AttrValue *value) {
+    switch (attr->type) {
+    case AT_string:
+        return value->type == AV_string;
+    case AT_bool:
+        return value->type == AV_bool;
+    case AT_float:
+    case AT_double:
+        return value->type != AV_string && value->type != AV_bool &&
+               value->type != AV_id;
+    case AT_link:
+    case AT_enum:
+    case AT_link_or_enum:
+        return false;
+    default:
+        return value->type == AV_int || value->type == AV_uint;
+    }
+}
+
+static int check_pattern(Pattern *pattern, Rule *rule, smap_t *nonterminals,
+                         struct Info *info);
+
+// Enum values are parsed as patterns without fields, which become a value of
+// the attribute.
+static int check_pattern_enum_value(PatternField *field, Node *node,
+                                    struct Info *info) {
+    Pattern *pattern = field->pattern;
+    Attr *attr = field->attr;
+
+    if (attr->type != AT_enum || pattern->fields != NULL) {
+        print_error(pattern->type,
+                    "Attribute '%s' of node '%s' cannot be matched by a "
+                    "pattern",
+                    attr->id, node->id);
+        return 1;
+    }
+
+    Enum *attr_enum = smap_retrieve(info->enum_name, attr->type_id);
+    bool found = false;
+    for (int i = 0; i < array_size(attr_enum->values); i++) {
+        if (strcmp(array_get(attr_enum->values, i), pattern->type) == 0)
+            found = true;
+    }
+
+    if (!found) {
+        print_error(pattern->type, "Unknown value '%s' of enum '%s'",
+                    pattern->type, attr_enum->id);
+        return 1;
+    }
+
+    field->value = create_attrval_id(pattern->type);
+    field->pattern = NULL;
+    mem_free(pattern->common_info);
+    mem_free(pattern);
+    return 0;
+}
+
+static bool nodeset_contains(Nodeset *nodeset, Node *node) {
+    for (int i = 0; i < array_size(nodeset->nodes); i++) {
+        if (array_get(nodeset->nodes, i) == node)
+            return true;
+    }
+    return false;
+}
+
+static int check_pattern_child(PatternField *field, Node *node, Rule *rule,
+                               smap_t *nonterminals, struct Info *info) {
+    Child *child = field->child;
+    Pattern *pattern = field->pattern;
+
+    if (field->value != NULL) {
+        print_error(field->id,
+                    "Child '%s' of node '%s' can only be matched by a pattern "
+                    "or NULL in rule '%s'",
+                    child->id, node->id, rule->id);
+        return 1;
+    }
+
+    if (pattern == NULL)
+        return 0;
+
+    if (check_pattern(pattern, rule, nonterminals, info))
+        return 1;
+
+    // The labeler decides which trees derive a nonterminal.
+    if (pattern->nonterminal)
+        return 0;
+
+    bool in_nodeset = pattern->nodeset == child->nodeset ||
+                      (pattern->node && child->nodeset &&
+                       nodeset_contains(child->nodeset, pattern->node));
+
+    if ((child->node && pattern->node != child->node) ||
+        (child->nodeset && !in_nodeset)) {
+        print_error(pattern->type,
+                    "Type '%s' cannot occur in child '%s' of node '%s'",
+                    pattern->type, child->id, node->id);
+        return 1;
+    }
+    return 0;
+}
+
+static int check_pattern_attr(PatternField *field, Node *node,
+                              struct Info *info) {
+    Attr *attr = field->attr;
+
+    if (field->pattern != NULL)
+        return check_pattern_enum_value(field, node, info);
+
+    if (field->value == NULL) {
+        if (attr->type != AT_string && attr->type != AT_link) {
+            print_error(field->id,
+                        "Attribute '%s' of node '%s' cannot be NULL",
+                        attr->id, node->id);
+            return 1;
+        }
+    } else if (!attr_value_matches(attr, field->value)) {
+        print_error(field->id,
+                    "Value of attribute '%s' of node '%s' does not match "
+                    "its type",
+                    attr->id, node->id);
+        return 1;
+    }
+    return 0;
+}
+
+// Nonterminals are only known in the patterns of tiles, NULL otherwise.
+static int check_pattern(Pattern *pattern, Rule *rule, smap_t *nonterminals,
+                         struct Info *info) {
+    int error = 0;
+
+    if (nonterminals && smap_retrieve(nonterminals, pattern->type)) {
+        if (pattern->fields != NULL) {
+            print_error(pattern->type,
+                        "Fields of nonterminal '%s' cannot be matched in "
+                        "rule '%s'",
+                        pattern->type, rule->id);
+            return 1;
+        }
+        pattern->nonterminal = true;
+        return 0;
+    }
+
+    Node *node = smap_retrieve(info->node_name, pattern->type);
+    Nodeset *nodeset = smap_retrieve(info->nodeset_name, pattern->type);
+
+    if (!node && !nodeset) {
+        print_error(pattern->type,
+                    "Unknown type of node or nodeset '%s' in rule '%s'",
+                    pattern->type, rule->id);
+        return 1;
+    }
+
+    pattern->node = node;
+    pattern->nodeset = nodeset;
+
+    if (pattern->fields == NULL)
+        return 0;
+
+    if (nodeset) {
+        print_error(pattern->type,
+                    "Fields of nodeset '%s' cannot be matched in rule '%s'",
+                    pattern->type, rule->id);
+        return 1;
+    }
+
+    smap_t *field_name = smap_init(16);
+
+    for (int i = 0; i < array_size(pattern->fields); i++) {
+        PatternField *field = array_get(pattern->fields, i);
+        PatternField *orig_field;
+
+        if ((orig_field = smap_retrieve(field_name, field->id)) != NULL) {
+            print_error(field->id, "Duplicate field '%s' in rule '%s'",
+                        field->id, rule->id);
+            print_note(orig_field->id, "Previously declared here");
+            error = 1;
+            continue;
+        }
+        smap_insert(field_name, field->id, field);
+
+        for (int j = 0; j < array_size(node->children); j++) {
+            Child *child = array_get(node->children, j);
+            if (strcmp(child->id, field->id) == 0)
+                field->child = child;
+        }
+        for (int j = 0; j < array_size(node->attrs); j++) {
+            Attr *attr = array_get(node->attrs, j);
+            if (strcmp(attr->id, field->id) == 0)
+                field->attr = attr;
+        }
+
+        if (field->child) {
+            error += check_pattern_child(field, node, rule, nonterminals,
+                                         info);
+        } else if (field->attr) {
+            error += check_pattern_attr(field, node, info);
+        } else {
+            print_error(field->id,
+                        "Unknown child or attribute '%s' of node '%s' in "
+                        "rule '%s'",
+                        field->id, node->id, rule->id);
+            error = 1;
+        }
+    }
+
+    smap_free(field_name);
+
+    return error;
+}
+
+// The traversal of the rules handles the nodes matched by the roots of the
+// patterns.
+static int check_rules(Rules *rules, struct Info *info) {
+
+    int error = 0;
+
+    smap_t *rule_name = smap_init(16);
+    smap_t *node_name = smap_init(16);
+    array *nodes = array_init(16);
+
+    for (int i = 0; i < array_size(rules->rules); ++i) {
+        Rule *rule = array_get(rules->rules, i);
+        Rule *orig_rule;
+
+        if ((orig_rule = smap_retrieve(rule_name, rule->id)) != NULL) {
+            print_error(rule->id, "Duplicate rule '%s' in rules '%s'",
+                        rule->id, rules->id);
+            print_note(orig_rule->id, "Previously declared here");
+            error = 1;
+        } else {
+            smap_insert(rule_name, rule->id, rule);
+        }
+
+        // Actions and handlers share the names <rules>_<name>.
+        if (smap_retrieve(info->node_name, rule->id) != NULL) {
+            print_error(rule->id,
+                        "Rule '%s' in rules '%s' cannot have the name of a "
+                        "node",
+                        rule->id, rules->id);
+            error = 1;
+        }
+
+        if (check_pattern(rule->pattern, rule, NULL, info)) {
+            error = 1;
+            continue;
+        }
+
+        Pattern *pattern = rule->pattern;
+        if (pattern->node == NULL) {
+            print_error(pattern->type,
+                        "Rule '%s' has to match a node, not nodeset '%s'",
+                        rule->id, pattern->type);
+            error = 1;
+        } else if (smap_retrieve(node_name, pattern->type) == NULL) {
+            array_append(nodes, strdup(pattern->type));
+            smap_insert(node_name, pattern->type, pattern);
+        }
+    }
+
+    rules->traversal->nodes = nodes;
+
+    smap_free(rule_name);
+    smap_free(node_name);
+
+    return error;
+}
+
+static int check_all_tiles(array *tiles, struct Info *info) {
+
+    int error = 0;
+
+    for (int i = 0; i < array_size(tiles); ++i) {
+        Tiles *cur_tiles = (Tiles *)array_get(tiles, i);
+        void *orig_def;
+
+        if ((orig_def = check_name_exists(info, cur_tiles->id)) != NULL) {
+            print_error(cur_tiles->id, "Redefinition of name '%s'",
+                        cur_tiles->id);
+            print_note(orig_def, "Previously declared here");
+            error = 1;
+        } else {
+            smap_insert(info->tiles_name, cur_tiles->id, cur_tiles);
+        }
+    }
+    return error;
+}
+
+// The nonterminals of the tiles are the ones derived by its rules.
+static int check_tiles(Tiles *tiles, struct Info *info) {
+
+    int error = 0;
+
+    smap_t *rule_name = smap_init(16);
+    smap_t *nonterminal_name = smap_init(16);
+    array *nonterminals = array_init(8);
+
+    for (int i = 0; i < array_size(tiles->rules); ++i) {
+        Rule *rule = array_get(tiles->rules, i);
+        char *nonterminal = rule->nonterminal;
+
+        if (smap_retrieve(info->node_name, nonterminal) != NULL ||
+            smap_retrieve(info->nodeset_name, nonterminal) != NULL) {
+            print_error(nonterminal,
+                        "Nonterminal '%s' in tiles '%s' cannot have the name "
+                        "of a node or nodeset",
+                        nonterminal, tiles->id);
+            error = 1;
+        } else if (smap_retrieve(nonterminal_name, nonterminal) == NULL) {
+            array_append(nonterminals, nonterminal);
+            smap_insert(nonterminal_name, nonterminal, nonterminal);
+        }
+    }
+
+    for (int i = 0; i < array_size(tiles->rules); ++i) {
+        Rule *rule = array_get(tiles->rules, i);
+        Rule *orig_rule;
+
+        if ((orig_rule = smap_retrieve(rule_name, rule->id)) != NULL) {
+            print_error(rule->id, "Duplicate rule '%s' in tiles '%s'",
+                        rule->id, tiles->id);
+            print_note(orig_rule->id, "Previously declared here");
+            error = 1;
+        } else {
+            smap_insert(rule_name, rule->id, rule);
+        }
+
+        if (check_pattern(rule->pattern, rule, nonterminal_name, info)) {
+            error = 1;
+            continue;
+        }
+
+        Pattern *pattern = rule->pattern;
+        if (pattern->nodeset != NULL) {
+            print_error(pattern->type,
+                        "Rule '%s' has to match a node or nonterminal, not "
+                        "nodeset '%s'",
+                        rule->id, pattern->type);
+            error = 1;
+        } else if (pattern->nonterminal &&
+                   strcmp(pattern->type, rule->nonterminal) == 0) {
+            print_error(pattern->type,
+                        "Rule '%s' derives nonterminal '%s' from itself",
+                        rule->id, pattern->type);
+            error = 1;
+        }
+    }
+
+    tiles->nonterminals = nonterminals;
+
+    smap_free(rule_name);
+    smap_free(nonterminal_name);
+
+    return error;
+}
+
+static bool access_covers(NodeAccess *access, Node *node,
+                          struct Info *info) {
+    array *sets[] = {access->reads, access->writes};
+
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < array_size(sets[i]); j++) {
+            char *type = array_get(sets[i], j);
+            Nodeset *nodeset = smap_retrieve(info->nodeset_name, type);
+
+            if (strcmp(type, node->id) == 0 ||
+                (nodeset != NULL && nodeset_contains(nodeset, node)))
+                return true;
+        }
+    }
+    return false;
+}
+
+// The types in the reads and writes of a pass or traversal have to exist,
+// and a traversal has to declare the nodes it handles.
+static int check_node_access(NodeAccess *access, char *id,
+                             Traversal *traversal, struct Info *info) {
+    int error = 0;
+
+    if (access == NULL)
+        return 0;
+
+    array *sets[] = {access->reads, access->writes};
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < array_size(sets[i]); j++) {
+            char *type = array_get(sets[i], j);
+
+            if (smap_retrieve(info->node_name, type) == NULL &&
+                smap_retrieve(info->nodeset_name, type) == NULL) {
+                print_error(type,
+                            "Unknown type of node or nodeset '%s' in %s of "
+                            "'%s'",
+                            type, i == 0 ? "reads" : "writes", id);
+                error = 1;
+            }
+        }
+    }
+
+    if (traversal == NULL || traversal->nodes == NULL || error)
+        return error;
+
+    for (int i = 0; i < array_size(traversal->nodes); i++) {
+        Node *node = smap_retrieve(info->node_name,
+                                   array_get(traversal->nodes, i));
+
+        if (node != NULL && !access_covers(access, node, info)) {
+            print_error(traversal->id,
+                        "Node '%s' handled by traversal '%s' is not in its "
+                        "reads or writes",
+                        node->id, traversal->id);
+            error = 1;
+        }
+    }
+    return error;
+}
+
 static int check_pass(Pass *pass, struct Info *info) {
 
     int error = 0;
 
     // TODO: check collission of func
 
+    error += check_node_access(pass->access, pass->id, NULL, info);
+
     return error;
 }
 
@@ -564,6 +1028,28 @@ static int check_phase(Phase *phase, struct Info *info, smap_t *phase_order) {
         }
     }
 
+    if (phase->fuse && phase->type == PH_subphases) {
+        print_error(phase->id,
+                    "Phase '%s' with subphases cannot be fused, only "
+                    "phases with passes",
+                    phase->id);
+        error = 1;
+    }
+
+    if (phase->parallel && phase->type == PH_subphases) {
+        print_error(phase->id,
+                    "Phase '%s' with subphases cannot be parallel, only "
+                    "phases with passes",
+                    phase->id);
+        error = 1;
+    }
+
+    if (phase->parallel && phase->fuse) {
+        print_error(phase->id, "Phase '%s' cannot be both fused and parallel",
+                    phase->id);
+        error = 1;
+    }
+
     if (phase->root) {
         if (info->root_phase != NULL) {
             print_error(phase->id, "Double declaration of root phase");
@@ -582,6 +1068,57 @@ static int check_phase(Phase *phase, struct Info *info, smap_t *phase_order) {
     return error;
 }
 
+static bool phase_tree_has_cycle(Phase *phase) {
+    if (phase->cycle)
+        return true;
+    if (phase->type != PH_subphases)
+        return false;
+
+    for (int i = 0; i < array_size(phase->subphases); i++) {
+        if (phase_tree_has_cycle(array_get(phase->subphases, i)))
+            return true;
+    }
+    return false;
+}
+
+static bool phase_tree_has_parallel(Phase *phase) {
+    if (phase->parallel)
+        return true;
+    if (phase->type != PH_subphases)
+        return false;
+
+    for (int i = 0; i < array_size(phase->subphases); i++) {
+        if (phase_tree_has_parallel(array_get(phase->subphases, i)))
+            return true;
+    }
+    return false;
+}
+
+// Returns the number of checkpoint phases run by a cycle phase, which are
+// errors since a cycle has no single boundary to resume from.
+static int check_phase_checkpoints(Phase *phase, bool in_cycle,
+                                   bool *checkpoints) {
+    int errors = 0;
+
+    if (phase->checkpoint) {
+        *checkpoints = true;
+        if (in_cycle) {
+            print_error(phase->id,
+                        "Checkpoint phase '%s' is run by a cycle phase",
+                        phase->id);
+            errors++;
+        }
+    }
+    if (phase->type != PH_subphases)
+        return errors;
+
+    for (int i = 0; i < array_size(phase->subphases); i++)
+        errors += check_phase_checkpoints(array_get(phase->subphases, i),
+                                          in_cycle || phase->cycle,
+                                          checkpoints);
+    return errors;
+}
+
 Phase *build_phase_tree(Phase *phase, struct Info *info) {
     Phase *tree_node = mem_alloc(sizeof(Phase));
     tree_node->id = phase->id;
@@ -590,6 +1127,9 @@ Phase *build_phase_tree(Phase *phase, struct Info *info) {
     else
         tree_node->info = NULL;
     tree_node->cycle = phase->cycle;
+    tree_node->fuse = phase->fuse;
+    tree_node->checkpoint = phase->checkpoint;
+    tree_node->parallel = phase->parallel;
 
     tree_node->type = phase->type;
 
@@ -646,9 +1186,24 @@ int check_config(Config *config) {
     success += check_traversals(config->traversals, info);
     success += check_phases(config->phases, info);
     success += check_passes(config->passes, info);
+    success += check_all_tiles(config->tiles, info);
 
     for (int i = 0; i < array_size(config->nodes); ++i) {
-        success += check_node(array_get(config->nodes, i), info);
+        Node *node = array_get(config->nodes, i);
+        success += check_node(node, info);
+
+        // Caches are invalidated by the changes below the node.
+        if (node->computed != NULL) {
+            config->computed = true;
+            config->incremental = true;
+            config->parents = true;
+        }
+
+        for (int j = 0; j < array_size(node->attrs); ++j) {
+            Attr *attr = array_get(node->attrs, j);
+            if (attr->column)
+                config->columns = true;
+        }
     }
 
     for (int i = 0; i < array_size(config->nodesets); ++i) {
@@ -659,8 +1214,26 @@ int check_config(Config *config) {
         success += check_enum(array_get(config->enums, i), info);
     }
 
+    for (int i = 0; i < array_size(config->rules); ++i) {
+        success += check_rules(array_get(config->rules, i), info);
+    }
+
+    for (int i = 0; i < array_size(config->tiles); ++i) {
+        success += check_tiles(array_get(config->tiles, i), info);
+    }
+
     for (int i = 0; i < array_size(config->traversals); ++i) {
-        success += check_traversal(array_get(config->traversals, i), info);
+        Traversal *traversal = array_get(config->traversals, i);
+        success += check_traversal(traversal, info);
+        success +=
+            check_node_access(traversal->access, traversal->id, traversal,
+                              info);
+
+        // Changes are propagated to the parents of nodes.
+        if (traversal->incremental) {
+            config->incremental = true;
+            config->parents = true;
+        }
     }
     for (int i = 0; i < array_size(config->passes); ++i) {
         success += check_pass(array_get(config->passes, i), info);
@@ -697,6 +1270,10 @@ int check_config(Config *config) {
         if (!phase_errors) {
             Phase *tree = build_phase_tree(info->root_phase, info);
             config->phase_tree = tree;
+            config->cycles = phase_tree_has_cycle(tree);
+            config->parallel = phase_tree_has_parallel(tree);
+            success += check_phase_checkpoints(tree, false,
+                                               &config->checkpoints);
         } else {
             config->phase_tree = NULL;
         }
@@ -19,7 +19,8 @@ static NodeCommonInfo *create_commoninfo() {
 }
 
 Config *create_config(array *phases, array *passes, array *traversals,
-                      array *enums, array *nodesets, array *nodes) {
+                      array *enums, array *nodesets, array *nodes,
+                      array *rules, array *tiles) {
 
     Config *c = mem_alloc(sizeof(Config));
     c->phases = phases;
@@ -28,6 +29,23 @@ Config *create_config(array *phases, array *passes, array *traversals,
     c->enums = enums;
     c->nodesets = nodesets;
     c->nodes = nodes;
+    c->rules = rules;
+    c->tiles = tiles;
+    c->fusions = NULL;
+    c->incremental = false;
+    c->parents = false;
+    c->census = false;
+    c->journal = false;
+    c->presence = false;
+    c->computed = false;
+    c->columns = false;
+    c->cycles = false;
+    c->batch = false;
+    c->cycle_limit = 100;
+    c->checkpoints = false;
+    c->parallel = false;
+    c->profile = NULL;
+    c->inline_limit = 0;
 
     c->common_info = create_commoninfo();
     return c;
@@ -39,6 +57,9 @@ Phase *create_phase_header(char *id, bool root, bool cycle) {
     p->info = NULL;
     p->root = root;
     p->cycle = cycle;
+    p->fuse = false;
+    p->checkpoint = false;
+    p->parallel = false;
 
     p->common_info = create_commoninfo();
     return p;
@@ -65,11 +86,19 @@ Pass *create_pass(char *id, char *func) {
     p->id = id;
     p->func = func;
     p->info = NULL;
+    p->access = NULL;
 
     p->common_info = create_commoninfo();
     return p;
 }
 
+NodeAccess *create_node_access(array *reads, array *writes) {
+    NodeAccess *a = mem_alloc(sizeof(NodeAccess));
+    a->reads = reads;
+    a->writes = writes;
+    return a;
+}
+
 Traversal *create_traversal(char *id, char *func, array *nodes) {
 
     Traversal *t = mem_alloc(sizeof(Traversal));
@@ -77,11 +106,94 @@ Traversal *create_traversal(char *id, char *func, array *nodes) {
     t->func = func;
     t->info = NULL;
     t->nodes = nodes;
+    t->incremental = false;
+    t->rewrite = false;
+    t->readonly = false;
+    t->scoped = false;
+    t->rules = NULL;
+    t->access = NULL;
 
     t->common_info = create_commoninfo();
     return t;
 }
 
+Rules *create_rules(char *id, array *rules) {
+
+    Rules *r = mem_alloc(sizeof(Rules));
+    r->id = id;
+    r->info = NULL;
+    r->rules = rules;
+
+    // The nodes of the traversal are the roots of the patterns, which are
+    // known after checking the ast.
+    r->traversal = create_traversal(id, NULL, NULL);
+    r->traversal->rewrite = true;
+    r->traversal->rules = r;
+
+    r->common_info = create_commoninfo();
+    return r;
+}
+
+Rule *create_rule(char *id, Pattern *pattern) {
+
+    Rule *r = mem_alloc(sizeof(Rule));
+    r->id = id;
+    r->pattern = pattern;
+    r->nonterminal = NULL;
+    r->cost = 0;
+
+    r->common_info = create_commoninfo();
+    return r;
+}
+
+Tiles *create_tiles(char *id, array *rules) {
+
+    Tiles *t = mem_alloc(sizeof(Tiles));
+    t->id = id;
+    t->info = NULL;
+    t->rules = rules;
+    t->nonterminals = NULL;
+
+    t->common_info = create_commoninfo();
+    return t;
+}
+
+Rule *create_tile(char *id, char *nonterminal, Pattern *pattern,
+                  uint64_t cost) {
+
+    Rule *r = create_rule(id, pattern);
+    r->nonterminal = nonterminal;
+    r->cost = cost;
+    return r;
+}
+
+Pattern *create_pattern(char *type, array *fields) {
+
+    Pattern *p = mem_alloc(sizeof(Pattern));
+    p->type = type;
+    p->fields = fields;
+    p->node = NULL;
+    p->nodeset = NULL;
+    p->nonterminal = false;
+
+    p->common_info = create_commoninfo();
+    return p;
+}
+
+PatternField *create_patternfield(char *id, Pattern *pattern,
+                                  AttrValue *value) {
+
+    PatternField *f = mem_alloc(sizeof(PatternField));
+    f->id = id;
+    f->pattern = pattern;
+    f->value = value;
+    f->child = NULL;
+    f->attr = NULL;
+
+    f->common_info = create_commoninfo();
+    return f;
+}
+
 Enum *create_enum(char *id, char *prefix, array *values) {
 
     Enum *e = mem_alloc(sizeof(Enum));
@@ -117,6 +229,7 @@ Node *create_nodebody(array *children, array *attrs) {
     Node *n = mem_alloc(sizeof(Node));
     n->children = children;
     n->attrs = attrs;
+    n->computed = NULL;
     n->info = NULL;
 
     n->common_info = create_commoninfo();
@@ -178,6 +291,8 @@ Attr *create_attrhead_primitive(enum AttrType type, char *id) {
     a->type = type;
     a->type_id = NULL;
     a->id = id;
+    a->computed = false;
+    a->column = false;
 
     a->common_info = create_commoninfo();
     return a;
@@ -189,6 +304,8 @@ Attr *create_attrhead_idtype(char *type, char *id) {
     a->type = AT_link_or_enum;
     a->type_id = type;
     a->id = id;
+    a->computed = false;
+    a->column = false;
 
     a->common_info = create_commoninfo();
     return a;
@@ -247,6 +247,56 @@ void filegen_all_traversals(char *fileformatter,
     }
 }
 
+void filegen_all_rules(char *fileformatter,
+                       void (*func)(Config *, FILE *, Rules *)) {
+    char *full_path;
+    FILE *fp;
+
+    for (int i = 0; i < array_size(ast_definition->rules); ++i) {
+        Rules *rules = array_get(ast_definition->rules, i);
+        full_path = get_full_path(fileformatter, rules->id);
+
+        if (hash_match(rules->common_info, full_path)) {
+            mem_free(full_path);
+            continue;
+        }
+
+        if (!only_list_files) {
+            fp = get_fp(full_path);
+            out(HASH_HEADER, rules->common_info->hash);
+            func(ast_definition, fp, rules);
+            fclose(fp);
+        }
+
+        mem_free(full_path);
+    }
+}
+
+void filegen_all_tiles(char *fileformatter,
+                       void (*func)(Config *, FILE *, Tiles *)) {
+    char *full_path;
+    FILE *fp;
+
+    for (int i = 0; i < array_size(ast_definition->tiles); ++i) {
+        Tiles *tiles = array_get(ast_definition->tiles, i);
+        full_path = get_full_path(fileformatter, tiles->id);
+
+        if (hash_match(tiles->common_info, full_path)) {
+            mem_free(full_path);
+            continue;
+        }
+
+        if (!only_list_files) {
+            fp = get_fp(full_path);
+            out(HASH_HEADER, tiles->common_info->hash);
+            func(ast_definition, fp, tiles);
+            fclose(fp);
+        }
+
+        mem_free(full_path);
+    }
+}
+
 void filegen_all_passes(char *fileformatter,
                         void (*func)(Config *, FILE *, Pass *)) {
     char *full_path;
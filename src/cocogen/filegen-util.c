@@ -1,6 +1,11 @@
 #include "cocogen/filegen-util.h"
 #include "cocogen/ast.h"
+#include "lib/memory.h"
 #include "lib/smap.h"
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
 
 void generate_node_header_includes(Config *config, FILE *fp, Node *node) {
     bool using_bool = false;
@@ -21,8 +26,15 @@ void generate_node_header_includes(Config *config, FILE *fp, Node *node) {
         }
     }
 
-    for (int i = 0; i < array_size(node->attrs); ++i) {
-        Attr *attr = (Attr *)array_get(node->attrs, i);
+    // The cached values of computed attributes are members as well.
+    array *attrs = create_array();
+    for (int i = 0; i < array_size(node->attrs); ++i)
+        array_append(attrs, array_get(node->attrs, i));
+    for (int i = 0; i < array_size(node->computed); ++i)
+        array_append(attrs, array_get(node->computed, i));
+
+    for (int i = 0; i < array_size(attrs); ++i) {
+        Attr *attr = (Attr *)array_get(attrs, i);
         switch (attr->type) {
         case AT_bool:
             using_bool = true;
@@ -55,6 +67,7 @@ void generate_node_header_includes(Config *config, FILE *fp, Node *node) {
         }
     }
 
+    array_cleanup(attrs, NULL);
     smap_free(map);
 
     if (using_enum)
@@ -64,3 +77,211 @@ void generate_node_header_includes(Config *config, FILE *fp, Node *node) {
     if (using_bool)
         out("#include <stdbool.h>\n");
 }
+
+// Print an expression for the node in child 'child' of the node in variable
+// 'var', looking through the nodeset if the child is a nodeset. All members
+// of the nodeset union are node pointers, so any of them can be read.
+void out_child_node(FILE *fp, char *var, Child *child) {
+    if (child->nodeset != NULL) {
+        Node *first = array_get(child->nodeset->nodes, 0);
+        out("(%s->%s ? (void *)%s->%s->value.val_%s : NULL)", var, child->id,
+            var, child->id, first->id);
+    } else {
+        out("%s->%s", var, child->id);
+    }
+}
+
+// Print the includes needed to keep the parents, changes, journal and index
+// of nodes up to date. The nodeset structs are needed to find the nodes in
+// nodeset children.
+void out_track_includes(Config *config, FILE *fp) {
+    if (config->census)
+        out("#include \"generated/census.h\"\n");
+    if (config->presence)
+        out("#include \"generated/presence.h\"\n");
+    if (config->journal)
+        out("#include \"generated/journal.h\"\n");
+    if (config->cycles)
+        out("#include \"generated/trav-core.h\"\n");
+    if (!config->parents)
+        return;
+
+    out("#include \"generated/ast.h\"\n");
+    out("#include \"generated/parent.h\"\n");
+    if (config->incremental) {
+        out("#include <string.h>\n");
+        out("#include \"generated/incremental.h\"\n");
+    }
+}
+
+// Print the initialisation of the bookkeeping of the new node in 'var'.
+void out_track_init(Config *config, FILE *fp, char *indent, char *var,
+                    Node *node) {
+    if (config->census)
+        out("%s%s->_census = " CENSUS_PREFIX "add(" NT_FORMAT ", %s);\n",
+            indent, var, node->id, var);
+    if (config->presence)
+        out("%s" PRESENCE_PREFIX "add(" NT_FORMAT ");\n", indent, node->id);
+    if (config->parents)
+        out("%s" PARENT_PREFIX "init(%s);\n", indent, var);
+    if (config->incremental)
+        out("%s" INCREMENTAL_PREFIX "init(%s);\n", indent, var);
+    if (config->incremental && node == config->root_node)
+        out("%smemset(%s->_last_run, 0, sizeof(%s->_last_run));\n", indent,
+            var, var);
+
+    // Nothing is cached yet.
+    for (int i = 0; i < array_size(node->computed); i++) {
+        Attr *attr = array_get(node->computed, i);
+        if (attr->type == AT_string)
+            out("%s%s->%s = NULL;\n", indent, var, attr->id);
+        out("%s%s->" COMPUTED_EPOCH_FORMAT " = 0;\n", indent, var, attr->id);
+    }
+}
+
+// Print a statement logging the old value of 'field' of the node in 'var',
+// before it is changed.
+void out_journal(Config *config, FILE *fp, char *indent, char *var,
+                 char *field) {
+    if (config->journal)
+        out("%s" TX_PREFIX "log(%s, &%s->%s, sizeof(%s->%s));\n", indent,
+            var, var, field, var, field);
+}
+
+// Storage class of the state of the generated code, which is thread-local
+// for the batch phasedriver and for parallel phases.
+char *out_thread_local(Config *config) {
+    return config->batch || config->parallel ? THREAD_LOCAL_MACRO " " : "";
+}
+
+// Expression reading the epoch of incremental traversals. The batch
+// phasedriver shares it between the threads, so that a tree can be run on
+// any thread and its epochs stay ordered.
+char *out_epoch(Config *config) {
+    return config->batch ? "__atomic_load_n(&" INCREMENTAL_PREFIX
+                           "epoch, __ATOMIC_RELAXED)"
+                         : INCREMENTAL_PREFIX "epoch";
+}
+
+// Expression advancing the epoch of incremental traversals, which evaluates
+// to the new epoch.
+char *out_epoch_advance(Config *config) {
+    return config->batch ? "__atomic_add_fetch(&" INCREMENTAL_PREFIX
+                           "epoch, 1, __ATOMIC_RELAXED)"
+                         : "++" INCREMENTAL_PREFIX "epoch";
+}
+
+// Print a statement counting a change to the tree, which ends a cycle phase
+// when none were made in an iteration.
+void out_count_change(Config *config, FILE *fp, char *indent) {
+    if (config->cycles)
+        out("%s" TRAV_PREFIX "changes++;\n", indent);
+}
+
+// Print a statement making the node in 'var' the parent of the node in its
+// child 'child'.
+void out_track_child(Config *config, FILE *fp, char *indent, char *var,
+                     Node *node, Child *child) {
+    if (!config->parents)
+        return;
+
+    out("%s" PARENT_PREFIX "set(", indent);
+    out_child_node(fp, var, child);
+    out(", %s, " CS_FORMAT ");\n", var, node->id, child->id);
+}
+
+static char *measure_buf = NULL;
+static size_t measure_size = 0;
+
+// Open a stream to print code into, to find its size before deciding where
+// to print it.
+FILE *out_measure_start(void) {
+    return open_memstream(&measure_buf, &measure_size);
+}
+
+// Close the stream of out_measure_start and return the number of lines
+// printed into it.
+int out_measure_end(FILE *fp) {
+    fclose(fp);
+
+    int lines = 0;
+    for (size_t i = 0; i < measure_size; i++) {
+        if (measure_buf[i] == '\n')
+            lines++;
+    }
+
+    free(measure_buf);
+    measure_buf = NULL;
+    measure_size = 0;
+    return lines;
+}
+
+// Whether a function with a body of 'lines' lines is defined static inline
+// in its header instead of in its source file.
+bool out_inline(Config *config, int lines) {
+    return config->inline_limit > 0 && lines <= config->inline_limit;
+}
+
+// Allocate a string printed with a format.
+char *out_format(const char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    int len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    char *res = mem_alloc(len + 1);
+    va_start(args, fmt);
+    vsnprintf(res, len + 1, fmt, args);
+    va_end(args);
+    return res;
+}
+
+static char *enum_prefix(Config *config, char *id) {
+    for (int i = 0; i < array_size(config->enums); i++) {
+        Enum *e = array_get(config->enums, i);
+        if (strcmp(e->id, id) == 0)
+            return e->prefix;
+    }
+    return NULL;
+}
+
+// Value of an attribute in the generated code, equal values print the same.
+char *out_attr_literal(Config *config, Attr *attr, AttrValue *value) {
+    switch (value->type) {
+    case AV_string:
+        return out_format("\"%s\"", value->value.string_value);
+    case AV_int:
+        return out_format("%" PRId64, value->value.int_value);
+    case AV_uint:
+        return out_format("%" PRIu64, value->value.uint_value);
+    case AV_float:
+        return out_format("%.9g", (double)value->value.float_value);
+    case AV_double:
+        return out_format("%.17g", value->value.double_value);
+    case AV_bool:
+        return out_format(value->value.bool_value ? "true" : "false");
+    case AV_id:
+        return out_format("%s_%s", enum_prefix(config, attr->type_id),
+                          value->value.string_value);
+    }
+    return NULL;
+}
+
+// Condition on the attribute 'expr' which holds if it matches the field of a
+// pattern.
+char *out_attr_cond(Config *config, PatternField *field, char *expr) {
+    if (field->value == NULL)
+        return out_format("%s == NULL", expr);
+
+    char *literal = out_attr_literal(config, field->attr, field->value);
+    char *cond;
+    if (field->value->type == AV_string)
+        cond = out_format("%s != NULL && strcmp(%s, %s) == 0", expr, expr,
+                          literal);
+    else
+        cond = out_format("%s == %s", expr, literal);
+
+    mem_free(literal);
+    return cond;
+}
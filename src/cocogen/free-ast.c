@@ -4,6 +4,7 @@
 
 #include "lib/array.h"
 #include "lib/memory.h"
+#include "lib/smap.h"
 
 static void free_commoninfo(NodeCommonInfo *info) {
     if (info->hash)
@@ -46,6 +47,70 @@ static void free_traversal(void *p) {
     mem_free(traversal);
 }
 
+static void free_attrval(AttrValue *value) {
+    if (value->type == AV_string || value->type == AV_id)
+        mem_free(value->value.string_value);
+
+    free_commoninfo(value->common_info);
+    mem_free(value);
+}
+
+static void free_pattern(void *p);
+
+static void free_patternfield(void *p) {
+    PatternField *field = p;
+    if (field->pattern != NULL)
+        free_pattern(field->pattern);
+    if (field->value != NULL)
+        free_attrval(field->value);
+
+    mem_free(field->id);
+    free_commoninfo(field->common_info);
+    mem_free(field);
+}
+
+static void free_pattern(void *p) {
+    Pattern *pattern = p;
+    if (pattern->fields != NULL)
+        array_cleanup(pattern->fields, free_patternfield);
+
+    mem_free(pattern->type);
+    free_commoninfo(pattern->common_info);
+    mem_free(pattern);
+}
+
+static void free_rule(void *p) {
+    Rule *rule = p;
+    free_pattern(rule->pattern);
+
+    if (rule->nonterminal != NULL)
+        mem_free(rule->nonterminal);
+    mem_free(rule->id);
+    free_commoninfo(rule->common_info);
+    mem_free(rule);
+}
+
+// The id is freed with the traversal of the rules.
+static void free_rules(void *p) {
+    Rules *rules = p;
+    array_cleanup(rules->rules, free_rule);
+
+    free_commoninfo(rules->common_info);
+    mem_free(rules);
+}
+
+// The nonterminals are the strings of the rules deriving them.
+static void free_tiles(void *p) {
+    Tiles *tiles = p;
+    array_cleanup(tiles->rules, free_rule);
+    if (tiles->nonterminals != NULL)
+        array_cleanup(tiles->nonterminals, NULL);
+
+    mem_free(tiles->id);
+    free_commoninfo(tiles->common_info);
+    mem_free(tiles);
+}
+
 static void free_enum(void *p) {
     Enum *attr_enum = p;
     if (attr_enum->values != NULL)
@@ -123,11 +188,21 @@ static void free_node(void *p) {
     if (node->attrs != NULL)
         array_cleanup(node->attrs, free_attr);
 
+    if (node->computed != NULL)
+        array_cleanup(node->computed, free_attr);
+
     mem_free(node->id);
     free_commoninfo(node->common_info);
     mem_free(node);
 }
 
+static void free_fusion(void *p) {
+    Fusion *fusion = p;
+    mem_free(fusion->id);
+    array_cleanup(fusion->traversals, NULL);
+    mem_free(fusion);
+}
+
 static void free_phase_tree(Phase *tree) {
     if (tree == NULL)
         return;
@@ -145,16 +220,31 @@ static void free_phase_tree(Phase *tree) {
     mem_free(tree);
 }
 
+static void *free_profile_count(char *key, void *count) {
+    mem_free(count);
+    return NULL;
+}
+
 void free_config(Config *config) {
     array_cleanup(config->phases, free_phase);
     array_cleanup(config->passes, free_pass);
     array_cleanup(config->traversals, free_traversal);
+    array_cleanup(config->rules, free_rules);
+    array_cleanup(config->tiles, free_tiles);
     array_cleanup(config->enums, free_enum);
     array_cleanup(config->nodesets, free_nodeset);
     array_cleanup(config->nodes, free_node);
 
     free_phase_tree(config->phase_tree);
 
+    if (config->fusions != NULL)
+        array_cleanup(config->fusions, free_fusion);
+
+    if (config->profile != NULL) {
+        smap_map(config->profile, free_profile_count);
+        smap_free(config->profile);
+    }
+
     free_commoninfo(config->common_info);
     mem_free(config);
 }
@@ -0,0 +1,223 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cocogen/ast.h"
+#include "cocogen/config.h"
+#include "cocogen/fuse-ast.h"
+
+#include "lib/array.h"
+#include "lib/memory.h"
+#include "lib/print.h"
+#include "lib/smap.h"
+
+// Map from node name to index in reachability matrix
+static smap_t *node_index = NULL;
+
+// Node reachability matrix, reachable[i][j] is true if node j can occur in
+// the subtree of node i.
+static bool **reachable = NULL;
+
+static int get_node_index(char *id) {
+    return *(int *)smap_retrieve(node_index, id);
+}
+
+static void set_child_reachable(int index, Child *child) {
+    if (child->node != NULL) {
+        reachable[index][get_node_index(child->node->id)] = true;
+    } else {
+        for (int i = 0; i < array_size(child->nodeset->nodes); i++) {
+            Node *node = array_get(child->nodeset->nodes, i);
+            reachable[index][get_node_index(node->id)] = true;
+        }
+    }
+}
+
+static void compute_reachability(Config *config) {
+    int num_nodes = array_size(config->nodes);
+
+    node_index = smap_init(32);
+    for (int i = 0; i < num_nodes; i++) {
+        Node *node = array_get(config->nodes, i);
+        int *index = mem_alloc(sizeof(int));
+        *index = i;
+        smap_insert(node_index, node->id, index);
+    }
+
+    reachable = mem_alloc(sizeof(bool *) * num_nodes);
+    for (int i = 0; i < num_nodes; i++) {
+        reachable[i] = mem_alloc(sizeof(bool) * num_nodes);
+        memset(reachable[i], 0, sizeof(bool) * num_nodes);
+
+        Node *node = array_get(config->nodes, i);
+        for (int j = 0; j < array_size(node->children); j++) {
+            set_child_reachable(i, array_get(node->children, j));
+        }
+    }
+
+    // Compute reachability of nodes using the Floyd-Warshall algorithm
+    for (int k = 0; k < num_nodes; k++) {
+        for (int i = 0; i < num_nodes; i++) {
+            for (int j = 0; j < num_nodes; j++) {
+                if (reachable[i][k] && reachable[k][j])
+                    reachable[i][j] = true;
+            }
+        }
+    }
+}
+
+static void free_reachability(Config *config) {
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+        mem_free(smap_retrieve(node_index, node->id));
+        mem_free(reachable[i]);
+    }
+
+    mem_free(reachable);
+    smap_free(node_index);
+    reachable = NULL;
+    node_index = NULL;
+}
+
+// Two traversals overlap when a node handled by one of them is handled by,
+// or can occur below a node handled by, the other one. In a fused walk the
+// handler of the first traversal would then decide whether the second one
+// gets to see its nodes.
+static bool traversals_overlap(Traversal *t1, Traversal *t2) {
+    for (int i = 0; i < array_size(t1->nodes); i++) {
+        int a = get_node_index(array_get(t1->nodes, i));
+
+        for (int j = 0; j < array_size(t2->nodes); j++) {
+            int b = get_node_index(array_get(t2->nodes, j));
+
+            if (a == b || reachable[a][b] || reachable[b][a])
+                return true;
+        }
+    }
+    return false;
+}
+
+static bool can_join_group(array *group, Traversal *trav) {
+    for (int i = 0; i < array_size(group); i++) {
+        PhaseLeaf *leaf = array_get(group, i);
+        if (traversals_overlap(leaf->value.traversal, trav))
+            return false;
+    }
+    return true;
+}
+
+static bool fusion_matches(Fusion *fusion, array *group) {
+    if (array_size(fusion->traversals) != array_size(group))
+        return false;
+
+    for (int i = 0; i < array_size(group); i++) {
+        PhaseLeaf *leaf = array_get(group, i);
+        if (array_get(fusion->traversals, i) != leaf->value.traversal)
+            return false;
+    }
+    return true;
+}
+
+static Fusion *get_fusion(Config *config, array *group) {
+    for (int i = 0; i < array_size(config->fusions); i++) {
+        Fusion *fusion = array_get(config->fusions, i);
+        if (fusion_matches(fusion, group))
+            return fusion;
+    }
+
+    Fusion *fusion = mem_alloc(sizeof(Fusion));
+    fusion->id = mem_alloc(sizeof(FUSION_ID_FORMAT) + 12);
+    sprintf(fusion->id, FUSION_ID_FORMAT, array_size(config->fusions));
+
+    fusion->traversals = array_init(array_size(group));
+    for (int i = 0; i < array_size(group); i++) {
+        PhaseLeaf *leaf = array_get(group, i);
+        array_append(fusion->traversals, leaf->value.traversal);
+    }
+
+    array_append(config->fusions, fusion);
+    return fusion;
+}
+
+static void flush_group(Config *config, Phase *phase, array *group) {
+    if (array_size(group) == 1) {
+        PhaseLeaf *leaf = array_get(group, 0);
+        print_warning(leaf->value.traversal->id,
+                      "Traversal '%s' in fuse phase '%s' cannot be fused "
+                      "with a neighbouring traversal",
+                      leaf->value.traversal->id, phase->id);
+        array_append(phase->passes, leaf);
+    } else if (array_size(group) > 1) {
+        PhaseLeaf *fused = mem_alloc(sizeof(PhaseLeaf));
+        fused->type = PL_fusion;
+        fused->value.fusion = get_fusion(config, group);
+
+        for (int i = 0; i < array_size(group); i++) {
+            mem_free(array_get(group, i));
+        }
+        array_append(phase->passes, fused);
+    }
+
+    array_clear(group);
+}
+
+static void fuse_phase(Config *config, Phase *phase) {
+    if (phase->type == PH_subphases) {
+        for (int i = 0; i < array_size(phase->subphases); i++) {
+            fuse_phase(config, array_get(phase->subphases, i));
+        }
+        return;
+    }
+
+    if (!phase->fuse)
+        return;
+
+    array *leaves = phase->passes;
+    array *group = array_init(8);
+    phase->passes = array_init(32);
+
+    // Greedily collect runs of consecutive traversals that do not overlap.
+    // Passes, traversals of all nodes, incremental and rewrite traversals end
+    // a run.
+    for (int i = 0; i < array_size(leaves); i++) {
+        PhaseLeaf *leaf = array_get(leaves, i);
+
+        if (leaf->type == PL_traversal &&
+            leaf->value.traversal->nodes != NULL &&
+            !leaf->value.traversal->incremental &&
+            !leaf->value.traversal->rewrite) {
+
+            if (!can_join_group(group, leaf->value.traversal))
+                flush_group(config, phase, group);
+
+            array_append(group, leaf);
+        } else {
+            flush_group(config, phase, group);
+
+            if (leaf->type == PL_traversal) {
+                print_warning(leaf->value.traversal->id,
+                              "Traversal '%s' in fuse phase '%s' is "
+                              "incremental, rewrites or handles all nodes "
+                              "and cannot be fused",
+                              leaf->value.traversal->id, phase->id);
+            }
+            array_append(phase->passes, leaf);
+        }
+    }
+
+    flush_group(config, phase, group);
+
+    array_cleanup(group, NULL);
+    array_cleanup(leaves, NULL);
+}
+
+void fuse_config(Config *config) {
+    config->fusions = array_init(8);
+
+    if (config->phase_tree == NULL)
+        return;
+
+    compute_reachability(config);
+    fuse_phase(config, config->phase_tree);
+    free_reachability(config);
+}
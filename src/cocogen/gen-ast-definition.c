@@ -43,16 +43,39 @@ static void generate_traversal_enum(Config *config, FILE *fp) {
             Traversal *t = array_get(config->traversals, i);
             out("   " TRAV_FORMAT ",\n", t->id);
         }
+
+        for (int i = 0; i < array_size(config->fusions); i++) {
+            Fusion *f = array_get(config->fusions, i);
+            out("   " TRAV_FORMAT ",\n", f->id);
+        }
     }
 
     out("} " TRAV_ENUM_NAME ";\n\n");
 }
 
+static void generate_phase_enum(Config *config, FILE *fp) {
+    out("typedef enum {\n");
+    if (array_size(config->phases) == 0)
+        out("    " PHASE_FORMAT ",\n", "PLACEHOLDER");
+    for (int i = 0; i < array_size(config->phases); i++) {
+        Phase *p = array_get(config->phases, i);
+        out("    " PHASE_FORMAT ",\n", p->id);
+    }
+    out("} " PHASE_ENUM_NAME ";\n\n");
+}
+
 void generate_enum_definitions(Config *config, FILE *fp) {
     out("#pragma once\n");
 
+    if (config->batch || config->parallel) {
+        out("#ifndef " THREAD_LOCAL_MACRO "\n");
+        out("#define " THREAD_LOCAL_MACRO " _Thread_local\n");
+        out("#endif\n\n");
+    }
+
     generate_nodetype_enum(config, fp);
     generate_traversal_enum(config, fp);
+    generate_phase_enum(config, fp);
 
     for (int i = 0; i < array_size(config->enums); i++) {
         generate_enum((Enum *)array_get(config->enums, i), fp);
@@ -79,9 +102,24 @@ void generate_ast_node_header(Config *config, FILE *fp, Node *node) {
     out("#pragma once\n");
 
     generate_node_header_includes(config, fp, node);
+    if (config->parents)
+        out("#include \"generated/parent.h\"\n");
 
     out("typedef struct %s {\n", node->id);
 
+    // Must be the first member, so that any node can be used as NodeTrack.
+    if (config->parents)
+        out("    NodeTrack _track;\n");
+    if (config->census)
+        out("    int _census;\n");
+    if (config->incremental && node == config->root_node) {
+        out("    // Epoch in which each traversal last started on the "
+            "tree.\n");
+        out("    unsigned long _last_run[%d];\n",
+            array_size(config->traversals) + array_size(config->fusions) +
+                1);
+    }
+
     if (node->children) {
         for (int j = 0; j < array_size(node->children); ++j) {
             Child *child = (Child *)array_get(node->children, j);
@@ -94,6 +132,13 @@ void generate_ast_node_header(Config *config, FILE *fp, Node *node) {
             out("    %s %s;\n", str_attr_type(attr), attr->id);
         }
     }
+
+    // Cached value and the epoch in which it was computed, 0 if it was not.
+    for (int j = 0; j < array_size(node->computed); ++j) {
+        Attr *attr = (Attr *)array_get(node->computed, j);
+        out("    %s %s;\n", str_attr_type(attr), attr->id);
+        out("    unsigned long " COMPUTED_EPOCH_FORMAT ";\n", attr->id);
+    }
     out("} %s;", node->id);
 }
 void generate_ast_nodeset_header(Config *config, FILE *fp, Nodeset *nodeset) {
@@ -51,6 +51,7 @@ void generate_binary_serialization_read_node(Config *config, FILE *fp,
     out("#include \"lib/smap.h\"\n");
     out("#include \"lib/memory.h\"\n");
     out("#include \"lib/print.h\"\n");
+    out_track_includes(config, fp);
     out("\n");
 
     for (int i = 0; i < array_size(node->children); i++) {
@@ -67,6 +68,7 @@ void generate_binary_serialization_read_node(Config *config, FILE *fp,
 
     out("    %s *res = mem_alloc(sizeof(%s));\n", node->id, node->id);
     out("    memset(res, 0, sizeof(%s));\n", node->id);
+    out_track_init(config, fp, "    ", "res", node);
     out("    Node *node = array_get(file->nodes, node_index);\n");
     out("    const char *type = array_get(file->string_pool, "
         "node->type_index);\n");
@@ -100,6 +102,7 @@ void generate_binary_serialization_read_node(Config *config, FILE *fp,
                 "c->node_index);\n",
                 c->type, c->type);
             out("            res->%s = child;\n", c->id);
+            out_track_child(config, fp, "            ", "res", node, c);
 
             out("        }\n");
         }
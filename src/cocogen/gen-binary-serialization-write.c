@@ -173,8 +173,17 @@ static void generate_node_gen_traversal(Node *node, FILE *fp) {
             case AT_uint32:
                 out("    WRITE(4, node->%s);\n", attr->id);
                 break;
+            // Widened first, so no bytes beyond the attribute are written.
             case AT_int:
+                out("    const int64_t value_%s = node->%s;\n", attr->id,
+                    attr->id);
+                out("    WRITE(8, value_%s);\n", attr->id);
+                break;
             case AT_uint:
+                out("    const uint64_t value_%s = node->%s;\n", attr->id,
+                    attr->id);
+                out("    WRITE(8, value_%s);\n", attr->id);
+                break;
             case AT_int64:
             case AT_uint64:
                 out("    WRITE(8, node->%s);\n", attr->id);
@@ -578,7 +587,8 @@ static void generate_enum_read_functions(Config *config, FILE *fp) {
         out("    }\n");
     }
 
-    out("    else {\n");
+    // Without enums there is no if to continue.
+    out(array_size(config->enums) > 0 ? "    else {\n" : "    {\n");
     out("        print_user_error(SERIALIZE_READ_BIN_ERROR_HEADER, \"%%s: "
         "Unknown enum type %%s\", _serialization_read_fn, type);\n");
     out("        return 0;\n");
@@ -0,0 +1,152 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "cocogen/ast.h"
+#include "cocogen/config.h"
+#include "cocogen/filegen-util.h"
+#include "cocogen/gen-census-functions.h"
+
+#include "lib/array.h"
+
+static void generate(Config *config, FILE *fp, bool header) {
+    out("int " CENSUS_PREFIX "add(" NT_ENUM_NAME " type, void *node)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    if (size[type] == capacity[type]) {\n");
+        out("        int new_capacity = capacity[type] ? capacity[type] * 2 "
+            ": 64;\n");
+        out("        void **new_nodes = mem_alloc(sizeof(void *) * "
+            "new_capacity);\n");
+        out("        if (size[type] > 0) {\n");
+        out("            memcpy(new_nodes, nodes[type], sizeof(void *) * "
+            "size[type]);\n");
+        out("            mem_free(nodes[type]);\n");
+        out("        }\n");
+        out("        nodes[type] = new_nodes;\n");
+        out("        capacity[type] = new_capacity;\n");
+        out("    }\n");
+        out("    nodes[type][size[type]] = node;\n");
+        out("    return size[type]++;\n");
+        out("}\n\n");
+    }
+
+    // The last node of the type takes the place of the removed one, so its
+    // index has to be updated. A detached node has index -1.
+    out("void " CENSUS_PREFIX "remove(" NT_ENUM_NAME " type, int index)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    if (index < 0)\n");
+        out("        return;\n");
+        out("    void *last = nodes[type][--size[type]];\n");
+        out("    nodes[type][index] = last;\n");
+        out("    switch (type) {\n");
+        for (int i = 0; i < array_size(config->nodes); i++) {
+            Node *node = array_get(config->nodes, i);
+            out("    case " NT_FORMAT ":\n", node->id);
+            out("        ((struct %s *)last)->_census = index;\n", node->id);
+            out("        break;\n");
+        }
+        out("    default:\n");
+        out("        break;\n");
+        out("    }\n");
+        out("}\n\n");
+    }
+
+    // Called for a node that is replaced in the tree, with its index from
+    // before the handler ran. A node that the handler freed is no longer at
+    // that index, and is left alone. A detached node is not removed again
+    // when it is freed.
+    out("void " CENSUS_PREFIX "detach(" NT_ENUM_NAME
+        " type, void *node, int index)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    if (node == NULL || index < 0 || index >= size[type] ||\n");
+        out("        nodes[type][index] != node)\n");
+        out("        return;\n");
+        out("    " CENSUS_PREFIX "set(type, node, false);\n");
+        if (config->journal)
+            out("    " TX_PREFIX "log_census(type, node, true);\n");
+        out("}\n\n");
+    }
+
+    // Adds the node to or removes it from the census, unless it already is
+    // or is not in it. A rollback of the journal uses it to undo detaches.
+    out("void " CENSUS_PREFIX "set(" NT_ENUM_NAME
+        " type, void *node, bool indexed)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    int *index;\n");
+        out("    switch (type) {\n");
+        for (int i = 0; i < array_size(config->nodes); i++) {
+            Node *node = array_get(config->nodes, i);
+            out("    case " NT_FORMAT ":\n", node->id);
+            out("        index = &((struct %s *)node)->_census;\n", node->id);
+            out("        break;\n");
+        }
+        out("    default:\n");
+        out("        return;\n");
+        out("    }\n");
+        out("    if (indexed && *index < 0) {\n");
+        out("        *index = " CENSUS_PREFIX "add(type, node);\n");
+        out("    } else if (!indexed && *index >= 0) {\n");
+        out("        " CENSUS_PREFIX "remove(type, *index);\n");
+        out("        *index = -1;\n");
+        out("    }\n");
+        out("}\n\n");
+    }
+
+    out("int " CENSUS_PREFIX "size(" NT_ENUM_NAME " type)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    return size[type];\n");
+        out("}\n\n");
+    }
+
+    out("void **" CENSUS_PREFIX "nodes(" NT_ENUM_NAME " type)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    return nodes[type];\n");
+        out("}\n");
+    }
+}
+
+void generate_census_header(Config *config, FILE *fp) {
+    out("#pragma once\n");
+    out("#include <stdbool.h>\n");
+    out("#include \"generated/enum.h\"\n");
+    out("\n");
+
+    generate(config, fp, true);
+}
+
+void generate_census_definitions(Config *config, FILE *fp) {
+    int num_nodes = array_size(config->nodes);
+
+    out("#include <string.h>\n");
+    out("#include \"generated/ast.h\"\n");
+    out("#include \"generated/census.h\"\n");
+    if (config->journal)
+        out("#include \"generated/journal.h\"\n");
+    out("#include \"lib/memory.h\"\n");
+    out("\n");
+
+    out("// Live nodes of every node type, in order of creation until nodes "
+        "are freed.\n");
+    out("static void **nodes[%d];\n", num_nodes);
+    out("static int size[%d];\n", num_nodes);
+    out("static int capacity[%d];\n\n", num_nodes);
+
+    generate(config, fp, false);
+}
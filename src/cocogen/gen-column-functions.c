@@ -0,0 +1,76 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "cocogen/ast.h"
+#include "cocogen/config.h"
+#include "cocogen/filegen-util.h"
+#include "cocogen/gen-column-functions.h"
+#include "cocogen/str-ast.h"
+
+#include "lib/array.h"
+
+static void generate_column(Config *config, Node *node, Attr *attr,
+                            FILE *fp, bool header) {
+    char *type = str_attr_type(attr);
+
+    out("void " COLUMN_FORMAT "(struct %s **nodes, int size, %s *column)",
+        node->id, attr->id, "gather", node->id, type);
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    for (int i = 0; i < size; i++)\n");
+        out("        column[i] = nodes[i]->%s;\n", attr->id);
+        out("}\n\n");
+    }
+
+    out("void " COLUMN_FORMAT
+        "(struct %s **nodes, int size, const %s *column)",
+        node->id, attr->id, "scatter", node->id, type);
+    if (header) {
+        out(";\n");
+        return;
+    }
+
+    out(" {\n");
+    out("    for (int i = 0; i < size; i++) {\n");
+    if (config->incremental || config->journal || config->cycles) {
+        // Only the values which changed are marked, logged and counted.
+        out("        if (nodes[i]->%s != column[i])\n", attr->id);
+        out("            " SET_FIELD_FORMAT "(nodes[i], column[i]);\n",
+            node->id, attr->id);
+    } else {
+        out("        nodes[i]->%s = column[i];\n", attr->id);
+    }
+    out("    }\n");
+    out("}\n\n");
+}
+
+static void generate(Config *config, FILE *fp, bool header) {
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+
+        for (int j = 0; j < array_size(node->attrs); j++) {
+            Attr *attr = array_get(node->attrs, j);
+            if (attr->column)
+                generate_column(config, node, attr, fp, header);
+        }
+    }
+}
+
+void generate_column_header(Config *config, FILE *fp) {
+    out("#pragma once\n");
+    out("#include \"generated/ast.h\"\n");
+    out("\n");
+
+    generate(config, fp, true);
+}
+
+void generate_column_definitions(Config *config, FILE *fp) {
+    out("#include \"generated/columns.h\"\n");
+    if (config->incremental || config->journal || config->cycles)
+        out("#include \"generated/mutate-ast.h\"\n");
+    out("\n");
+
+    generate(config, fp, false);
+}
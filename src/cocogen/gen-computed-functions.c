@@ -0,0 +1,74 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "cocogen/ast.h"
+#include "cocogen/config.h"
+#include "cocogen/filegen-util.h"
+#include "cocogen/gen-computed-functions.h"
+#include "cocogen/str-ast.h"
+
+#include "lib/array.h"
+
+static void generate_getter(Config *config, Node *node, Attr *attr,
+                            FILE *fp, bool header) {
+    char *type = str_attr_type(attr);
+
+    if (header)
+        out("%s " COMPUTE_FIELD_FORMAT "(%s *node);\n", type, node->id,
+            attr->id, node->id);
+    out("%s " GET_FIELD_FORMAT "(%s *node)", type, node->id, attr->id,
+        node->id);
+    if (header) {
+        out(";\n");
+        return;
+    }
+
+    // The value is taken from the cache unless the subtree of the node
+    // changed after it was computed. The epoch is advanced, so that changes
+    // later in the same epoch are seen.
+    out(" {\n");
+    out("    if (node->" COMPUTED_EPOCH_FORMAT
+        " == 0 ||\n        node->_track.subtree_epoch >= node->"
+        COMPUTED_EPOCH_FORMAT ") {\n",
+        attr->id, attr->id);
+    if (attr->type == AT_string)
+        out("        mem_free(node->%s);\n", attr->id);
+    out("        node->%s = " COMPUTE_FIELD_FORMAT "(node);\n", attr->id,
+        node->id, attr->id);
+    out("        node->" COMPUTED_EPOCH_FORMAT " = %s;\n", attr->id,
+        out_epoch_advance(config));
+    out("    }\n");
+    out("    return node->%s;\n", attr->id);
+    out("}\n");
+}
+
+static void generate(Config *config, FILE *fp, bool header) {
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+
+        for (int j = 0; j < array_size(node->computed); j++) {
+            generate_getter(config, node, array_get(node->computed, j), fp,
+                            header);
+            out("\n");
+        }
+    }
+}
+
+void generate_computed_header(Config *config, FILE *fp) {
+    out("#pragma once\n");
+    out("#include \"generated/ast.h\"\n");
+    out("\n");
+    out("// The compute functions are written by the user, and may only "
+        "depend on the\n// subtree of the node.\n");
+
+    generate(config, fp, true);
+}
+
+void generate_computed_definitions(Config *config, FILE *fp) {
+    out("#include \"generated/computed.h\"\n");
+    out("#include \"generated/incremental.h\"\n");
+    out("#include \"lib/memory.h\"\n");
+    out("\n");
+
+    generate(config, fp, false);
+}
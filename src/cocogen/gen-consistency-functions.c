@@ -1,146 +1,315 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "cocogen/ast.h"
+#include "cocogen/config.h"
 #include "cocogen/filegen-driver.h"
 #include "cocogen/filegen-util.h"
-#include "cocogen/str-ast.h"
+#include "cocogen/gen-consistency-functions.h"
+#include "cocogen/gen-trav-functions.h"
 
 #include "lib/array.h"
 #include "lib/memory.h"
 #include "lib/smap.h"
 
-// TODO make enum of mandatory/forbidden/optional.
-static const int MANDATORY = 0;
-static const int FORBIDDEN = 1;
+// Position of a phase in the order in which the phase driver runs them, and
+// the last position of its subphases.
+typedef struct PhaseSpan {
+    int first;
+    int last;
+} PhaseSpan;
 
-static void generate_node(Node *node, FILE *fp, int node_id, bool header) {
-    out("void check_%s(struct %s *node, struct Info *info)", node->id,
-        node->id);
+static void *free_span(char *key, void *span) {
+    mem_free(span);
+    return NULL;
+}
 
-    if (header) {
-        out(";\n\n");
-    } else {
-        out(" {\n");
+static int collect_spans(Phase *phase, int pos, smap_t *spans) {
+    PhaseSpan *span = mem_alloc(sizeof(PhaseSpan));
+    span->first = pos++;
 
-        for (int i = 0; i < array_size(node->children); ++i) {
-            Child *child = (Child *)array_get(node->children, i);
-            out("    // Check mandatoryness for %s\n", child->id);
-            out("    if (node->%s == NULL && "
-                "mandatory_phases[info->phase_id][%d][%d] == %d)\n",
-                child->id, node_id, i, MANDATORY);
-            out("        info->error = 1;\n");
-            out("    if (node->%s != NULL && "
-                "mandatory_phases[info->phase_id][%d][%d] == %d)\n",
-                child->id, node_id, i, FORBIDDEN);
-            out("        info->error = 1;\n");
-            out("    check_%s(node->%s, info);\n\n", child->type, child->id);
-        }
-        out("}\n\n");
+    if (phase->type == PH_subphases) {
+        for (int i = 0; i < array_size(phase->subphases); i++)
+            pos = collect_spans(array_get(phase->subphases, i), pos, spans);
     }
+
+    span->last = pos - 1;
+
+    // A phase used twice keeps the position of its first use.
+    if (smap_retrieve(spans, phase->id) == NULL)
+        smap_insert(spans, phase->id, span);
+    else
+        mem_free(span);
+    return pos;
 }
 
-static void generate_nodeset(Nodeset *nodeset, FILE *fp, bool header) {
-    out("void check_%s(struct %s *nodeset, struct Info *info)", nodeset->id,
-        nodeset->id);
+// Whether the end of 'phase' lies between the start of 'start' and the end
+// of 'end'. A phase ends together with its last subphase.
+static bool phase_in_range(smap_t *spans, char *phase, char *start,
+                           char *end) {
+    PhaseSpan *p = smap_retrieve(spans, phase);
+    PhaseSpan *s = smap_retrieve(spans, start);
+    PhaseSpan *e = smap_retrieve(spans, end);
 
-    if (header) {
-        out(";\n\n");
-        return;
-    } else {
-        out("{\n");
+    if (p == NULL || s == NULL || e == NULL)
+        return false;
+    return s->first <= p->last && p->last <= e->last;
+}
+
+// A child is mandatory in the listed phases, or in all phases but the
+// negated ones if only negated phases are listed.
+static bool child_mandatory(Child *child, char *phase, smap_t *spans) {
+    if (!child->mandatory)
+        return false;
+    if (array_size(child->mandatory_phases) == 0)
+        return true;
+
+    bool has_positive = false;
+    bool positive = false;
+
+    for (int i = 0; i < array_size(child->mandatory_phases); i++) {
+        MandatoryPhase *mp = array_get(child->mandatory_phases, i);
+        bool match;
+
+        if (mp->type == MP_single)
+            match = phase_in_range(spans, phase, mp->value.single,
+                                   mp->value.single);
+        else
+            match = phase_in_range(spans, phase, mp->value.range->start,
+                                   mp->value.range->end);
+
+        if (mp->negation && match)
+            return false;
+        if (!mp->negation) {
+            has_positive = true;
+            positive = positive || match;
+        }
     }
-    out("    switch (nodeset->type) {\n");
-    for (int i = 0; i < array_size(nodeset->nodes); ++i) {
-        Node *node = (Node *)array_get(nodeset->nodes, i);
-        out("    case " NS_FORMAT ":\n", nodeset->id, node->id);
-        out("        check_%s(nodeset->value.val_%s, info);\n", node->id,
-            node->id);
-        out("        break;\n");
+    return has_positive ? positive : true;
+}
+
+static bool has_mandatory_child(Config *config) {
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+        for (int j = 0; j < array_size(node->children); j++) {
+            if (((Child *)array_get(node->children, j))->mandatory)
+                return true;
+        }
     }
-    out("    }\n");
-    out("}\n");
+    return false;
+}
+
+// Only the types that can occur in the tree are checked.
+static bool in_tree(Config *config, char *id) {
+    char *root = config->root_node->id;
+    return strcmp(id, root) == 0 || node_reachable(config, root, id);
+}
+
+static int num_slots(Config *config) {
+    int slots = 0;
+    for (int i = 0; i < array_size(config->nodes); i++)
+        slots += array_size(((Node *)array_get(config->nodes, i))->children);
+    return slots;
 }
 
-/* For every phase, */
-/*     for every node, */
-/*         for every child, */
-/*         for every manatory phase, */
-static void generate_mandatory_array(Config *config, FILE *fp) {
-    out("bool mandatory_phases[][][] = {\n");
-    for (int i = 0; i < array_size(config->phases); ++i) {
-        Phase *phase = (Phase *)array_get(config->phases, i);
-        out("// Phase %s\n", phase->id);
-        for (int j = 0; j < array_size(config->nodes); ++j) {
-            Node *node = (Node *)array_get(config->nodes, j);
-            out("    {\n");
-            out("// Node %s\n", node->id);
-            for (int k = 0; k < array_size(node->children); ++k) {
-                Child *c = (Child *)array_get(node->children, k);
-                out("// Node %s -> Child %s\n", node->id, c->id);
+// Row p has bit s set if child slot s has to be set after phase p. The
+// slots are numbered over the children of all nodes in order.
+static void generate_mandatory_table(Config *config, FILE *fp) {
+    int num_phases = array_size(config->phases);
+    int row_size = (num_slots(config) + 7) / 8;
+    smap_t *spans = smap_init(32);
+
+    if (config->phase_tree != NULL)
+        collect_spans(config->phase_tree, 0, spans);
+
+    if (row_size == 0)
+        row_size = 1;
+
+    out("static const unsigned char mandatory_phases[%d][%d] = {\n",
+        num_phases > 0 ? num_phases : 1, row_size);
+    for (int p = 0; p < num_phases; p++) {
+        Phase *phase = array_get(config->phases, p);
+        unsigned char *row = mem_alloc(row_size);
+        memset(row, 0, row_size);
+
+        int slot = 0;
+        for (int i = 0; i < array_size(config->nodes); i++) {
+            Node *node = array_get(config->nodes, i);
+            for (int j = 0; j < array_size(node->children); j++, slot++) {
+                if (child_mandatory(array_get(node->children, j), phase->id,
+                                    spans))
+                    row[slot / 8] |= 1 << (slot % 8);
             }
-            out("    },\n");
         }
+
+        out("    {");
+        for (int i = 0; i < row_size; i++)
+            out("%s0x%02x", i > 0 ? ", " : "", row[i]);
+        out("}, // %s\n", phase->id);
+        mem_free(row);
     }
-    out("};\n");
+    if (num_phases == 0)
+        out("    {0},\n");
+    out("};\n\n");
+
+    smap_map(spans, free_span);
+    smap_free(spans);
 }
 
-static void generate_info(FILE *fp) {
-    out("struct Info {\n");
-    out("    enum phase phase_id;\n");
-    out("    bool error;\n");
-    out("};\n");
-    out("\n");
+static void generate_phase_names(Config *config, FILE *fp) {
+    out("static const char *phase_names[] = {\n");
+    if (array_size(config->phases) == 0)
+        out("    \"PLACEHOLDER\",\n");
+    for (int i = 0; i < array_size(config->phases); i++) {
+        Phase *phase = array_get(config->phases, i);
+        out("    \"%s\",\n", phase->id);
+    }
+    out("};\n\n");
+}
 
-    out("static struct Info *create_info(enum phase phase_id) {\n");
-    out("     struct Info *info = (struct Info *) malloc(sizeof(struct "
-        "Info));\n");
-    out("     info->phase_id = phase_id;\n");
-    out("     info->error = 0;\n");
-    out("     return info;\n");
-    out("}\n");
+static void generate_check_declarations(Config *config, FILE *fp) {
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+        if (!in_tree(config, node->id))
+            continue;
+        out("static int check_%s(struct %s *node, " PHASE_ENUM_NAME
+            " phase);\n",
+            node->id, node->id);
+    }
+    for (int i = 0; i < array_size(config->nodesets); i++) {
+        Nodeset *nodeset = array_get(config->nodesets, i);
+        if (!in_tree(config, nodeset->id))
+            continue;
+        out("static int check_%s(struct %s *nodeset, " PHASE_ENUM_NAME
+            " phase);\n",
+            nodeset->id, nodeset->id);
+    }
     out("\n");
-
-    out("static void free_info(struct Info *info) {\n");
-    out("     free(info);\n");
-    out("}\n");
 }
 
-static void generate(Config *c, FILE *fp, bool header) {
-    if (header) {
-        out("#pragma once\n");
+// Returns the number of mandatory children missing in the subtree.
+static void generate_check_node(Node *node, int slot, FILE *fp) {
+    out("static int check_%s(struct %s *node, " PHASE_ENUM_NAME
+        " phase) {\n",
+        node->id, node->id);
+    out("    int errors = 0;\n");
+
+    for (int i = 0; i < array_size(node->children); i++, slot++) {
+        Child *child = array_get(node->children, i);
+
+        out("    if (node->%s != NULL) {\n", child->id);
+        out("        errors += check_%s(node->%s, phase);\n", child->type,
+            child->id);
+        if (child->mandatory) {
+            out("    } else if (mandatory_phases[phase][%d] & 0x%02x) {\n",
+                slot / 8, 1 << (slot % 8));
+            out("        print_user_error(\"" CONSISTENCY_PREFIX
+                "check\", \"Mandatory child %s of node %s is missing after "
+                "phase %%s.\", phase_names[phase]);\n",
+                child->id, node->id);
+            out("        errors++;\n");
+        }
+        out("    }\n");
     }
 
-    if (!header) {
-        out("#include \"lib/memory.h\"\n");
-        out("#include \"generated/consistency-ast.h\"\n");
+    out("    return errors;\n");
+    out("}\n\n");
+}
+
+static void generate_check_nodeset(Nodeset *nodeset, FILE *fp) {
+    out("static int check_%s(struct %s *nodeset, " PHASE_ENUM_NAME
+        " phase) {\n",
+        nodeset->id, nodeset->id);
+    out("    switch (nodeset->type) {\n");
+    for (int i = 0; i < array_size(nodeset->nodes); ++i) {
+        Node *node = (Node *)array_get(nodeset->nodes, i);
+        out("    case " NS_FORMAT ":\n", nodeset->id, node->id);
+        out("        return check_%s(nodeset->value.val_%s, phase);\n",
+            node->id, node->id);
     }
+    out("    }\n");
+    out("    return 0;\n");
+    out("}\n\n");
+}
 
-    out("#include \"generated/ast.h\"\n");
-    out("#include <stdbool.h>\n\n");
+static void generate(Config *config, FILE *fp, bool header) {
+    char *root = config->root_node->id;
 
+    out("int " CONSISTENCY_PREFIX "check(struct %s *root, " PHASE_ENUM_NAME
+        " phase)",
+        root);
     if (header) {
-        generate_mandatory_array(c, fp);
-        out("struct Info;\n");
+        out(";\n");
     } else {
-        generate_info(fp);
-    }
-
-    out("// Node create functions\n");
-    for (int i = 0; i < array_size(c->nodes); i++) {
-        generate_node(array_get(c->nodes, i), fp, i, header);
+        out(" {\n");
+        out("    if (root == NULL) return 0;\n");
+        out("    return check_%s(root, phase);\n", root);
+        out("}\n\n");
     }
 
-    out("// Nodeset create functions\n");
-    for (int i = 0; i < array_size(c->nodesets); i++) {
-        generate_nodeset(array_get(c->nodesets, i), fp, header);
+    // Called by the phase driver at the end of every phase.
+    out("void " CONSISTENCY_PREFIX "phase_end(struct %s *root, "
+        PHASE_ENUM_NAME " phase)",
+        root);
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("#ifdef " CONSISTENCY_SAMPLE_MACRO "\n");
+        out("    static %sunsigned long phases_ended;\n",
+            out_thread_local(config));
+        out("    if (phases_ended++ %% (" CONSISTENCY_SAMPLE_MACRO ") != 0) "
+            "return;\n");
+        out("#endif\n");
+        out("    " CONSISTENCY_PREFIX "check(root, phase);\n");
+        out("}\n");
     }
 }
 
-void generate_consistency_definitions(Config *c, FILE *fp) {
-    generate(c, fp, false);
+void generate_consistency_header(Config *config, FILE *fp) {
+    out("#pragma once\n");
+    out("#include \"generated/ast.h\"\n");
+    out("#include \"generated/enum.h\"\n");
+    out("\n");
+
+    out("#ifdef " CONSISTENCY_SAMPLE_MACRO "\n");
+    out("#ifndef " CONSISTENCY_MACRO "\n");
+    out("#define " CONSISTENCY_MACRO "\n");
+    out("#endif\n");
+    out("#endif\n\n");
+
+    out("#ifdef " CONSISTENCY_MACRO "\n");
+    generate(config, fp, true);
+    out("#endif\n");
 }
 
-void generate_consistency_header(Config *c, FILE *fp) {
-    generate(c, fp, true);
+void generate_consistency_definitions(Config *config, FILE *fp) {
+    out("#include \"generated/consistency-ast.h\"\n");
+    out("\n");
+    out("#ifdef " CONSISTENCY_MACRO "\n");
+    out("#include \"lib/print.h\"\n");
+    out("\n");
+
+    if (has_mandatory_child(config)) {
+        generate_mandatory_table(config, fp);
+        generate_phase_names(config, fp);
+    }
+    generate_check_declarations(config, fp);
+
+    int slot = 0;
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+        if (in_tree(config, node->id))
+            generate_check_node(node, slot, fp);
+        slot += array_size(node->children);
+    }
+    for (int i = 0; i < array_size(config->nodesets); i++) {
+        Nodeset *nodeset = array_get(config->nodesets, i);
+        if (in_tree(config, nodeset->id))
+            generate_check_nodeset(nodeset, fp);
+    }
+
+    generate(config, fp, false);
+    out("#endif\n");
 }
@@ -8,7 +8,8 @@
 #include "lib/memory.h"
 #include "lib/smap.h"
 
-static void generate_node(Node *node, FILE *fp, bool header) {
+static void generate_node(Config *config, Node *node, FILE *fp,
+                          bool header) {
     out("struct %s *_copy_%s(struct %s *node, imap_t *imap)", node->id,
         node->id, node->id);
 
@@ -22,11 +23,13 @@ static void generate_node(Node *node, FILE *fp, bool header) {
             node->id);
 
         out("    imap_insert(imap, node, res);\n");
+        out_track_init(config, fp, "    ", "res", node);
 
         for (int i = 0; i < array_size(node->children); i++) {
             Child *c = array_get(node->children, i);
             out("    res->%s = _copy_%s(node->%s, imap);\n", c->id, c->type,
                 c->id);
+            out_track_child(config, fp, "    ", "res", node, c);
         }
 
         for (int i = 0; i < array_size(node->attrs); i++) {
@@ -131,7 +134,7 @@ void generate_copy_node_header(Config *c, FILE *fp, Node *n) {
 
     out("struct %s;\n", n->id);
 
-    generate_node(n, fp, true);
+    generate_node(c, n, fp, true);
 }
 
 void generate_copy_node_definitions(Config *config, FILE *fp, Node *node) {
@@ -141,6 +144,7 @@ void generate_copy_node_definitions(Config *config, FILE *fp, Node *node) {
     out("#include \"lib/memory.h\"\n");
     out("#include \"generated/copy-%s.h\"\n", node->id);
     out("#include \"generated/ast-%s.h\"\n", node->id);
+    out_track_includes(config, fp);
     out("\n");
 
     smap_t *map = smap_init(32);
@@ -179,7 +183,7 @@ void generate_copy_node_definitions(Config *config, FILE *fp, Node *node) {
         out("#include <string.h>\n");
     }
 
-    generate_node(node, fp, false);
+    generate_node(config, node, fp, false);
 }
 
 void generate_copy_nodeset_header(Config *c, FILE *fp, Nodeset *n) {
@@ -9,7 +9,8 @@
 #include "lib/memory.h"
 #include "lib/smap.h"
 
-static void generate_node(Node *node, FILE *fp, bool header) {
+static void generate_node(Config *config, Node *node, FILE *fp,
+                          bool header) {
     out("struct %s *" CREATE_NODE_FORMAT "(", node->id, node->id);
 
     int arg_count = 0;
@@ -56,10 +57,13 @@ static void generate_node(Node *node, FILE *fp, bool header) {
         out("   struct %s *res = mem_alloc(sizeof(struct %s));\n", node->id,
             node->id);
 
+        out_track_init(config, fp, "   ", "res", node);
+
         for (int i = 0; i < array_size(node->children); i++) {
             Child *c = array_get(node->children, i);
             if (c->construct) {
                 out("   res->%s = %s;\n", c->id, c->id);
+                out_track_child(config, fp, "   ", "res", node, c);
             } else {
                 out("   res->%s = NULL;\n", c->id);
             }
@@ -136,24 +140,39 @@ static void generate_node(Node *node, FILE *fp, bool header) {
     }
 }
 
-static void generate_nodeset(Nodeset *nodeset, FILE *fp, bool header) {
+static void generate_nodeset_body(Nodeset *nodeset, Node *node, FILE *fp) {
+    out(" {\n");
+    out("   struct %s *res = mem_alloc(sizeof(struct %s));\n", nodeset->id,
+        nodeset->id);
+
+    out("   res->type = " NS_FORMAT ";\n", nodeset->id, node->id);
+    out("   res->value.val_%s = _%s;\n", node->id, node->id);
+    out("   return res;\n");
+    out("}\n\n");
+}
+
+static void generate_nodeset(Config *config, Nodeset *nodeset, FILE *fp,
+                             bool header) {
+    FILE *measure = out_measure_start();
+    generate_nodeset_body(nodeset, array_get(nodeset->nodes, 0), measure);
+    bool inline_body = out_inline(config, out_measure_end(measure));
+
+    // Inlined functions are defined in the header only.
+    if (inline_body && !header)
+        return;
+
     for (int i = 0; i < array_size(nodeset->nodes); i++) {
         Node *node = array_get(nodeset->nodes, i);
 
+        if (inline_body)
+            out("static inline ");
         out("struct %s *" CREATE_NODESET_FORMAT "(struct %s *_%s)",
             nodeset->id, nodeset->id, node->id, node->id, node->id);
 
-        if (header) {
+        if (header && !inline_body) {
             out(";\n\n");
         } else {
-            out(" {\n");
-            out("   struct %s *res = mem_alloc(sizeof(struct %s));\n",
-                nodeset->id, nodeset->id);
-
-            out("   res->type = " NS_FORMAT ";\n", nodeset->id, node->id);
-            out("   res->value.val_%s = _%s;\n", node->id, node->id);
-            out("   return res;\n");
-            out("}\n\n");
+            generate_nodeset_body(nodeset, node, fp);
         }
     }
 }
@@ -163,22 +182,23 @@ void generate_create_node_header(Config *config, FILE *fp, Node *node) {
     out("#include \"generated/ast-%s.h\"\n", node->id);
     out("\n");
 
-    generate_node(node, fp, true);
+    generate_node(config, node, fp, true);
 }
 
 void generate_create_node_definitions(Config *c, FILE *fp, Node *n) {
     out("#include \"lib/memory.h\"\n");
     out("#include \"generated/ast-%s.h\"\n", n->id);
     out("// ast-%s.h includes the neccesary attribute and children.\n", n->id);
+    out_track_includes(c, fp);
 
-    generate_node(n, fp, false);
+    generate_node(c, n, fp, false);
 }
 
 void generate_create_nodeset_header(Config *c, FILE *fp, Nodeset *n) {
     out("#pragma once\n");
     out("#include \"lib/memory.h\"\n");
     out("#include \"generated/ast.h\"\n\n");
-    generate_nodeset(n, fp, true);
+    generate_nodeset(c, n, fp, true);
 }
 
 void generate_create_nodeset_definitions(Config *c, FILE *fp, Nodeset *n) {
@@ -197,7 +217,7 @@ void generate_create_nodeset_definitions(Config *c, FILE *fp, Nodeset *n) {
 
     smap_free(map);
 
-    generate_nodeset(n, fp, false);
+    generate_nodeset(c, n, fp, false);
 }
 
 void generate_create_header(Config *config, FILE *fp) {
@@ -0,0 +1,251 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "cocogen/ast.h"
+#include "cocogen/config.h"
+#include "cocogen/filegen-util.h"
+#include "cocogen/gen-cursor-functions.h"
+
+#include "lib/array.h"
+
+static void generate_child_case(Node *node, Child *child, int index,
+                                FILE *fp) {
+    out("        case %d:\n", index);
+    if (child->node != NULL) {
+        out("            *child = n->%s;\n", child->id);
+        out("            *child_type = " NT_FORMAT ";\n", child->type);
+        out("            return true;\n");
+        return;
+    }
+
+    // Look through the nodeset to the node it holds.
+    out("            *child = NULL;\n");
+    out("            if (n->%s == NULL) return true;\n", child->id);
+    out("            switch (n->%s->type) {\n", child->id);
+    for (int i = 0; i < array_size(child->nodeset->nodes); i++) {
+        Node *cnode = array_get(child->nodeset->nodes, i);
+        out("            case " NS_FORMAT ":\n", child->type, cnode->id);
+        out("                *child = n->%s->value.val_%s;\n", child->id,
+            cnode->id);
+        out("                *child_type = " NT_FORMAT ";\n", cnode->id);
+        out("                break;\n");
+    }
+    out("            }\n");
+    out("            return true;\n");
+}
+
+// Stores child 'index' of a node, which can be NULL, and returns false when
+// the node has no such child.
+static void generate_child_function(Config *config, FILE *fp) {
+    out("static bool cursor_child(void *node, " NT_ENUM_NAME
+        " type, int index, void **child,\n");
+    out("                         " NT_ENUM_NAME " *child_type) {\n");
+    out("    switch (type) {\n");
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+        if (array_size(node->children) == 0)
+            continue;
+
+        out("    case " NT_FORMAT ": {\n", node->id);
+        out("        struct %s *n = node;\n", node->id);
+        out("        switch (index) {\n");
+        for (int j = 0; j < array_size(node->children); j++)
+            generate_child_case(node, array_get(node->children, j), j, fp);
+        out("        }\n");
+        out("        return false;\n");
+        out("    }\n");
+    }
+    out("    default:\n");
+    out("        return false;\n");
+    out("    }\n");
+    out("}\n\n");
+}
+
+// The cursor returns the nodes in a nodeset with their own type, so a
+// nodeset is matched by the types of its nodes.
+static void generate_match_function(Config *config, FILE *fp) {
+    out("static void cursor_add_match(TypeMask *match, " NT_ENUM_NAME
+        " type) {\n");
+    out("    " TYPEMASK_PREFIX "add(match, type);\n");
+    out("    switch (type) {\n");
+    for (int i = 0; i < array_size(config->nodesets); i++) {
+        Nodeset *nodeset = array_get(config->nodesets, i);
+        out("    case " NT_FORMAT ":\n", nodeset->id);
+        for (int j = 0; j < array_size(nodeset->nodes); j++) {
+            Node *node = array_get(nodeset->nodes, j);
+            out("        " TYPEMASK_PREFIX "add(match, " NT_FORMAT ");\n",
+                node->id);
+        }
+        out("        break;\n");
+    }
+    out("    default:\n");
+    out("        break;\n");
+    out("    }\n");
+    out("}\n\n");
+}
+
+static void generate_push(FILE *fp) {
+    out("static void cursor_push(Cursor *cursor, void *node, " NT_ENUM_NAME
+        " type) {\n");
+    out("    if (cursor->size == cursor->capacity) {\n");
+    out("        CursorFrame *stack =\n");
+    out("            mem_alloc(sizeof(CursorFrame) * cursor->capacity * "
+        "2);\n");
+    out("        memcpy(stack, cursor->stack, sizeof(CursorFrame) * "
+        "cursor->size);\n");
+    out("        mem_free(cursor->stack);\n");
+    out("        cursor->stack = stack;\n");
+    out("        cursor->capacity *= 2;\n");
+    out("    }\n");
+    out("    CursorFrame *frame = &cursor->stack[cursor->size++];\n");
+    out("    frame->node = node;\n");
+    out("    frame->type = type;\n");
+    out("    frame->next_child = -1;\n");
+    out("}\n\n");
+
+    out("static bool cursor_match(Cursor *cursor, " NT_ENUM_NAME
+        " type) {\n");
+    out("    return !cursor->filtered || " TYPEMASK_PREFIX
+        "has(&cursor->match, type);\n");
+    out("}\n\n");
+
+    out("// A subtree is only entered if it can contain the filtered type.\n");
+    out("static bool cursor_enter(Cursor *cursor, " NT_ENUM_NAME
+        " type) {\n");
+    out("    return !cursor->filtered || " TYPEMASK_PREFIX
+        "has(&cursor->scope, type);\n");
+    out("}\n\n");
+}
+
+static void generate(Config *config, FILE *fp, bool header) {
+    out("void " CURSOR_PREFIX "init(Cursor *cursor, void *root, " NT_ENUM_NAME
+        " type, bool post_order)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    cursor->capacity = 32;\n");
+        out("    cursor->stack = mem_alloc(sizeof(CursorFrame) * "
+            "cursor->capacity);\n");
+        out("    cursor->size = 0;\n");
+        out("    cursor->post_order = post_order;\n");
+        out("    cursor->filtered = false;\n");
+        out("    if (root != NULL)\n");
+        out("        cursor_push(cursor, root, type);\n");
+        out("}\n\n");
+    }
+
+    out("void " CURSOR_PREFIX "filter(Cursor *cursor, " NT_ENUM_NAME
+        " type)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    " TYPEMASK_PREFIX "clear(&cursor->match);\n");
+        out("    cursor_add_match(&cursor->match, type);\n");
+        out("    " REACH_PREFIX "scope(&cursor->scope, &cursor->match);\n");
+        out("    cursor->filtered = true;\n");
+        out("    if (cursor->size == 1 && cursor->stack[0].next_child == -1 "
+            "&&\n");
+        out("        !cursor_enter(cursor, cursor->stack[0].type))\n");
+        out("        cursor->size = 0;\n");
+        out("}\n\n");
+    }
+
+    out("void *" CURSOR_PREFIX "next(Cursor *cursor, " NT_ENUM_NAME
+        " *type)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    while (cursor->size > 0) {\n");
+        out("        CursorFrame *top = &cursor->stack[cursor->size - 1];\n");
+        out("        if (top->next_child == -1) {\n");
+        out("            top->next_child = 0;\n");
+        out("            if (!cursor->post_order && cursor_match(cursor, "
+            "top->type)) {\n");
+        out("                if (type != NULL) *type = top->type;\n");
+        out("                return top->node;\n");
+        out("            }\n");
+        out("            continue;\n");
+        out("        }\n\n");
+
+        out("        void *child = NULL;\n");
+        out("        " NT_ENUM_NAME " child_type = top->type;\n");
+        out("        if (cursor_child(top->node, top->type, "
+            "top->next_child++, &child,\n");
+        out("                         &child_type)) {\n");
+        out("            if (child != NULL && cursor_enter(cursor, "
+            "child_type))\n");
+        out("                cursor_push(cursor, child, child_type);\n");
+        out("            continue;\n");
+        out("        }\n\n");
+
+        out("        // All children are done, leave the node.\n");
+        out("        cursor->size--;\n");
+        out("        if (cursor->post_order && cursor_match(cursor, "
+            "top->type)) {\n");
+        out("            if (type != NULL) *type = top->type;\n");
+        out("            return top->node;\n");
+        out("        }\n");
+        out("    }\n");
+        out("    return NULL;\n");
+        out("}\n\n");
+    }
+
+    out("void " CURSOR_PREFIX "free(Cursor *cursor)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    mem_free(cursor->stack);\n");
+        out("    cursor->stack = NULL;\n");
+        out("    cursor->size = 0;\n");
+        out("}\n");
+    }
+}
+
+void generate_cursor_header(Config *config, FILE *fp) {
+    out("#pragma once\n");
+    out("#include <stdbool.h>\n");
+    out("#include \"generated/enum.h\"\n");
+    out("#include \"generated/reach.h\"\n");
+    out("\n");
+
+    out("typedef struct CursorFrame {\n");
+    out("    void *node;\n");
+    out("    " NT_ENUM_NAME " type;\n");
+    out("    // Next child to visit, -1 if the node is not visited yet.\n");
+    out("    int next_child;\n");
+    out("} CursorFrame;\n\n");
+
+    out("// Iterator over the nodes of a subtree, in pre-order or "
+        "post-order.\n");
+    out("typedef struct Cursor {\n");
+    out("    CursorFrame *stack;\n");
+    out("    int size;\n");
+    out("    int capacity;\n");
+    out("    bool post_order;\n");
+    out("    bool filtered;\n");
+    out("    // Types of the nodes that are returned.\n");
+    out("    TypeMask match;\n");
+    out("    // Types of the nodes which can have the filtered types below "
+        "them.\n");
+    out("    TypeMask scope;\n");
+    out("} Cursor;\n\n");
+
+    generate(config, fp, true);
+}
+
+void generate_cursor_definitions(Config *config, FILE *fp) {
+    out("#include <string.h>\n");
+    out("#include \"generated/ast.h\"\n");
+    out("#include \"generated/cursor.h\"\n");
+    out("#include \"lib/memory.h\"\n");
+    out("\n");
+
+    generate_child_function(config, fp);
+    generate_match_function(config, fp);
+    generate_push(fp);
+    generate(config, fp, false);
+}
@@ -50,7 +50,8 @@ static void generate_nodeset(Nodeset *nodeset, FILE *fp, bool header) {
     }
 }
 
-static void generate_node(Node *node, FILE *fp, bool header) {
+static void generate_node(Config *config, Node *node, FILE *fp,
+                          bool header) {
     out("void " FREE_TREE_FORMAT "(struct %s* node)", node->id, node->id);
 
     if (header) {
@@ -60,7 +61,8 @@ static void generate_node(Node *node, FILE *fp, bool header) {
 
         for (int i = 0; i < array_size(node->children); ++i) {
             Child *child = (Child *)array_get(node->children, i);
-            out("    " FREE_TREE_FORMAT "(node->%s);\n", child->type,
+            out("    if (node->%s != NULL)\n", child->id);
+            out("        " FREE_TREE_FORMAT "(node->%s);\n", child->type,
                 child->id);
         }
 
@@ -72,8 +74,18 @@ static void generate_node(Node *node, FILE *fp, bool header) {
                 out("    mem_free(node->%s);\n", attr->id);
             }
         }
+        for (int i = 0; i < array_size(node->computed); ++i) {
+            Attr *attr = (Attr *)array_get(node->computed, i);
+            if (attr->type == AT_string) {
+                out("    mem_free(node->%s);\n", attr->id);
+            }
+        }
 
-        /* out("    "); */
+        if (config->census)
+            out("    " CENSUS_PREFIX "remove(" NT_FORMAT ", node->_census);\n",
+                node->id);
+        if (config->presence)
+            out("    " PRESENCE_PREFIX "remove(" NT_FORMAT ");\n", node->id);
         out("    mem_free(node);\n");
         out("}\n");
     }
@@ -93,6 +105,17 @@ static void generate_node(Node *node, FILE *fp, bool header) {
                 out("    mem_free(node->%s);\n", attr->id);
             }
         }
+        for (int i = 0; i < array_size(node->computed); ++i) {
+            Attr *attr = (Attr *)array_get(node->computed, i);
+            if (attr->type == AT_string) {
+                out("    mem_free(node->%s);\n", attr->id);
+            }
+        }
+        if (config->census)
+            out("    " CENSUS_PREFIX "remove(" NT_FORMAT ", node->_census);\n",
+                node->id);
+        if (config->presence)
+            out("    " PRESENCE_PREFIX "remove(" NT_FORMAT ");\n", node->id);
         out("    mem_free(node);\n");
         out("}\n");
     }
@@ -104,7 +127,7 @@ void generate_free_node_header(Config *c, FILE *fp, Node *n) {
     out("#include <string.h>\n");
     out("#include \"lib/memory.h\"\n");
     out("#include \"generated/ast.h\"\n");
-    generate_node(n, fp, true);
+    generate_node(c, n, fp, true);
 }
 
 void generate_free_node_definitions(Config *c, FILE *fp, Node *n) {
@@ -123,7 +146,12 @@ void generate_free_node_definitions(Config *c, FILE *fp, Node *n) {
 
     smap_free(map);
 
-    generate_node(n, fp, false);
+    if (c->census)
+        out("#include \"generated/census.h\"\n");
+    if (c->presence)
+        out("#include \"generated/presence.h\"\n");
+
+    generate_node(c, n, fp, false);
 }
 
 void generate_free_nodeset_header(Config *c, FILE *fp, Nodeset *n) {
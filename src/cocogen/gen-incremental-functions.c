@@ -0,0 +1,98 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "cocogen/ast.h"
+#include "cocogen/config.h"
+#include "cocogen/filegen-util.h"
+#include "cocogen/gen-incremental-functions.h"
+
+static void generate(Config *config, FILE *fp, bool header) {
+    out("void " INCREMENTAL_PREFIX "init(void *node)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    NodeTrack *track = node;\n");
+        out("    track->epoch = %s;\n", out_epoch(config));
+        out("    track->subtree_epoch = track->epoch;\n");
+        out("}\n\n");
+    }
+
+    // Ancestors which were already marked during the current epoch have
+    // marked their own ancestors as well, so propagation can stop there.
+    out("void " INCREMENTAL_PREFIX "mark(void *node)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    NodeTrack *track = node;\n");
+        out("    if (track == NULL) return;\n");
+        out("    unsigned long epoch = %s;\n", out_epoch(config));
+        out("    track->epoch = epoch;\n");
+        out("    while (track != NULL && track->subtree_epoch != epoch) {\n");
+        out("        track->subtree_epoch = epoch;\n");
+        out("        track = track->parent;\n");
+        out("    }\n");
+        out("}\n\n");
+    }
+
+    // The epochs of the last runs are kept in the root node of each tree.
+    // Without them, as for a traversal started on another node, the whole
+    // subtree is visited.
+    out("unsigned long " INCREMENTAL_PREFIX "begin(unsigned long *last_run, "
+        TRAV_ENUM_NAME " trav)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    unsigned long epoch = %s;\n", out_epoch_advance(config));
+        out("    if (last_run == NULL) return 0;\n");
+        out("    unsigned long since = last_run[trav];\n");
+        out("    last_run[trav] = epoch;\n");
+        out("    return since;\n");
+        out("}\n\n");
+    }
+
+    out("bool " INCREMENTAL_PREFIX "visit(void *node)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    return ((NodeTrack *)node)->subtree_epoch >= " TRAV_PREFIX
+            "since();\n");
+        out("}\n\n");
+    }
+
+    out("bool " INCREMENTAL_PREFIX "changed(void *node)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    return ((NodeTrack *)node)->epoch >= " TRAV_PREFIX
+            "since();\n");
+        out("}\n");
+    }
+}
+
+void generate_incremental_header(Config *config, FILE *fp) {
+    out("#pragma once\n");
+    out("#include <stdbool.h>\n");
+    out("#include <stddef.h>\n");
+    out("#include \"generated/enum.h\"\n");
+    out("// Defines NodeTrack, which holds the epochs of changes.\n");
+    out("#include \"generated/parent.h\"\n");
+    out("\n");
+
+    out("extern unsigned long " INCREMENTAL_PREFIX "epoch;\n\n");
+
+    generate(config, fp, true);
+}
+
+void generate_incremental_definitions(Config *config, FILE *fp) {
+    out("#include \"generated/incremental.h\"\n");
+    out("#include \"generated/trav-core.h\"\n");
+    out("\n");
+    out("unsigned long " INCREMENTAL_PREFIX "epoch = 1;\n\n");
+
+    generate(config, fp, false);
+}
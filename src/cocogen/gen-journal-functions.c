@@ -0,0 +1,189 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "cocogen/ast.h"
+#include "cocogen/config.h"
+#include "cocogen/filegen-util.h"
+#include "cocogen/gen-journal-functions.h"
+
+// Returns a new record at the end of the journal, which grows when it is
+// full.
+static void generate_new_record(FILE *fp) {
+    out("static UndoRecord *new_record(void) {\n");
+    out("    if (size == capacity) {\n");
+    out("        capacity = capacity ? capacity * 2 : 64;\n");
+    out("        UndoRecord *new_records = mem_alloc(sizeof(UndoRecord) "
+        "* capacity);\n");
+    out("        if (size > 0) {\n");
+    out("            memcpy(new_records, records, sizeof(UndoRecord) * "
+        "size);\n");
+    out("            mem_free(records);\n");
+    out("        }\n");
+    out("        records = new_records;\n");
+    out("    }\n");
+    out("    return &records[size++];\n");
+    out("}\n\n");
+}
+
+static void generate(Config *config, FILE *fp, bool header) {
+    out("void " TX_PREFIX "begin(void)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    if (depth == capacity_marks) {\n");
+        out("        capacity_marks = capacity_marks ? capacity_marks * 2 "
+            ": 8;\n");
+        out("        int *new_marks = mem_alloc(sizeof(int) * "
+            "capacity_marks);\n");
+        out("        if (depth > 0) {\n");
+        out("            memcpy(new_marks, marks, sizeof(int) * depth);\n");
+        out("            mem_free(marks);\n");
+        out("        }\n");
+        out("        marks = new_marks;\n");
+        out("    }\n");
+        out("    marks[depth++] = size;\n");
+        out("}\n\n");
+    }
+
+    // A nested transaction which commits leaves its records to the
+    // enclosing one, which can still roll them back.
+    out("void " TX_PREFIX "commit(void)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    if (depth == 0) return;\n");
+        out("    if (--depth == 0) size = 0;\n");
+        out("}\n\n");
+    }
+
+    out("void " TX_PREFIX "rollback(void)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    if (depth == 0) return;\n");
+        out("    int mark = marks[--depth];\n");
+        out("    while (size > mark) {\n");
+        out("        UndoRecord *record = &records[--size];\n");
+        if (config->census) {
+            out("        if (record->field == NULL) {\n");
+            out("            " CENSUS_PREFIX "set(record->type, record->node, "
+                "record->old.u);\n");
+            out("            continue;\n");
+            out("        }\n");
+        }
+        out("        memcpy(record->field, &record->old, record->size);\n");
+        if (config->incremental) {
+            // The epochs only increase, the restored fields are a new
+            // change.
+            out("        if (record->node != NULL)\n");
+            out("            " INCREMENTAL_PREFIX "mark(record->node);\n");
+        }
+        out("    }\n");
+        out("}\n\n");
+    }
+
+    out("bool " TX_PREFIX "active(void)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    return depth > 0;\n");
+        out("}\n\n");
+    }
+
+    out("void " TX_PREFIX "log(void *node, void *field, size_t field_size)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    if (depth == 0) return;\n");
+        out("    UndoRecord *record = new_record();\n");
+        out("    record->node = node;\n");
+        out("    record->field = field;\n");
+        out("    record->size = field_size;\n");
+        out("    memcpy(&record->old, field, field_size);\n");
+        out("}\n");
+    }
+
+    if (!config->census)
+        return;
+    if (!header)
+        out("\n");
+
+    // A rollback puts the node back in the census if 'indexed', or takes it
+    // out otherwise.
+    out("void " TX_PREFIX "log_census(" NT_ENUM_NAME
+        " type, void *node, bool indexed)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    if (depth == 0) return;\n");
+        out("    UndoRecord *record = new_record();\n");
+        out("    record->node = node;\n");
+        out("    record->field = NULL;\n");
+        out("    record->type = type;\n");
+        out("    record->old.u = indexed;\n");
+        out("}\n");
+    }
+}
+
+void generate_journal_header(Config *config, FILE *fp) {
+    out("#pragma once\n");
+    out("#include <stdbool.h>\n");
+    out("#include <stddef.h>\n");
+    if (config->census)
+        out("#include \"generated/enum.h\"\n");
+    out("\n");
+
+    generate(config, fp, true);
+}
+
+void generate_journal_definitions(Config *config, FILE *fp) {
+    char *tl = out_thread_local(config);
+
+    out("#include <stdint.h>\n");
+    out("#include <string.h>\n");
+    out("#include \"generated/journal.h\"\n");
+    if (config->batch || config->parallel)
+        out("#include \"generated/enum.h\"\n");
+    if (config->incremental)
+        out("#include \"generated/incremental.h\"\n");
+    if (config->census)
+        out("#include \"generated/census.h\"\n");
+    out("#include \"lib/memory.h\"\n");
+    out("\n");
+
+    out("// Old value of a field of a node, 'node' is NULL if restoring the "
+        "field is not\n// a change of the node.\n");
+    if (config->census)
+        out("// Without a field, whether the node was in the census.\n");
+    out("typedef struct UndoRecord {\n");
+    out("    void *node;\n");
+    out("    void *field;\n");
+    out("    size_t size;\n");
+    if (config->census)
+        out("    " NT_ENUM_NAME " type;\n");
+    out("    union {\n");
+    out("        void *p;\n");
+    out("        uint64_t u;\n");
+    out("        double d;\n");
+    out("    } old;\n");
+    out("} UndoRecord;\n\n");
+
+    out("// Records of all open transactions, oldest first.\n");
+    out("static %sUndoRecord *records;\n", tl);
+    out("static %sint size;\n", tl);
+    out("static %sint capacity;\n\n", tl);
+
+    out("// Number of records when each open transaction began.\n");
+    out("static %sint *marks;\n", tl);
+    out("static %sint depth;\n", tl);
+    out("static %sint capacity_marks;\n\n", tl);
+
+    generate_new_record(fp);
+    generate(config, fp, false);
+}
@@ -0,0 +1,178 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cocogen/ast.h"
+#include "cocogen/config.h"
+#include "cocogen/filegen-util.h"
+#include "cocogen/gen-mutate-functions.h"
+#include "cocogen/str-ast.h"
+
+#include "lib/array.h"
+#include "lib/memory.h"
+
+static void generate_child(Config *config, Node *node, Child *child,
+                           FILE *fp, bool header) {
+    out("void " SET_FIELD_FORMAT "(struct %s *node, struct %s *value)",
+        node->id, child->id, node->id, child->type);
+    if (header) {
+        out(";\n");
+        return;
+    }
+
+    out(" {\n");
+    out_journal(config, fp, "    ", "node", child->id);
+    out("    node->%s = value;\n", child->id);
+    out_count_change(config, fp, "    ");
+    out_track_child(config, fp, "    ", "node", node, child);
+    if (config->incremental)
+        out("    " INCREMENTAL_PREFIX "mark(node);\n");
+    out("}\n\n");
+}
+
+static void generate_attr(Config *config, Node *node, Attr *attr, FILE *fp,
+                          bool header) {
+    char *type = str_attr_type(attr);
+
+    out("void " SET_FIELD_FORMAT "(struct %s *node, %s value)", node->id,
+        attr->id, node->id, type);
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out_journal(config, fp, "    ", "node", attr->id);
+        out("    node->%s = value;\n", attr->id);
+        out_count_change(config, fp, "    ");
+        if (config->incremental)
+            out("    " INCREMENTAL_PREFIX "mark(node);\n");
+        out("}\n\n");
+    }
+
+    if (attr->type == AT_link)
+        mem_free(type);
+}
+
+// Start of a list operation on the list linked by child of node.
+static void out_list_func(Node *node, Child *child, FILE *fp, char *op,
+                          char *params, bool header) {
+    out("struct %s *" LIST_FORMAT "(%s)", node->id, node->id, child->id, op,
+        params);
+    if (header)
+        out(";\n");
+    else
+        out(" {\n");
+}
+
+// Operations on a list of nodes linked by a child of their own type, like a
+// list of statements. All links are made with the set functions, and the
+// functions return the node to continue from or to store in the parent.
+static void generate_list(Node *node, Child *child, FILE *fp, bool header) {
+    char *n = node->id;
+    char *c = child->id;
+    char params[256];
+
+    snprintf(params, sizeof(params), "struct %s *list", n);
+    out_list_func(node, child, fp, "tail", params, header);
+    if (!header) {
+        out("    if (list == NULL) return NULL;\n");
+        out("    while (list->%s != NULL)\n", c);
+        out("        list = list->%s;\n", c);
+        out("    return list;\n");
+        out("}\n\n");
+    }
+
+    snprintf(params, sizeof(params), "struct %s *elem, struct %s *list", n,
+             n);
+    out_list_func(node, child, fp, "insert_after", params, header);
+    if (!header) {
+        out("    if (list == NULL) return elem;\n");
+        out("    struct %s *tail = " LIST_FORMAT "(list);\n", n, n, c,
+            "tail");
+        out("    " SET_FIELD_FORMAT "(tail, elem->%s);\n", n, c, c);
+        out("    " SET_FIELD_FORMAT "(elem, list);\n", n, c);
+        out("    return tail;\n");
+        out("}\n\n");
+    }
+
+    out_list_func(node, child, fp, "insert_before", params, header);
+    if (!header) {
+        out("    if (list == NULL) return elem;\n");
+        out("    " SET_FIELD_FORMAT "(" LIST_FORMAT "(list), elem);\n", n, c,
+            n, c, "tail");
+        out("    return list;\n");
+        out("}\n\n");
+    }
+
+    out_list_func(node, child, fp, "splice", params, header);
+    if (!header) {
+        out("    struct %s *next = elem->%s;\n", n, c);
+        out("    " SET_FIELD_FORMAT "(elem, NULL);\n", n, c);
+        out("    if (list == NULL) return next;\n");
+        out("    " SET_FIELD_FORMAT "(" LIST_FORMAT "(list), next);\n", n, c,
+            n, c, "tail");
+        out("    return list;\n");
+        out("}\n\n");
+    }
+
+    snprintf(params, sizeof(params), "struct %s *elem", n);
+    out_list_func(node, child, fp, "remove", params, header);
+    if (!header) {
+        out("    struct %s *next = elem->%s;\n", n, c);
+        out("    " SET_FIELD_FORMAT "(elem, NULL);\n", n, c);
+        out("    return next;\n");
+        out("}\n\n");
+    }
+
+    out_list_func(node, child, fp, "remove_after", params, header);
+    if (!header) {
+        out("    struct %s *removed = elem->%s;\n", n, c);
+        out("    if (removed == NULL) return NULL;\n");
+        out("    " SET_FIELD_FORMAT "(elem, removed->%s);\n", n, c, c);
+        out("    " SET_FIELD_FORMAT "(removed, NULL);\n", n, c);
+        out("    return removed;\n");
+        out("}\n\n");
+    }
+}
+
+static void generate_node(Config *config, Node *node, FILE *fp,
+                          bool header) {
+    for (int i = 0; i < array_size(node->children); i++) {
+        generate_child(config, node, array_get(node->children, i), fp,
+                       header);
+    }
+
+    for (int i = 0; i < array_size(node->attrs); i++) {
+        generate_attr(config, node, array_get(node->attrs, i), fp, header);
+    }
+
+    for (int i = 0; i < array_size(node->children); i++) {
+        Child *child = array_get(node->children, i);
+        if (child->node != NULL && strcmp(child->type, node->id) == 0)
+            generate_list(node, child, fp, header);
+    }
+}
+
+void generate_mutate_header(Config *config, FILE *fp) {
+    out("#pragma once\n");
+    for (int i = 0; i < array_size(config->nodes); ++i) {
+        Node *node = array_get(config->nodes, i);
+        out("#include \"generated/mutate-%s.h\"\n", node->id);
+    }
+}
+
+void generate_mutate_node_header(Config *config, FILE *fp, Node *node) {
+    out("#pragma once\n");
+    out("#include \"generated/ast-%s.h\"\n", node->id);
+    out("\n");
+
+    generate_node(config, node, fp, true);
+}
+
+void generate_mutate_node_definitions(Config *config, FILE *fp, Node *node) {
+    out("#include <stddef.h>\n");
+    out("#include \"generated/mutate-%s.h\"\n", node->id);
+    out_track_includes(config, fp);
+    out("\n");
+
+    generate_node(config, node, fp, false);
+}
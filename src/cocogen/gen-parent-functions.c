@@ -0,0 +1,142 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "cocogen/ast.h"
+#include "cocogen/config.h"
+#include "cocogen/filegen-util.h"
+#include "cocogen/gen-parent-functions.h"
+
+static void generate_slot_enum(Config *config, FILE *fp) {
+    out("// Child of a node in which another node is stored.\n");
+    out("typedef enum {\n");
+    out("    " CS_ENUM_PREFIX "NULL,\n");
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+        for (int j = 0; j < array_size(node->children); j++) {
+            Child *child = array_get(node->children, j);
+            out("    " CS_FORMAT ",\n", node->id, child->id);
+        }
+    }
+    out("} " CS_ENUM_NAME ";\n\n");
+}
+
+// Node type of the parent of every child slot, indexed by the slot.
+static void generate_slot_table(Config *config, FILE *fp) {
+    out("static const " NT_ENUM_NAME " slot_parent_types[] = {\n");
+    out("    0,\n");
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+        for (int j = 0; j < array_size(node->children); j++)
+            out("    " NT_FORMAT ",\n", node->id);
+    }
+    out("};\n\n");
+}
+
+static void generate(Config *config, FILE *fp, bool header) {
+    out("void " PARENT_PREFIX "init(void *node)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    NodeTrack *track = node;\n");
+        out("    track->parent = NULL;\n");
+        out("    track->slot = " CS_ENUM_PREFIX "NULL;\n");
+        out("}\n\n");
+    }
+
+    out("void " PARENT_PREFIX "set(void *node, void *parent, " CS_ENUM_NAME
+        " slot)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    if (node == NULL) return;\n");
+        out("    NodeTrack *track = node;\n");
+        if (config->journal) {
+            out("    " TX_PREFIX "log(NULL, &track->parent, "
+                "sizeof(track->parent));\n");
+            out("    " TX_PREFIX "log(NULL, &track->slot, "
+                "sizeof(track->slot));\n");
+        }
+        out("    track->parent = parent;\n");
+        out("    track->slot = slot;\n");
+        out("}\n\n");
+    }
+
+    out("void *" PARENT_PREFIX "of(void *node)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    return ((NodeTrack *)node)->parent;\n");
+        out("}\n\n");
+    }
+
+    out(CS_ENUM_NAME " " PARENT_PREFIX "slot(void *node)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    return ((NodeTrack *)node)->slot;\n");
+        out("}\n\n");
+    }
+
+    // Only meaningful for nodes that have a parent.
+    out(NT_ENUM_NAME " " PARENT_PREFIX "type(void *node)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    return slot_parent_types[((NodeTrack *)node)->slot];\n");
+        out("}\n\n");
+    }
+
+    out("void *" PARENT_PREFIX "find(void *node, " NT_ENUM_NAME " type)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    NodeTrack *track = node;\n");
+        out("    while (track->parent != NULL) {\n");
+        out("        if (slot_parent_types[track->slot] == type)\n");
+        out("            return track->parent;\n");
+        out("        track = track->parent;\n");
+        out("    }\n");
+        out("    return NULL;\n");
+        out("}\n");
+    }
+}
+
+void generate_parent_header(Config *config, FILE *fp) {
+    out("#pragma once\n");
+    out("#include <stddef.h>\n");
+    out("#include \"generated/enum.h\"\n");
+    out("\n");
+
+    generate_slot_enum(config, fp);
+
+    out("// Bookkeeping of a node, the first member of every node.\n");
+    out("typedef struct NodeTrack {\n");
+    out("    void *parent;\n");
+    out("    " CS_ENUM_NAME " slot;\n");
+    if (config->incremental) {
+        out("    // Epoch in which the node itself was last changed.\n");
+        out("    unsigned long epoch;\n");
+        out("    // Epoch in which the node or one of its descendants was "
+            "last changed.\n");
+        out("    unsigned long subtree_epoch;\n");
+    }
+    out("} NodeTrack;\n\n");
+
+    generate(config, fp, true);
+}
+
+void generate_parent_definitions(Config *config, FILE *fp) {
+    out("#include \"generated/parent.h\"\n");
+    if (config->journal)
+        out("#include \"generated/journal.h\"\n");
+    out("\n");
+
+    generate_slot_table(config, fp);
+    generate(config, fp, false);
+}
@@ -1,64 +1,1426 @@
 #include "cocogen/ast.h"
+#include "cocogen/config.h"
 #include "cocogen/filegen-driver.h"
 #include "cocogen/filegen-util.h"
+#include "cocogen/gen-trav-functions.h"
 #include "cocogen/str-ast.h"
 #include "lib/memory.h"
+#include "lib/print.h"
+#include "lib/smap.h"
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 static inline void print_indent(int level, char *single_indent, FILE *fp) {
     for (int i = 0; i < level; i++)
         out(single_indent);
 }
 
-static void print_phase_tree(Phase *p, int level, FILE *fp,
-                             char *root_node_name) {
+static void print_trace(char *ind, int level, char *single_indent,
+                        char *name, FILE *fp) {
+    out("%sPHASE_TRACE(\"", ind);
+    print_indent(level, single_indent, fp);
+    out(" %s\\n\");\n", name);
+}
+
+// Entry of the report for every phase and pass, numbered in the order in
+// which the phasedriver starts them.
+static void print_report_entries(Phase *p, int level, FILE *fp) {
+    out("    {\"%s\", \"phase\", %d},\n", p->id, level);
+
+    if (p->type == PH_subphases) {
+        for (int i = 0; i < array_size(p->subphases); i++)
+            print_report_entries(array_get(p->subphases, i), level + 1, fp);
+        return;
+    }
+
+    for (int i = 0; i < array_size(p->passes); i++) {
+        PhaseLeaf *leaf = array_get(p->passes, i);
+
+        if (leaf->type == PL_fusion) {
+            Fusion *fusion = leaf->value.fusion;
+            out("    {\"");
+            for (int j = 0; j < array_size(fusion->traversals); j++) {
+                Traversal *trav = array_get(fusion->traversals, j);
+                out("%s%s", j > 0 ? "+" : "", trav->id);
+            }
+            out("\", \"fusion\", %d},\n", level + 1);
+        } else if (leaf->type == PL_traversal) {
+            out("    {\"%s\", \"traversal\", %d},\n",
+                leaf->value.traversal->id, level + 1);
+        } else {
+            out("    {\"%s\", \"pass\", %d},\n", leaf->value.pass->id,
+                level + 1);
+        }
+    }
+}
+
+static int count_report_entries(Phase *p) {
+    int entries = 1;
+
+    if (p->type == PH_subphases) {
+        for (int i = 0; i < array_size(p->subphases); i++)
+            entries += count_report_entries(array_get(p->subphases, i));
+    } else {
+        entries += array_size(p->passes);
+    }
+    return entries;
+}
+
+// Add the node types handled by 'trav' that can occur in the tree to 'mask'.
+// Returns false if the traversal handles all node types.
+static bool add_handled_types(Config *config, Traversal *trav,
+                              unsigned char *mask) {
+    char *root = config->root_node->id;
+
+    if (trav->nodes == NULL)
+        return false;
+
+    for (int i = 0; i < array_size(trav->nodes); i++) {
+        char *id = array_get(trav->nodes, i);
+        if (strcmp(id, root) != 0 && !node_reachable(config, root, id))
+            continue;
+
+        for (int j = 0; j < array_size(config->nodes); j++) {
+            Node *node = array_get(config->nodes, j);
+            if (strcmp(node->id, id) == 0)
+                mask[j / 8] |= 1 << (j % 8);
+        }
+    }
+    return true;
+}
+
+// Print the condition under which the traversals run, or nothing if they
+// have to run on every tree.
+static void print_presence_guard(Config *config, array *travs, char *ind,
+                                 FILE *fp) {
+    int types = array_size(config->nodes) + array_size(config->nodesets);
+    int size = (types + 7) / 8;
+    unsigned char *mask = mem_alloc(size);
+    memset(mask, 0, size);
+
+    bool skippable = config->presence;
+    for (int i = 0; i < array_size(travs) && skippable; i++)
+        skippable = add_handled_types(config, array_get(travs, i), mask);
+
+    if (skippable) {
+        out("%sif (" PRESENCE_PREFIX "any(&(const TypeMask){{", ind);
+        for (int i = 0; i < size; i++)
+            out("%s0x%02x", i > 0 ? ", " : "", mask[i]);
+        out("}}))\n    ");
+    }
+    mem_free(mask);
+}
+
+// Position in the phase tree while the phasedriver is generated.
+typedef struct DriverPos {
+    // Next entry of the report.
+    int entry;
+    // Next leaf. Checkpoints are taken at the boundaries between leaves.
+    int leaf;
+    int num_leaves;
+    // Last boundary at which a checkpoint is written.
+    int written;
+    // Inside a cycle phase no checkpoints are written.
+    bool in_cycle;
+    // Boundaries after checkpoint phases, NULL without checkpoints.
+    bool *boundaries;
+} DriverPos;
+
+static int count_leaves(Phase *p) {
+    if (p->type != PH_subphases)
+        return array_size(p->passes);
+
+    int leaves = 0;
+    for (int i = 0; i < array_size(p->subphases); i++)
+        leaves += count_leaves(array_get(p->subphases, i));
+    return leaves;
+}
+
+static int phase_index(Config *config, char *id) {
+    for (int i = 0; i < array_size(config->phases); i++) {
+        if (strcmp(((Phase *)array_get(config->phases, i))->id, id) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// Store the first leaf and the boundary after the last leaf of every phase,
+// and mark the boundaries after checkpoint phases. A phase used twice keeps
+// the leaves of its first use. Returns the next leaf.
+static int collect_leaves(Config *config, Phase *p, int leaf, int (*leaves)[2],
+                          bool *boundaries) {
+    int first = leaf;
+
+    if (p->type == PH_subphases) {
+        for (int i = 0; i < array_size(p->subphases); i++)
+            leaf = collect_leaves(config, array_get(p->subphases, i), leaf,
+                                  leaves, boundaries);
+    } else {
+        leaf += array_size(p->passes);
+    }
+
+    int index = phase_index(config, p->id);
+    if (index >= 0 && leaves[index][0] < 0) {
+        leaves[index][0] = first;
+        leaves[index][1] = leaf;
+    }
+    if (p->checkpoint)
+        boundaries[leaf] = true;
+    return leaf;
+}
+
+// Whether a checkpoint is written at the end of 'p' or of one of its
+// subphases, following the conditions in print_phase_tree.
+static bool writes_checkpoint(Phase *p, int *leaf, bool in_cycle,
+                              DriverPos *pos) {
+    bool writes = false;
+
+    if (p->type == PH_subphases) {
+        for (int i = 0; i < array_size(p->subphases); i++)
+            writes = writes_checkpoint(array_get(p->subphases, i), leaf,
+                                       in_cycle || p->cycle, pos) ||
+                     writes;
+    } else {
+        *leaf += array_size(p->passes);
+    }
+
+    if (!in_cycle && (pos->boundaries[*leaf] || *leaf < pos->num_leaves))
+        return true;
+    return writes;
+}
+
+// Leaves before start and from stop on are skipped, so that the phases can
+// resume from a checkpoint and stop after any phase.
+static char *print_leaf_guard(Config *config, int leaf, char *ind,
+                              FILE *fp) {
+    if (!config->checkpoints)
+        return ind;
+
+    out("%sif (start <= %d && %d < stop) {\n", ind, leaf, leaf);
+    return out_format("%s    ", ind);
+}
+
+// A phase is only traced and reported if some of its leaves run.
+static char *print_phase_guard(Config *config, int first, int end, char *ind,
+                               FILE *fp) {
+    if (!config->checkpoints)
+        return ind;
+
+    out("%sif (start < %d && %d < stop) {\n", ind, end, first);
+    return out_format("%s    ", ind);
+}
+
+static void print_leaf_guard_end(Config *config, char *ind, char *outer,
+                                 FILE *fp) {
+    if (!config->checkpoints)
+        return;
+
+    mem_free(ind);
+    out("%s}\n", outer);
+}
+
+static void print_phase_tree(Config *config, Phase *p, int level, FILE *fp,
+                             char *root_node_name, DriverPos *pos,
+                             char *ind) {
+    int phase_entry = pos->entry++;
+    int first = pos->leaf;
+    int end = first + count_leaves(p);
 
     // Omit printing the name of the root phase
-    if (level > 0) {
-        out("    printf(\"");
-        print_indent(level, "**", fp);
-        out(" %s\\n\");\n", p->info != NULL ? p->info : p->id);
+    char *guarded = print_phase_guard(config, first, end, ind, fp);
+    if (level > 0)
+        print_trace(guarded, level, "**", p->info != NULL ? p->info : p->id,
+                    fp);
+    out("%sPHASE_REPORT_BEGIN(%d);\n", guarded, phase_entry);
+    print_leaf_guard_end(config, guarded, ind, fp);
+
+    // A cycle phase runs again until an iteration makes no changes to the
+    // tree, or the limit is reached.
+    char *outer = ind;
+    bool in_cycle = pos->in_cycle;
+    if (p->cycle) {
+        pos->in_cycle = true;
+        out("%sfor (int cycle_%d = 1;; cycle_%d++) {\n", ind, phase_entry,
+            phase_entry);
+        ind = out_format("%s    ", outer);
+        out("%sunsigned long changes_%d = " TRAV_PREFIX "changes;\n", ind,
+            phase_entry);
     }
 
     if (p->type == PH_subphases) {
 
         for (int i = 0; i < array_size(p->subphases); i++) {
-            print_phase_tree(array_get(p->subphases, i), level + 1, fp,
-                             root_node_name);
+            print_phase_tree(config, array_get(p->subphases, i), level + 1,
+                             fp, root_node_name, pos, ind);
         }
+    } else if (p->parallel) {
+        // The steps are traced in the step function, and are not reported
+        // separately, since counting the nodes would race with the steps.
+        int num_steps = array_size(p->passes);
+        char *outer = ind;
+        ind = print_leaf_guard(config, pos->leaf, outer, fp);
+        out("%sparallel_run(syntaxtree, &parallel_%s);\n", ind, p->id);
+        print_leaf_guard_end(config, ind, outer, fp);
+        ind = outer;
+        pos->leaf += num_steps;
+        pos->entry += num_steps;
     } else {
 
         for (int i = 0; i < array_size(p->passes); i++) {
             PhaseLeaf *leaf = array_get(p->passes, i);
+            int leaf_entry = pos->entry++;
+            char *outer = ind;
+            ind = print_leaf_guard(config, pos->leaf++, outer, fp);
 
-            out("    printf(\"");
-            print_indent(level + 1, "--", fp);
-
-            if (leaf->type == PL_traversal) {
+            if (leaf->type == PL_fusion) {
+                Fusion *fusion = leaf->value.fusion;
+                for (int j = 0; j < array_size(fusion->traversals); j++) {
+                    Traversal *trav = array_get(fusion->traversals, j);
+                    print_trace(ind, level + 1, "--",
+                                trav->info != NULL ? trav->info : trav->id,
+                                fp);
+                }
+                out("%sPHASE_REPORT_BEGIN(%d);\n", ind, leaf_entry);
+                print_presence_guard(config, fusion->traversals, ind, fp);
+                out("%strav_start_%s(syntaxtree, TRAV_%s);\n", ind,
+                    root_node_name, fusion->id);
+            } else if (leaf->type == PL_traversal) {
                 Traversal *trav = leaf->value.traversal;
-                out(" %s\\n\");\n",
-                    trav->info != NULL ? trav->info : trav->id);
-                out("    trav_start_%s(syntaxtree, TRAV_%s);\n",
-                    root_node_name, trav->id);
+                print_trace(ind, level + 1, "--",
+                            trav->info != NULL ? trav->info : trav->id, fp);
+                out("%sPHASE_REPORT_BEGIN(%d);\n", ind, leaf_entry);
+                array *travs = array_init(1);
+                array_append(travs, trav);
+                print_presence_guard(config, travs, ind, fp);
+                array_cleanup(travs, NULL);
+                if (trav->rules != NULL)
+                    out("%s" RULES_RUN_FORMAT "(syntaxtree);\n", ind,
+                        trav->id);
+                else
+                    out("%strav_start_%s(syntaxtree, TRAV_%s);\n", ind,
+                        root_node_name, trav->id);
             } else {
                 Pass *pass = leaf->value.pass;
-                out(" %s\\n\");\n",
-                    pass->info != NULL ? pass->info : pass->id);
-                out("    pass_%s_entry(syntaxtree);\n", pass->id);
+                print_trace(ind, level + 1, "--",
+                            pass->info != NULL ? pass->info : pass->id, fp);
+                out("%sPHASE_REPORT_BEGIN(%d);\n", ind, leaf_entry);
+                out("%spass_%s_entry(syntaxtree);\n", ind, pass->id);
             }
+            out("%sPHASE_REPORT_END(%d);\n", ind, leaf_entry);
+            print_leaf_guard_end(config, ind, outer, fp);
+            ind = outer;
+        }
+    }
+
+    if (p->cycle) {
+        out("%sif (" TRAV_PREFIX "changes == changes_%d)\n", ind,
+            phase_entry);
+        out("%s    break;\n", ind);
+        out("%sif (cycle_%d == " CYCLE_LIMIT_MACRO ") {\n", ind,
+            phase_entry);
+        out("%s    print_user_error(\"phasedriver\", \"Cycle phase %s did "
+            "not reach a fixpoint in %%d iterations.\", "
+            CYCLE_LIMIT_MACRO ");\n",
+            ind, p->id);
+        out("%s    break;\n", ind);
+        out("%s}\n", ind);
+        mem_free(ind);
+        ind = outer;
+        out("%s}\n", ind);
+        pos->in_cycle = in_cycle;
+    }
+
+    guarded = print_phase_guard(config, first, end, ind, fp);
+    out("%sPHASE_REPORT_END(%d);\n", guarded, phase_entry);
+    print_leaf_guard_end(config, guarded, ind, fp);
+
+    // Compiled away unless the mandatory children are checked.
+    out("#ifdef " CONSISTENCY_MACRO "\n");
+    if (config->checkpoints)
+        out("%sif (start < %d && %d <= stop)\n    ", ind, end, end);
+    out("%s" CONSISTENCY_PREFIX "phase_end(syntaxtree, " PHASE_FORMAT
+        ");\n",
+        ind, p->id);
+    out("#endif\n");
+
+    // Written once at every boundary, after the phases in a cycle phase are
+    // done. The boundary at which the phases stop is always written, so that
+    // they can start from it again.
+    if (!config->checkpoints || pos->in_cycle || end == pos->written)
+        return;
+    if (pos->boundaries[end]) {
+        out("%sif (dir != NULL && start < %d && %d <= stop)\n", ind, end,
+            end);
+    } else if (end < pos->num_leaves) {
+        out("%sif (dir != NULL && start < %d && %d == stop)\n", ind, end,
+            end);
+    } else {
+        return;
+    }
+    out("%s    checkpoint_write(syntaxtree, dir, key, %d);\n", ind, end);
+    pos->written = end;
+}
+
+static int num_types(Config *config) {
+    return array_size(config->nodes) + array_size(config->nodesets);
+}
+
+static char *type_id(Config *config, int index) {
+    int num_nodes = array_size(config->nodes);
+
+    if (index < num_nodes)
+        return ((Node *)array_get(config->nodes, index))->id;
+    return ((Nodeset *)array_get(config->nodesets, index - num_nodes))->id;
+}
+
+static void set_type(unsigned char *mask, int index) {
+    mask[index / 8] |= 1 << (index % 8);
+}
+
+static bool has_type(unsigned char *mask, int index) {
+    return mask[index / 8] & (1 << (index % 8));
+}
+
+// Add the named node, or the nodeset and all its nodes, to 'mask'.
+static void add_access_types(Config *config, array *types,
+                             unsigned char *mask) {
+    int num_nodes = array_size(config->nodes);
+
+    for (int i = 0; i < array_size(types); i++) {
+        char *id = array_get(types, i);
+
+        for (int j = 0; j < num_types(config); j++) {
+            if (strcmp(type_id(config, j), id) != 0)
+                continue;
+            set_type(mask, j);
+            if (j < num_nodes)
+                continue;
+
+            Nodeset *nodeset = array_get(config->nodesets, j - num_nodes);
+            for (int k = 0; k < array_size(nodeset->nodes); k++) {
+                Node *node = array_get(nodeset->nodes, k);
+                for (int l = 0; l < num_nodes; l++) {
+                    if (strcmp(type_id(config, l), node->id) == 0)
+                        set_type(mask, l);
+                }
+            }
+        }
+    }
+}
+
+// Add the types a traversal walks through to reach the nodes it handles.
+static void add_walked_types(Config *config, Traversal *trav,
+                             unsigned char *mask) {
+    char *root = config->root_node->id;
+
+    for (int i = 0; i < num_types(config); i++) {
+        char *id = type_id(config, i);
+        if (strcmp(id, root) != 0 && !node_reachable(config, root, id))
+            continue;
+
+        bool walked = trav->nodes == NULL;
+        for (int j = 0; !walked && j < array_size(trav->nodes); j++) {
+            char *handled = array_get(trav->nodes, j);
+            walked = strcmp(id, handled) == 0 ||
+                     node_reachable(config, id, handled);
         }
+        if (walked)
+            set_type(mask, i);
     }
 }
 
+static bool handles_type(Traversal *trav, char *id, Config *config) {
+    for (int i = 0; i < array_size(trav->nodes); i++) {
+        char *handled = array_get(trav->nodes, i);
+        if (strcmp(handled, id) == 0)
+            return true;
+    }
+    for (int i = 0; i < array_size(config->nodesets); i++) {
+        Nodeset *nodeset = array_get(config->nodesets, i);
+        if (strcmp(nodeset->id, id) != 0)
+            continue;
+        for (int j = 0; j < array_size(nodeset->nodes); j++) {
+            Node *node = array_get(nodeset->nodes, j);
+            if (handles_type(trav, node->id, config))
+                return true;
+        }
+    }
+    return false;
+}
+
+// Add the nodes a rewrite traversal replaces children of.
+static void add_rewritten_types(Config *config, Traversal *trav,
+                                unsigned char *mask) {
+    unsigned char *walked = mem_alloc((num_types(config) + 7) / 8);
+    memset(walked, 0, (num_types(config) + 7) / 8);
+    add_walked_types(config, trav, walked);
+
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+
+        for (int j = 0; has_type(walked, i) &&
+                        j < array_size(node->children);
+             j++) {
+            Child *child = array_get(node->children, j);
+            if (trav->nodes == NULL ||
+                handles_type(trav, child->type, config))
+                set_type(mask, i);
+        }
+    }
+    mem_free(walked);
+}
+
+// The types a step of a parallel phase reads and writes. A step without
+// declared reads and writes may read and write every type.
+static void step_access(Config *config, PhaseLeaf *leaf,
+                        unsigned char *reads, unsigned char *writes) {
+    NodeAccess *access = NULL;
+    Traversal *trav = NULL;
+
+    if (leaf->type == PL_traversal) {
+        trav = leaf->value.traversal;
+        access = trav->access;
+    } else if (leaf->type == PL_pass) {
+        access = leaf->value.pass->access;
+    }
+
+    if (access == NULL || (trav != NULL && trav->rules != NULL)) {
+        for (int i = 0; i < num_types(config); i++) {
+            set_type(reads, i);
+            set_type(writes, i);
+        }
+        return;
+    }
+
+    add_access_types(config, access->reads, reads);
+    add_access_types(config, access->writes, writes);
+
+    // A rewrite traversal replaces the nodes in their parents.
+    if (trav != NULL) {
+        add_walked_types(config, trav, reads);
+        if (trav->rewrite)
+            add_rewritten_types(config, trav, writes);
+    }
+}
+
+static bool steps_conflict(Config *config, unsigned char *r1,
+                           unsigned char *w1, unsigned char *r2,
+                           unsigned char *w2) {
+    for (int t = 0; t < num_types(config); t++) {
+        if (has_type(w1, t) && (has_type(r2, t) || has_type(w2, t)))
+            return true;
+        if (has_type(w2, t) && has_type(r1, t))
+            return true;
+    }
+    return false;
+}
+
+static char *step_id(PhaseLeaf *leaf) {
+    if (leaf->type == PL_traversal)
+        return leaf->value.traversal->id;
+    return leaf->value.pass->id;
+}
+
+static char *step_info(PhaseLeaf *leaf) {
+    if (leaf->type == PL_traversal) {
+        Traversal *trav = leaf->value.traversal;
+        return trav->info != NULL ? trav->info : trav->id;
+    }
+    Pass *pass = leaf->value.pass;
+    return pass->info != NULL ? pass->info : pass->id;
+}
+
+// Steps of a parallel phase that run as soon as the steps before them that
+// they conflict with are done. Two steps conflict if one writes a type that
+// the other reads or writes.
+static void generate_parallel_phase(Config *config, Phase *p, int level,
+                                    FILE *fp) {
+    char *root = config->root_node->id;
+    int num_steps = array_size(p->passes);
+    int size = (num_types(config) + 7) / 8;
+    unsigned char *reads = mem_alloc(num_steps * size);
+    unsigned char *writes = mem_alloc(num_steps * size);
+    memset(reads, 0, num_steps * size);
+    memset(writes, 0, num_steps * size);
+
+    for (int i = 0; i < num_steps; i++)
+        step_access(config, array_get(p->passes, i), reads + i * size,
+                    writes + i * size);
+
+    out("static void parallel_step_%s(%s *syntaxtree, int step) {\n", p->id,
+        root);
+    out("    switch (step) {\n");
+    for (int i = 0; i < num_steps; i++) {
+        PhaseLeaf *leaf = array_get(p->passes, i);
+
+        out("    case %d:\n", i);
+        print_trace("        ", level + 1, "--", step_info(leaf), fp);
+        if (leaf->type == PL_pass)
+            out("        pass_%s_entry(syntaxtree);\n", step_id(leaf));
+        else if (leaf->value.traversal->rules != NULL)
+            out("        " RULES_RUN_FORMAT "(syntaxtree);\n",
+                step_id(leaf));
+        else
+            out("        trav_start_%s(syntaxtree, TRAV_%s);\n", root,
+                step_id(leaf));
+        out("        break;\n");
+    }
+    out("    }\n");
+    out("}\n\n");
+
+    bool concurrent = false;
+    out("static const unsigned char parallel_deps_%s[] = {\n", p->id);
+    for (int j = 0; j < num_steps; j++) {
+        unsigned char *rj = reads + j * size, *wj = writes + j * size;
+        int deps = 0;
+
+        out("   ");
+        for (int i = 0; i < num_steps; i++) {
+            bool conflict = i < j && steps_conflict(config, reads + i * size,
+                                                    writes + i * size, rj, wj);
+            deps += conflict;
+            out(" %d,", conflict);
+        }
+        out(" // %s\n", step_id(array_get(p->passes, j)));
+        if (j > 0 && deps < j)
+            concurrent = true;
+    }
+    out("};\n\n");
+
+    if (!concurrent && num_steps > 1)
+        print_warning(p->id, "No steps of parallel phase '%s' can run "
+                             "concurrently",
+                      p->id);
+
+    out("#ifdef " PARALLEL_CHECK_MACRO "\n");
+    out("static const char *parallel_names_%s[] = {\n", p->id);
+    for (int i = 0; i < num_steps; i++)
+        out("    \"%s\",\n", step_id(array_get(p->passes, i)));
+    out("};\n\n");
+    out("static const unsigned char parallel_writes_%s[] = {\n", p->id);
+    for (int i = 0; i < num_steps; i++) {
+        out("   ");
+        for (int b = 0; b < size; b++)
+            out(" 0x%02x,", writes[i * size + b]);
+        out(" // %s\n", step_id(array_get(p->passes, i)));
+    }
+    out("};\n");
+    out("#endif\n\n");
+
+    out("static const ParallelPhase parallel_%s = {\n", p->id);
+    out("    \"%s\", %d, parallel_step_%s, parallel_deps_%s,\n", p->id,
+        num_steps, p->id, p->id);
+    out("#ifdef " PARALLEL_CHECK_MACRO "\n");
+    out("    parallel_names_%s, parallel_writes_%s,\n", p->id, p->id);
+    out("#endif\n");
+    out("};\n\n");
+
+    mem_free(reads);
+    mem_free(writes);
+}
+
+static void generate_parallel_phases(Config *config, Phase *p, int level,
+                                     smap_t *generated, FILE *fp) {
+    if (p->type == PH_subphases) {
+        for (int i = 0; i < array_size(p->subphases); i++)
+            generate_parallel_phases(config, array_get(p->subphases, i),
+                                     level + 1, generated, fp);
+    } else if (p->parallel && smap_retrieve(generated, p->id) == NULL) {
+        generate_parallel_phase(config, p, level, fp);
+        smap_insert(generated, p->id, p);
+    }
+}
+
+// Fold the fields of every node into the fingerprint of its type, so that
+// the types a step changed can be found.
+static void generate_fingerprint(Config *config, FILE *fp) {
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+        out("static void parallel_fingerprint_%s(struct %s *node, "
+            "uint64_t *fp);\n",
+            node->id, node->id);
+    }
+    for (int i = 0; i < array_size(config->nodesets); i++) {
+        Nodeset *nodeset = array_get(config->nodesets, i);
+        out("static void parallel_fingerprint_%s(struct %s *nodeset, "
+            "uint64_t *fp);\n",
+            nodeset->id, nodeset->id);
+    }
+    out("\n");
+
+    out("static uint64_t parallel_fold(uint64_t hash, const void *data, "
+        "size_t size) {\n");
+    out("    for (size_t i = 0; i < size; i++) {\n");
+    out("        hash ^= ((const unsigned char *)data)[i];\n");
+    out("        hash *= 0x100000001b3ULL;\n");
+    out("    }\n");
+    out("    return hash;\n");
+    out("}\n\n");
+
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+        out("static void parallel_fingerprint_%s(struct %s *node, "
+            "uint64_t *fp) {\n",
+            node->id, node->id);
+        out("    uint64_t hash = parallel_fold(fp[" NT_FORMAT "], &node, "
+            "sizeof(node));\n",
+            node->id);
+        for (int j = 0; j < array_size(node->children); j++) {
+            Child *child = array_get(node->children, j);
+            out("    hash = parallel_fold(hash, &node->%s, "
+                "sizeof(node->%s));\n",
+                child->id, child->id);
+        }
+        for (int j = 0; j < array_size(node->attrs); j++) {
+            Attr *attr = array_get(node->attrs, j);
+            if (attr->type == AT_string) {
+                out("    if (node->%s != NULL)\n", attr->id);
+                out("        hash = parallel_fold(hash, node->%s, "
+                    "strlen(node->%s));\n",
+                    attr->id, attr->id);
+            } else {
+                out("    hash = parallel_fold(hash, &node->%s, "
+                    "sizeof(node->%s));\n",
+                    attr->id, attr->id);
+            }
+        }
+        out("    fp[" NT_FORMAT "] = hash;\n", node->id);
+        for (int j = 0; j < array_size(node->children); j++) {
+            Child *child = array_get(node->children, j);
+            out("    if (node->%s != NULL)\n", child->id);
+            out("        parallel_fingerprint_%s(node->%s, fp);\n",
+                child->type, child->id);
+        }
+        out("}\n\n");
+    }
+
+    for (int i = 0; i < array_size(config->nodesets); i++) {
+        Nodeset *nodeset = array_get(config->nodesets, i);
+        out("static void parallel_fingerprint_%s(struct %s *nodeset, "
+            "uint64_t *fp) {\n",
+            nodeset->id, nodeset->id);
+        out("    fp[" NT_FORMAT "] = parallel_fold(fp[" NT_FORMAT "], "
+            "nodeset, sizeof(*nodeset));\n",
+            nodeset->id, nodeset->id);
+        out("    switch (nodeset->type) {\n");
+        for (int j = 0; j < array_size(nodeset->nodes); j++) {
+            Node *node = array_get(nodeset->nodes, j);
+            out("    case " NS_FORMAT ":\n", nodeset->id, node->id);
+            out("        parallel_fingerprint_%s(nodeset->value.val_%s, "
+                "fp);\n",
+                node->id, node->id);
+            out("        break;\n");
+        }
+        out("    }\n");
+        out("}\n\n");
+    }
+}
+
+// Runs the steps of parallel phases on a pool of threads, every thread
+// taking the next step whose dependencies are done.
+static void generate_parallel_functions(Config *config, FILE *fp) {
+    char *root = config->root_node->id;
+    int types = num_types(config);
+    int size = (types + 7) / 8;
+
+    out("#include <pthread.h>\n");
+    out("#include <stdint.h>\n");
+    out("#include <string.h>\n");
+    out("#include <unistd.h>\n");
+    out("#include \"lib/memory.h\"\n\n");
+
+    out("typedef struct ParallelPhase {\n");
+    out("    const char *name;\n");
+    out("    int num_steps;\n");
+    out("    void (*step)(%s *syntaxtree, int step);\n", root);
+    out("    // Entry num_steps * j + i is set if step j waits for step i.\n");
+    out("    const unsigned char *deps;\n");
+    out("#ifdef " PARALLEL_CHECK_MACRO "\n");
+    out("    const char **names;\n");
+    out("    // Row of %d bytes for every step, with the bits of the types "
+        "it writes.\n",
+        size);
+    out("    const unsigned char *writes;\n");
+    out("#endif\n");
+    out("} ParallelPhase;\n\n");
+
+    out("typedef struct ParallelRun {\n");
+    out("    const ParallelPhase *phase;\n");
+    out("    %s *syntaxtree;\n", root);
+    out("    // Number of unfinished dependencies of every step.\n");
+    out("    int *waiting;\n");
+    out("    // Steps in the order in which they became ready.\n");
+    out("    int *ready;\n");
+    out("    int num_ready;\n");
+    out("    int next;\n");
+    out("    int done;\n");
+    out("    unsigned long changes;\n");
+    out("    pthread_mutex_t lock;\n");
+    out("    pthread_cond_t cond;\n");
+    out("} ParallelRun;\n\n");
+
+    out("#ifdef " PARALLEL_CHECK_MACRO "\n");
+    out("static const char *parallel_type_names[] = {\n");
+    for (int i = 0; i < types; i++)
+        out("    \"%s\",\n", type_id(config, i));
+    out("};\n\n");
+    generate_fingerprint(config, fp);
+
+    out("// Runs the steps one by one, in an order allowed by the "
+        "dependencies.\n");
+    out("static void parallel_check(%s *syntaxtree, "
+        "const ParallelPhase *phase) {\n",
+        root);
+    out("    uint64_t before[%d], after[%d];\n\n", types, types);
+    out("    for (int step = 0; step < phase->num_steps; step++) {\n");
+    out("        memset(before, 0, sizeof(before));\n");
+    out("        memset(after, 0, sizeof(after));\n");
+    out("        parallel_fingerprint_%s(syntaxtree, before);\n", root);
+    out("        phase->step(syntaxtree, step);\n");
+    out("        parallel_fingerprint_%s(syntaxtree, after);\n\n", root);
+    out("        const unsigned char *writes = &phase->writes[%d * step];\n",
+        size);
+    out("        for (int t = 0; t < %d; t++) {\n", types);
+    out("            if (before[t] != after[t] && "
+        "!(writes[t / 8] & (1 << (t %% 8))))\n");
+    out("                print_user_error(\"phasedriver\", \"Step %%s of "
+        "parallel phase %%s \"\n");
+    out("                                 \"changed %%s, which is not in its "
+        "writes.\",\n");
+    out("                                 phase->names[step], phase->name,\n");
+    out("                                 parallel_type_names[t]);\n");
+    out("        }\n");
+    out("    }\n");
+    out("}\n");
+    out("#else\n");
+
+    // Takes the next step that is ready until all steps are done.
+    out("static void *parallel_worker(void *arg) {\n");
+    out("    ParallelRun *run = arg;\n");
+    out("    const ParallelPhase *phase = run->phase;\n\n");
+    out("    pthread_mutex_lock(&run->lock);\n");
+    out("    while (run->done < phase->num_steps) {\n");
+    out("        if (run->next == run->num_ready) {\n");
+    out("            pthread_cond_wait(&run->cond, &run->lock);\n");
+    out("            continue;\n");
+    out("        }\n");
+    out("        int step = run->ready[run->next++];\n");
+    out("        pthread_mutex_unlock(&run->lock);\n\n");
+    // The counters of changes are thread-local, so the changes of every
+    // step are added to those of the calling thread afterwards.
+    if (config->cycles) {
+        out("        unsigned long changes = " TRAV_PREFIX "changes;\n");
+        out("        phase->step(run->syntaxtree, step);\n");
+        out("        changes = " TRAV_PREFIX "changes - changes;\n\n");
+    } else {
+        out("        phase->step(run->syntaxtree, step);\n\n");
+    }
+    out("        pthread_mutex_lock(&run->lock);\n");
+    if (config->cycles)
+        out("        run->changes += changes;\n");
+    out("        run->done++;\n");
+    out("        for (int j = step + 1; j < phase->num_steps; j++) {\n");
+    out("            if (phase->deps[phase->num_steps * j + step] &&\n");
+    out("                --run->waiting[j] == 0)\n");
+    out("                run->ready[run->num_ready++] = j;\n");
+    out("        }\n");
+    out("        pthread_cond_broadcast(&run->cond);\n");
+    out("    }\n");
+    out("    pthread_mutex_unlock(&run->lock);\n");
+    out("    return NULL;\n");
+    out("}\n");
+    out("#endif\n\n");
+
+    out("static void parallel_run(%s *syntaxtree, "
+        "const ParallelPhase *phase) {\n",
+        root);
+    out("#ifdef " PARALLEL_CHECK_MACRO "\n");
+    out("    parallel_check(syntaxtree, phase);\n");
+    out("#else\n");
+    out("    ParallelRun run = {phase, syntaxtree};\n");
+    out("    int n = phase->num_steps;\n");
+    out("    run.waiting = mem_alloc(sizeof(int) * n);\n");
+    out("    run.ready = mem_alloc(sizeof(int) * n);\n");
+    out("    for (int j = 0; j < n; j++) {\n");
+    out("        run.waiting[j] = 0;\n");
+    out("        for (int i = 0; i < j; i++)\n");
+    out("            run.waiting[j] += phase->deps[n * j + i];\n");
+    out("        if (run.waiting[j] == 0)\n");
+    out("            run.ready[run.num_ready++] = j;\n");
+    out("    }\n");
+    out("    pthread_mutex_init(&run.lock, NULL);\n");
+    out("    pthread_cond_init(&run.cond, NULL);\n\n");
+    out("    // The calling thread is one of the workers.\n");
+    out("#ifdef " PARALLEL_THREADS_MACRO "\n");
+    out("    int num_threads = " PARALLEL_THREADS_MACRO ";\n");
+    out("#else\n");
+    out("    int num_threads = sysconf(_SC_NPROCESSORS_ONLN);\n");
+    out("#endif\n");
+    out("    if (num_threads > n)\n");
+    out("        num_threads = n;\n");
+    out("    if (num_threads < 1)\n");
+    out("        num_threads = 1;\n");
+    out("    pthread_t *threads = mem_alloc(sizeof(pthread_t) * "
+        "num_threads);\n");
+    out("    int started = 1;\n");
+    out("    while (started < num_threads &&\n");
+    out("           pthread_create(&threads[started], NULL, "
+        "parallel_worker, &run) == 0)\n");
+    out("        started++;\n\n");
+    if (config->cycles)
+        out("    unsigned long changes = " TRAV_PREFIX "changes;\n");
+    out("    parallel_worker(&run);\n");
+    out("    for (int i = 1; i < started; i++)\n");
+    out("        pthread_join(threads[i], NULL);\n");
+    if (config->cycles)
+        out("    " TRAV_PREFIX "changes = changes + run.changes;\n");
+    out("\n");
+    out("    pthread_mutex_destroy(&run.lock);\n");
+    out("    pthread_cond_destroy(&run.cond);\n");
+    out("    mem_free(threads);\n");
+    out("    mem_free(run.waiting);\n");
+    out("    mem_free(run.ready);\n");
+    out("#endif\n");
+    out("}\n\n");
+
+    smap_t *generated = smap_init(16);
+    generate_parallel_phases(config, config->phase_tree, 0, generated, fp);
+    smap_free(generated);
+}
+
+static bool in_tree(Config *config, char *id) {
+    char *root = config->root_node->id;
+    return strcmp(id, root) == 0 || node_reachable(config, root, id);
+}
+
+// Number of nodes in the subtree, counted before and after every entry. Only
+// the types that can occur in the tree are counted.
+static void generate_report_count(Config *config, FILE *fp) {
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+        if (in_tree(config, node->id))
+            out("static long report_count_%s(struct %s *node);\n", node->id,
+                node->id);
+    }
+    for (int i = 0; i < array_size(config->nodesets); i++) {
+        Nodeset *nodeset = array_get(config->nodesets, i);
+        if (in_tree(config, nodeset->id))
+            out("static long report_count_%s(struct %s *nodeset);\n",
+                nodeset->id, nodeset->id);
+    }
+    out("\n");
+
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+        if (!in_tree(config, node->id))
+            continue;
+        out("static long report_count_%s(struct %s *node) {\n", node->id,
+            node->id);
+        out("    long count = 1;\n");
+        for (int j = 0; j < array_size(node->children); j++) {
+            Child *child = array_get(node->children, j);
+            out("    if (node->%s != NULL)\n", child->id);
+            out("        count += report_count_%s(node->%s);\n", child->type,
+                child->id);
+        }
+        out("    return count;\n");
+        out("}\n\n");
+    }
+
+    for (int i = 0; i < array_size(config->nodesets); i++) {
+        Nodeset *nodeset = array_get(config->nodesets, i);
+        if (!in_tree(config, nodeset->id))
+            continue;
+        out("static long report_count_%s(struct %s *nodeset) {\n",
+            nodeset->id, nodeset->id);
+        out("    switch (nodeset->type) {\n");
+        for (int j = 0; j < array_size(nodeset->nodes); j++) {
+            Node *node = array_get(nodeset->nodes, j);
+            out("    case " NS_FORMAT ":\n", nodeset->id, node->id);
+            out("        return report_count_%s(nodeset->value.val_%s);\n",
+                node->id, node->id);
+        }
+        out("    }\n");
+        out("    return 0;\n");
+        out("}\n\n");
+    }
+}
+
+// Wall time, processor time, growth of the peak resident set and number of
+// nodes of every phase and pass, which only exist when the phasedriver is
+// compiled with PHASE_REPORT_MACRO defined.
+static void generate_report_functions(Config *config, FILE *fp) {
+    char *root = config->root_node->id;
+    int num_entries = count_report_entries(config->phase_tree);
+
+    out("#ifdef " PHASE_REPORT_MACRO "\n");
+    out("#include <stdint.h>\n");
+    out("#include <string.h>\n");
+    out("#include <time.h>\n");
+    out("#include <sys/resource.h>\n\n");
+
+    out("typedef struct PhaseReportEntry {\n");
+    out("    const char *name;\n");
+    out("    const char *kind;\n");
+    out("    int depth;\n");
+    out("    unsigned long runs;\n");
+    out("    uint64_t wall_ns;\n");
+    out("    uint64_t cpu_ns;\n");
+    out("    long maxrss_kb;\n");
+    out("    long nodes_before;\n");
+    out("    long nodes_after;\n");
+    out("    uint64_t start_wall;\n");
+    out("    uint64_t start_cpu;\n");
+    out("    uint64_t start_counting_wall;\n");
+    out("    uint64_t start_counting_cpu;\n");
+    out("    long start_maxrss;\n");
+    out("} PhaseReportEntry;\n\n");
+
+    out("static %sPhaseReportEntry report_entries[%d] = {\n",
+        out_thread_local(config), num_entries);
+    print_report_entries(config->phase_tree, 0, fp);
+    out("};\n\n");
+
+    generate_report_count(config, fp);
+
+    out("static uint64_t report_clock(clockid_t clock) {\n");
+    out("    struct timespec ts;\n");
+    out("    clock_gettime(clock, &ts);\n");
+    out("    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;\n");
+    out("}\n\n");
+
+    out("static long report_maxrss(void) {\n");
+    out("    struct rusage usage;\n");
+    out("    getrusage(RUSAGE_SELF, &usage);\n");
+    out("    return usage.ru_maxrss;\n");
+    out("}\n\n");
+
+    // The time spent counting nodes is left out of the times of the entries
+    // that are running.
+    out("static %suint64_t report_counting_wall;\n",
+        out_thread_local(config));
+    out("static %suint64_t report_counting_cpu;\n\n",
+        out_thread_local(config));
+
+    out("static long report_nodes(struct %s *syntaxtree) {\n", root);
+    out("    uint64_t wall = report_clock(CLOCK_MONOTONIC);\n");
+    out("    uint64_t cpu = report_clock(CLOCK_PROCESS_CPUTIME_ID);\n");
+    out("    long nodes = report_count_%s(syntaxtree);\n", root);
+    out("    report_counting_wall += report_clock(CLOCK_MONOTONIC) - wall;\n");
+    out("    report_counting_cpu += report_clock(CLOCK_PROCESS_CPUTIME_ID) - "
+        "cpu;\n");
+    out("    return nodes;\n");
+    out("}\n\n");
+
+    out("static void report_begin(int entry, struct %s *syntaxtree) {\n",
+        root);
+    out("    PhaseReportEntry *e = &report_entries[entry];\n");
+    out("    e->nodes_before = report_nodes(syntaxtree);\n");
+    out("    e->start_maxrss = report_maxrss();\n");
+    out("    e->start_counting_wall = report_counting_wall;\n");
+    out("    e->start_counting_cpu = report_counting_cpu;\n");
+    out("    e->start_cpu = report_clock(CLOCK_PROCESS_CPUTIME_ID);\n");
+    out("    e->start_wall = report_clock(CLOCK_MONOTONIC);\n");
+    out("}\n\n");
+
+    out("static void report_end(int entry, struct %s *syntaxtree) {\n",
+        root);
+    out("    PhaseReportEntry *e = &report_entries[entry];\n");
+    out("    e->wall_ns += report_clock(CLOCK_MONOTONIC) - e->start_wall -\n");
+    out("        (report_counting_wall - e->start_counting_wall);\n");
+    out("    e->cpu_ns += report_clock(CLOCK_PROCESS_CPUTIME_ID) - "
+        "e->start_cpu -\n");
+    out("        (report_counting_cpu - e->start_counting_cpu);\n");
+    out("    e->maxrss_kb += report_maxrss() - e->start_maxrss;\n");
+    out("    e->nodes_after = report_nodes(syntaxtree);\n");
+    out("    e->runs++;\n");
+    out("}\n\n");
+
+    out("#define PHASE_REPORT_BEGIN(entry) report_begin(entry, "
+        "syntaxtree)\n");
+    out("#define PHASE_REPORT_END(entry) report_end(entry, syntaxtree)\n\n");
+
+    out("void " PHASE_REPORT_PREFIX "reset(void) {\n");
+    out("    for (int i = 0; i < %d; i++) {\n", num_entries);
+    out("        PhaseReportEntry *e = &report_entries[i];\n");
+    out("        e->runs = e->wall_ns = e->cpu_ns = 0;\n");
+    out("        e->maxrss_kb = e->nodes_before = e->nodes_after = 0;\n");
+    out("    }\n");
+    out("}\n\n");
+
+    out("// Print a table to stderr, or write a JSON array with an object "
+        "for every\n");
+    out("// phase and pass to json_fn.\n");
+    out("void " PHASE_REPORT_PREFIX "dump(const char *json_fn) {\n");
+    out("    FILE *fp = stderr;\n");
+    out("    if (json_fn != NULL) {\n");
+    out("        fp = fopen(json_fn, \"w\");\n");
+    out("        if (fp == NULL) {\n");
+    out("            print_user_error(\"phasedriver-report\", \"Cannot open "
+        "%%s.\", json_fn);\n");
+    out("            return;\n");
+    out("        }\n");
+    out("        fprintf(fp, \"[\\n\");\n");
+    out("    } else {\n");
+    out("        fprintf(fp, \"%%-32s %%-9s %%12s %%12s %%10s %%10s "
+        "%%10s\\n\", \"phase\", \"kind\", \"wall ms\", \"cpu ms\", "
+        "\"maxrss kB\", \"nodes in\", \"nodes out\");\n");
+    out("    }\n\n");
+
+    out("    for (int i = 0; i < %d; i++) {\n", num_entries);
+    out("        PhaseReportEntry *e = &report_entries[i];\n");
+    out("        if (json_fn != NULL) {\n");
+    out("            fprintf(fp, \"  {\\\"name\\\": \\\"%%s\\\", "
+        "\\\"kind\\\": \\\"%%s\\\", \\\"depth\\\": %%d, \\\"runs\\\": %%lu, "
+        "\"\n");
+    out("                    \"\\\"wall_ns\\\": %%llu, \\\"cpu_ns\\\": "
+        "%%llu, \\\"maxrss_kb\\\": %%ld, \"\n");
+    out("                    \"\\\"nodes_before\\\": %%ld, "
+        "\\\"nodes_after\\\": %%ld}%%s\\n\",\n");
+    out("                    e->name, e->kind, e->depth, e->runs,\n");
+    out("                    (unsigned long long)e->wall_ns,\n");
+    out("                    (unsigned long long)e->cpu_ns, e->maxrss_kb,\n");
+    out("                    e->nodes_before, e->nodes_after,\n");
+    out("                    i < %d ? \",\" : \"\");\n", num_entries - 1);
+    out("        } else {\n");
+    out("            int indent = e->depth * 2;\n");
+    out("            fprintf(fp, \"%%*s%%-*s %%-9s %%12.3f %%12.3f %%10ld "
+        "%%10ld %%10ld\\n\",\n");
+    out("                    indent, \"\", 32 - indent, e->name, e->kind,\n");
+    out("                    e->wall_ns / 1e6, e->cpu_ns / 1e6, "
+        "e->maxrss_kb,\n");
+    out("                    e->nodes_before, e->nodes_after);\n");
+    out("        }\n");
+    out("    }\n\n");
+
+    out("    if (json_fn != NULL) {\n");
+    out("        fprintf(fp, \"]\\n\");\n");
+    out("        fclose(fp);\n");
+    out("    }\n");
+    out("}\n");
+    out("#else\n");
+    out("#define PHASE_REPORT_BEGIN(entry)\n");
+    out("#define PHASE_REPORT_END(entry)\n");
+    out("#endif\n\n");
+}
+
+// Runs the phases on every tree of a batch, on a pool of threads that take
+// the next tree until none are left. The messages of every tree are
+// collected separately.
+static void generate_batch(Config *config, FILE *fp, bool header) {
+    char *root = config->root_node->id;
+
+    if (header) {
+        out("// Outcome of running the phases on one tree of a batch.\n");
+        out("typedef struct PhaseUnitResult {\n");
+        out("    // Number of errors reported while running the phases.\n");
+        out("    int errors;\n");
+        out("    // Messages reported while running the phases, NULL if there "
+            "were none.\n");
+        out("    // Freed with free().\n");
+        out("    char *diagnostics;\n");
+        out("} PhaseUnitResult;\n\n");
+        out("void phasedriver_run_batch(%s **units, int num_units, "
+            "int num_threads,\n",
+            root);
+        out("                           PhaseUnitResult *results);\n\n");
+        return;
+    }
+
+    out("#include <pthread.h>\n");
+    out("#include <stdlib.h>\n");
+    out("#include <unistd.h>\n");
+    out("#include \"lib/memory.h\"\n\n");
+
+    out("typedef struct PhaseBatch {\n");
+    out("    %s **units;\n", root);
+    out("    int num_units;\n");
+    out("    PhaseUnitResult *results;\n");
+    out("    int next;\n");
+    out("} PhaseBatch;\n\n");
+
+    out("static void *batch_worker(void *arg) {\n");
+    out("    PhaseBatch *batch = arg;\n\n");
+    out("    for (;;) {\n");
+    out("        int unit = __atomic_fetch_add(&batch->next, 1, "
+        "__ATOMIC_RELAXED);\n");
+    out("        if (unit >= batch->num_units)\n");
+    out("            return NULL;\n\n");
+    out("        if (batch->results == NULL) {\n");
+    out("            phasedriver_run(batch->units[unit]);\n");
+    out("            continue;\n");
+    out("        }\n\n");
+    out("        PhaseUnitResult *result = &batch->results[unit];\n");
+    out("        size_t size = 0;\n");
+    out("        result->diagnostics = NULL;\n");
+    out("        FILE *messages = open_memstream(&result->diagnostics, "
+        "&size);\n");
+    out("        int errors = print_user_errors();\n\n");
+    out("        print_user_stream(messages);\n");
+    out("        phasedriver_run(batch->units[unit]);\n");
+    out("        print_user_stream(NULL);\n\n");
+    out("        if (messages != NULL)\n");
+    out("            fclose(messages);\n");
+    out("        if (size == 0) {\n");
+    out("            free(result->diagnostics);\n");
+    out("            result->diagnostics = NULL;\n");
+    out("        }\n");
+    out("        result->errors = print_user_errors() - errors;\n");
+    out("    }\n");
+    out("}\n\n");
+
+    out("void phasedriver_run_batch(%s **units, int num_units, "
+        "int num_threads,\n",
+        root);
+    out("                           PhaseUnitResult *results) {\n");
+    out("    PhaseBatch batch = {units, num_units, results, 0};\n\n");
+    out("    if (num_threads <= 0)\n");
+    out("        num_threads = sysconf(_SC_NPROCESSORS_ONLN);\n");
+    out("    if (num_threads > num_units)\n");
+    out("        num_threads = num_units;\n");
+    out("    if (num_threads < 1)\n");
+    out("        num_threads = 1;\n\n");
+    out("    // The calling thread is one of the workers.\n");
+    out("    pthread_t *threads = mem_alloc(sizeof(pthread_t) * "
+        "num_threads);\n");
+    out("    int started = 1;\n");
+    out("    while (started < num_threads &&\n");
+    out("           pthread_create(&threads[started], NULL, batch_worker, "
+        "&batch) == 0)\n");
+    out("        started++;\n\n");
+    out("    batch_worker(&batch);\n");
+    out("    for (int i = 1; i < started; i++)\n");
+    out("        pthread_join(threads[i], NULL);\n");
+    out("    mem_free(threads);\n");
+    out("}\n");
+}
+
+// The key of the checkpoints starts from a hash of the specification, so
+// that the trees written by another phasedriver are not read.
+static unsigned long long spec_hash(Config *config) {
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+    for (char *c = config->common_info->hash; *c != '\0'; c++) {
+        hash ^= (unsigned char)*c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Writes the tree at the boundaries after checkpoint phases to a directory,
+// named by a hash of the input tree, and resumes from the latest one the
+// next time the phases run on the same tree.
+static void generate_checkpoint_functions(Config *config, FILE *fp,
+                                          bool header, DriverPos *pos) {
+    char *root = config->root_node->id;
+    int num_phases = array_size(config->phases);
+
+    if (header) {
+        out("// Runs the phases, starting from the latest checkpoint in dir "
+            "of the same\n");
+        out("// input tree. The returned tree replaces syntaxtree, which is "
+            "freed if a\n");
+        out("// checkpoint is read.\n");
+        out("%s *phasedriver_run_cached(%s *syntaxtree, const char *dir);\n",
+            root, root);
+        out("// Stop after a phase, and write a checkpoint there.\n");
+        out("void phasedriver_stop_after(" PHASE_ENUM_NAME " phase);\n");
+        out("// Start from the checkpoint at the start of a phase.\n");
+        out("void phasedriver_start_from(" PHASE_ENUM_NAME " phase);\n");
+        out("// The phase with a name, -1 if the phasedriver does not run "
+            "it.\n");
+        out("int phasedriver_phase(const char *name);\n\n");
+        return;
+    }
+
+    int(*leaves)[2] = mem_alloc(sizeof(int[2]) * (num_phases + 1));
+    for (int i = 0; i < num_phases; i++)
+        leaves[i][0] = leaves[i][1] = -1;
+    collect_leaves(config, config->phase_tree, 0, leaves, pos->boundaries);
+
+    out("#include <stdint.h>\n");
+    out("#include <string.h>\n");
+    out("#include <unistd.h>\n");
+    out("#include \"generated/free-ast.h\"\n");
+    out("#include \"generated/serialization-%s.h\"\n", root);
+    out("#include \"lib/memory.h\"\n\n");
+
+    out("static const char *checkpoint_phase_names[] = {\n");
+    for (int i = 0; i < num_phases; i++)
+        out("    \"%s\",\n", ((Phase *)array_get(config->phases, i))->id);
+    if (num_phases == 0)
+        out("    \"PLACEHOLDER\",\n");
+    out("};\n\n");
+
+    out("// First leaf and the boundary after the last leaf of every "
+        "phase.\n");
+    out("static const int checkpoint_phase_leaves[][2] = {\n");
+    for (int i = 0; i < num_phases; i++)
+        out("    {%d, %d},\n", leaves[i][0], leaves[i][1]);
+    if (num_phases == 0)
+        out("    {-1, -1},\n");
+    out("};\n\n");
+    mem_free(leaves);
+
+    // Latest first, the first boundary that has a checkpoint is resumed.
+    int num_boundaries = 0;
+    out("static const int checkpoint_boundaries[] = {");
+    for (int i = pos->num_leaves; i > 0; i--) {
+        if (pos->boundaries[i])
+            out("%s%d", num_boundaries++ > 0 ? ", " : "", i);
+    }
+    if (num_boundaries == 0)
+        out("0");
+    out("};\n\n");
+
+    out("static const uint64_t checkpoint_spec_hash = 0x%016llxULL;\n",
+        spec_hash(config));
+    out("static int checkpoint_start = -1;\n");
+    out("static int checkpoint_stop = %d;\n\n", pos->num_leaves);
+
+    out("int phasedriver_phase(const char *name) {\n");
+    out("    for (int i = 0; i < %d; i++) {\n", num_phases);
+    out("        if (checkpoint_phase_leaves[i][0] >= 0 &&\n");
+    out("            strcmp(checkpoint_phase_names[i], name) == 0)\n");
+    out("            return i;\n");
+    out("    }\n");
+    out("    return -1;\n");
+    out("}\n\n");
+
+    out("void phasedriver_stop_after(" PHASE_ENUM_NAME " phase) {\n");
+    out("    if (checkpoint_phase_leaves[phase][1] >= 0)\n");
+    out("        checkpoint_stop = checkpoint_phase_leaves[phase][1];\n");
+    out("}\n\n");
+
+    out("void phasedriver_start_from(" PHASE_ENUM_NAME " phase) {\n");
+    out("    if (checkpoint_phase_leaves[phase][0] >= 0)\n");
+    out("        checkpoint_start = checkpoint_phase_leaves[phase][0];\n");
+    out("}\n\n");
+
+    out("static char *checkpoint_path(const char *dir, uint64_t key, "
+        "int boundary,\n");
+    out("                             const char *ext) {\n");
+    out("    size_t size = strlen(dir) + strlen(ext) + 32;\n");
+    out("    char *path = mem_alloc(size);\n");
+    out("    snprintf(path, size, \"%%s/%%016llx-%%d%%s\", dir, "
+        "(unsigned long long)key,\n");
+    out("             boundary, ext);\n");
+    out("    return path;\n");
+    out("}\n\n");
+
+    out("static char *checkpoint_tmp_path(const char *dir, uint64_t key,\n");
+    out("                                 int boundary) {\n");
+    out("    char ext[32];\n");
+    out("    snprintf(ext, sizeof(ext), \".%%ld.tmp\", (long)getpid());\n");
+    out("    return checkpoint_path(dir, key, boundary, ext);\n");
+    out("}\n\n");
+
+    out("// FNV-1a hash of the specification and the serialized input "
+        "tree.\n");
+    out("static uint64_t checkpoint_key(%s *syntaxtree, const char *dir) {\n",
+        root);
+    out("    char *tmp = checkpoint_tmp_path(dir, checkpoint_spec_hash, "
+        "-1);\n");
+    out("    uint64_t key = checkpoint_spec_hash;\n\n");
+    out("    " SERIALIZE_WRITE_BIN_FORMAT "(syntaxtree, tmp);\n", root);
+    out("    FILE *fp = fopen(tmp, \"rb\");\n");
+    out("    if (fp != NULL) {\n");
+    out("        int c;\n");
+    out("        while ((c = getc(fp)) != EOF) {\n");
+    out("            key ^= (unsigned char)c;\n");
+    out("            key *= 0x100000001b3ULL;\n");
+    out("        }\n");
+    out("        fclose(fp);\n");
+    out("    }\n");
+    out("    remove(tmp);\n");
+    out("    mem_free(tmp);\n");
+    out("    return key;\n");
+    out("}\n\n");
+
+    // A checkpoint is renamed into place when it is complete, so a half
+    // written one is never read.
+    int leaf = 0;
+    if (writes_checkpoint(config->phase_tree, &leaf, false, pos)) {
+        out("static void checkpoint_write(%s *syntaxtree, const char *dir,\n",
+            root);
+        out("                             uint64_t key, int boundary) {\n");
+        out("    char *tmp = checkpoint_tmp_path(dir, key, boundary);\n");
+        out("    char *path = checkpoint_path(dir, key, boundary, "
+            "\".ckpt\");\n");
+        out("    " SERIALIZE_WRITE_BIN_FORMAT "(syntaxtree, tmp);\n", root);
+        out("    if (rename(tmp, path) != 0)\n");
+        out("        remove(tmp);\n");
+        out("    mem_free(tmp);\n");
+        out("    mem_free(path);\n");
+        out("}\n\n");
+    }
+
+    out("static %s *checkpoint_read(const char *dir, uint64_t key, "
+        "int boundary) {\n",
+        root);
+    out("    char *path = checkpoint_path(dir, key, boundary, \".ckpt\");\n");
+    out("    %s *syntaxtree = NULL;\n", root);
+    out("    if (access(path, R_OK) == 0)\n");
+    out("        syntaxtree = " SERIALIZE_READ_BIN_FORMAT "(path);\n", root);
+    out("    mem_free(path);\n");
+    out("    return syntaxtree;\n");
+    out("}\n\n");
+
+    out("static void run_phases(%s *syntaxtree, int start, int stop,\n",
+        root);
+    out("                       const char *dir, uint64_t key);\n\n");
+
+    out("%s *phasedriver_run_cached(%s *syntaxtree, const char *dir) {\n",
+        root, root);
+    out("    uint64_t key = checkpoint_key(syntaxtree, dir);\n");
+    out("    int start = checkpoint_start;\n");
+    out("    %s *resumed = NULL;\n\n", root);
+    out("    if (start > 0) {\n");
+    out("        resumed = checkpoint_read(dir, key, start);\n");
+    out("        if (resumed == NULL) {\n");
+    out("            print_user_error(\"phasedriver\",\n");
+    out("                             \"No checkpoint to start from in "
+        "%%s.\", dir);\n");
+    out("            return syntaxtree;\n");
+    out("        }\n");
+    out("    } else if (start < 0) {\n");
+    out("        start = 0;\n");
+    out("        for (int i = 0; i < %d && resumed == NULL; i++) {\n",
+        num_boundaries);
+    out("            if (checkpoint_boundaries[i] > checkpoint_stop)\n");
+    out("                continue;\n");
+    out("            resumed = checkpoint_read(dir, key, "
+        "checkpoint_boundaries[i]);\n");
+    out("            if (resumed != NULL)\n");
+    out("                start = checkpoint_boundaries[i];\n");
+    out("        }\n");
+    out("    }\n\n");
+    out("    if (resumed != NULL) {\n");
+    out("        " FREE_TREE_FORMAT "(syntaxtree);\n", root);
+    out("        syntaxtree = resumed;\n");
+    out("    }\n");
+    out("    run_phases(syntaxtree, start, checkpoint_stop, dir, key);\n");
+    out("    return syntaxtree;\n");
+    out("}\n\n");
+}
+
 static void generate(Config *config, FILE *fp, bool header) {
     if (header) {
         out("#pragma once\n");
+        if (config->batch || config->checkpoints)
+            out("#include \"generated/ast.h\"\n");
+        if (config->checkpoints)
+            out("#include \"generated/enum.h\"\n");
     } else {
         out("#include <stdio.h>\n");
         out("#include \"generated/ast.h\"\n");
         out("#include \"generated/trav-core.h\"\n");
         out("#include \"generated/trav-%s.h\"\n", config->root_node->id);
+        out("#include \"generated/consistency-ast.h\"\n");
+        out("#include \"generated/phase-driver.h\"\n");
+        if (config->presence)
+            out("#include \"generated/presence.h\"\n");
+        out("#include \"lib/print.h\"\n");
 
         for (int i = 0; i < array_size(config->passes); i++) {
             Pass *p = array_get(config->passes, i);
@@ -69,15 +1431,64 @@ static void generate(Config *config, FILE *fp, bool header) {
 
     out("\n");
 
-    out("void phasedriver_run(%s *syntaxtree)", config->root_node->id);
+    if (header) {
+        out("#ifdef " PHASE_REPORT_MACRO "\n");
+        out("void " PHASE_REPORT_PREFIX "reset(void);\n");
+        out("void " PHASE_REPORT_PREFIX "dump(const char *json_fn);\n");
+        out("#endif\n\n");
+    } else {
+        // The limit can be changed when compiling the phasedriver.
+        out("#ifndef " CYCLE_LIMIT_MACRO "\n");
+        out("#define " CYCLE_LIMIT_MACRO " %d\n", config->cycle_limit);
+        out("#endif\n\n");
+
+        // Compiled away unless the phases are traced.
+        out("#ifdef " PHASE_TRACE_MACRO "\n");
+        out("#define PHASE_TRACE(s) printf(s)\n");
+        out("#else\n");
+        out("#define PHASE_TRACE(s)\n");
+        out("#endif\n\n");
+
+        generate_report_functions(config, fp);
+        if (config->parallel)
+            generate_parallel_functions(config, fp);
+    }
+
+    int num_leaves = count_leaves(config->phase_tree);
+    DriverPos pos = {0, 0, num_leaves, -1, false, NULL};
+    if (config->checkpoints) {
+        pos.boundaries = mem_alloc(sizeof(bool) * (num_leaves + 1));
+        memset(pos.boundaries, 0, sizeof(bool) * (num_leaves + 1));
+        generate_checkpoint_functions(config, fp, header, &pos);
+    }
 
     if (header) {
-        out(";\n");
+        out("void phasedriver_run(%s *syntaxtree);\n", config->root_node->id);
+    } else if (config->checkpoints) {
+        out("static void run_phases(%s *syntaxtree, int start, int stop,\n",
+            config->root_node->id);
+        out("                       const char *dir, uint64_t key) {\n");
+        print_phase_tree(config, config->phase_tree, 0, fp,
+                         config->root_node->id, &pos, "    ");
+        out("}\n\n");
+        out("void phasedriver_run(%s *syntaxtree) {\n",
+            config->root_node->id);
+        out("    run_phases(syntaxtree, 0, %d, NULL, 0);\n", num_leaves);
+        out("}\n");
     } else {
-        out(" {\n");
-        print_phase_tree(config->phase_tree, 0, fp, config->root_node->id);
+        out("void phasedriver_run(%s *syntaxtree) {\n",
+            config->root_node->id);
+        print_phase_tree(config, config->phase_tree, 0, fp,
+                         config->root_node->id, &pos, "    ");
         out("}\n");
     }
+    mem_free(pos.boundaries);
+
+    if (config->batch) {
+        if (!header)
+            out("\n");
+        generate_batch(config, fp, header);
+    }
 }
 
 void generate_phase_driver_definitions(Config *config, FILE *fp) {
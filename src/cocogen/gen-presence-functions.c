@@ -0,0 +1,74 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "cocogen/ast.h"
+#include "cocogen/config.h"
+#include "cocogen/filegen-util.h"
+#include "cocogen/gen-presence-functions.h"
+
+#include "lib/array.h"
+
+static int mask_size(Config *config) {
+    return (array_size(config->nodes) + array_size(config->nodesets) + 7) /
+           8;
+}
+
+static void generate(Config *config, FILE *fp, bool header) {
+    out("void " PRESENCE_PREFIX "add(" NT_ENUM_NAME " type)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    if (counts[type]++ == 0)\n");
+        out("        " TYPEMASK_PREFIX "add(&present, type);\n");
+        out("}\n\n");
+    }
+
+    out("void " PRESENCE_PREFIX "remove(" NT_ENUM_NAME " type)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    if (--counts[type] == 0)\n");
+        out("        present.bits[type / 8] &= ~(1 << (type %% 8));\n");
+        out("}\n\n");
+    }
+
+    // Constant time, the masks have a fixed size.
+    out("bool " PRESENCE_PREFIX "any(const TypeMask *types)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    for (int i = 0; i < %d; i++) {\n", mask_size(config));
+        out("        if (present.bits[i] & types->bits[i])\n");
+        out("            return true;\n");
+        out("    }\n");
+        out("    return false;\n");
+        out("}\n");
+    }
+}
+
+void generate_presence_header(Config *config, FILE *fp) {
+    out("#pragma once\n");
+    out("#include <stdbool.h>\n");
+    out("#include \"generated/enum.h\"\n");
+    out("#include \"generated/reach.h\"\n");
+    out("\n");
+
+    generate(config, fp, true);
+}
+
+void generate_presence_definitions(Config *config, FILE *fp) {
+    out("#include \"generated/presence.h\"\n");
+    out("\n");
+
+    // Nodes are counted when they are created, before they belong to a
+    // tree, so the counts are shared by all trees of the program.
+    out("// Number of live nodes of every node type, and the types with live "
+        "nodes.\n");
+    out("static unsigned long counts[%d];\n", array_size(config->nodes));
+    out("static TypeMask present;\n\n");
+
+    generate(config, fp, false);
+}
@@ -0,0 +1,143 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "cocogen/ast.h"
+#include "cocogen/config.h"
+#include "cocogen/filegen-util.h"
+#include "cocogen/gen-reach-functions.h"
+#include "cocogen/gen-trav-functions.h"
+
+#include "lib/array.h"
+
+static int num_types(Config *config) {
+    return array_size(config->nodes) + array_size(config->nodesets);
+}
+
+static char *type_id(Config *config, int index) {
+    int num_nodes = array_size(config->nodes);
+
+    if (index < num_nodes)
+        return ((Node *)array_get(config->nodes, index))->id;
+    return ((Nodeset *)array_get(config->nodesets, index - num_nodes))->id;
+}
+
+// Row i has bit j set if a node of type j can occur below a node of type i.
+static void generate_reach_table(Config *config, FILE *fp) {
+    int n = num_types(config);
+    int row_size = (n + 7) / 8;
+
+    out("static const unsigned char reach_table[%d][%d] = {\n", n, row_size);
+    for (int i = 0; i < n; i++) {
+        out("    {");
+        for (int byte = 0; byte < row_size; byte++) {
+            unsigned bits = 0;
+            for (int bit = 0; bit < 8 && byte * 8 + bit < n; bit++) {
+                if (node_reachable(config, type_id(config, i),
+                                   type_id(config, byte * 8 + bit)))
+                    bits |= 1u << bit;
+            }
+            out("%s0x%02x", byte > 0 ? ", " : "", bits);
+        }
+        out("}, // %s\n", type_id(config, i));
+    }
+    out("};\n\n");
+}
+
+static void generate(Config *config, FILE *fp, bool header) {
+    out("void " TYPEMASK_PREFIX "clear(TypeMask *mask)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    memset(mask->bits, 0, sizeof(mask->bits));\n");
+        out("}\n\n");
+    }
+
+    out("void " TYPEMASK_PREFIX "add(TypeMask *mask, " NT_ENUM_NAME
+        " type)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    mask->bits[type / 8] |= 1 << (type %% 8);\n");
+        out("}\n\n");
+    }
+
+    out("bool " TYPEMASK_PREFIX "has(const TypeMask *mask, " NT_ENUM_NAME
+        " type)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    return (mask->bits[type / 8] >> (type %% 8)) & 1;\n");
+        out("}\n\n");
+    }
+
+    out("bool " REACH_PREFIX "below(" NT_ENUM_NAME " from, " NT_ENUM_NAME
+        " to)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    return (reach_table[from][to / 8] >> (to %% 8)) & 1;\n");
+        out("}\n\n");
+    }
+
+    // A walk looking for the types in 'types' only has to enter the nodes
+    // whose type is in the scope. Nodes in a nodeset child are visited with
+    // their own type, so a nodeset stands for the types of its nodes.
+    out("void " REACH_PREFIX "scope(TypeMask *scope, const TypeMask *types)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    TypeMask targets = *types;\n");
+        for (int i = 0; i < array_size(config->nodesets); i++) {
+            Nodeset *nodeset = array_get(config->nodesets, i);
+            out("    if (" TYPEMASK_PREFIX "has(types, " NT_FORMAT ")) {\n",
+                nodeset->id);
+            for (int j = 0; j < array_size(nodeset->nodes); j++) {
+                Node *node = array_get(nodeset->nodes, j);
+                out("        " TYPEMASK_PREFIX "add(&targets, " NT_FORMAT
+                    ");\n",
+                    node->id);
+            }
+            out("    }\n");
+        }
+        out("    *scope = targets;\n");
+        out("    for (int from = 0; from < %d; from++) {\n",
+            num_types(config));
+        out("        for (int i = 0; i < %d; i++) {\n",
+            (num_types(config) + 7) / 8);
+        out("            if (reach_table[from][i] & targets.bits[i]) {\n");
+        out("                " TYPEMASK_PREFIX "add(scope, from);\n");
+        out("                break;\n");
+        out("            }\n");
+        out("        }\n");
+        out("    }\n");
+        out("}\n");
+    }
+}
+
+void generate_reach_header(Config *config, FILE *fp) {
+    out("#pragma once\n");
+    out("#include <stdbool.h>\n");
+    out("#include \"generated/enum.h\"\n");
+    out("\n");
+
+    out("// Set of node types, with one bit per node type.\n");
+    out("typedef struct TypeMask {\n");
+    out("    unsigned char bits[%d];\n", (num_types(config) + 7) / 8);
+    out("} TypeMask;\n\n");
+
+    generate(config, fp, true);
+}
+
+void generate_reach_definitions(Config *config, FILE *fp) {
+    out("#include <string.h>\n");
+    out("#include \"generated/reach.h\"\n");
+    out("\n");
+
+    generate_reach_table(config, fp);
+    generate(config, fp, false);
+}
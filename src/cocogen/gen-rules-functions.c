@@ -0,0 +1,327 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cocogen/ast.h"
+#include "cocogen/config.h"
+#include "cocogen/filegen-util.h"
+#include "cocogen/gen-rules-functions.h"
+
+#include "lib/array.h"
+#include "lib/memory.h"
+
+// Test on the node being matched. Tests with the same key test the same
+// field, and at most one of their values holds.
+typedef struct Test {
+    char *key;
+    char *value;
+    char *cond;
+} Test;
+
+// Rule with the tests which are not known to hold yet.
+typedef struct Row {
+    Rule *rule;
+    array *tests;
+} Row;
+
+static void add_test(array *tests, char *key, char *value, char *cond) {
+    Test *test = mem_alloc(sizeof(Test));
+    test->key = key;
+    test->value = value;
+    test->cond = cond;
+    array_append(tests, test);
+}
+
+static void free_test(void *p) {
+    Test *test = p;
+    mem_free(test->key);
+    mem_free(test->value);
+    mem_free(test->cond);
+    mem_free(test);
+}
+
+static void collect_tests(Config *config, Pattern *pattern, char *expr,
+                          array *tests);
+
+static void collect_attr_test(Config *config, PatternField *field,
+                              char *expr, array *tests) {
+    char *value = field->value == NULL
+                      ? out_format("NULL")
+                      : out_attr_literal(config, field->attr, field->value);
+
+    add_test(tests, out_format("%s", expr), value,
+             out_attr_cond(config, field, expr));
+}
+
+static void collect_child_tests(Config *config, PatternField *field,
+                                char *expr, array *tests) {
+    Pattern *pattern = field->pattern;
+    Child *child = field->child;
+
+    if (pattern == NULL) {
+        add_test(tests, out_format("%s", expr), out_format("NULL"),
+                 out_format("%s == NULL", expr));
+    } else if (child->node != NULL) {
+        add_test(tests, out_format("%s", expr),
+                 out_format("%s", pattern->type),
+                 out_format("%s != NULL", expr));
+        collect_tests(config, pattern, expr, tests);
+    } else if (pattern->nodeset != NULL) {
+        // Any node of the nodeset, which overlaps with the tests on the
+        // type of the child.
+        add_test(tests, out_format("%s != NULL", expr),
+                 out_format("%s", expr), out_format("%s != NULL", expr));
+    } else {
+        add_test(tests, out_format("%s", expr),
+                 out_format("%s", pattern->type),
+                 out_format("%s != NULL && %s->type == " NS_FORMAT, expr,
+                            expr, child->nodeset->id, pattern->type));
+
+        char *node_expr =
+            out_format("%s->value.val_%s", expr, pattern->type);
+        collect_tests(config, pattern, node_expr, tests);
+        mem_free(node_expr);
+    }
+}
+
+// Tests in pre-order, so the type of a child is tested before its fields.
+static void collect_tests(Config *config, Pattern *pattern, char *expr,
+                          array *tests) {
+    for (int i = 0; i < array_size(pattern->fields); i++) {
+        PatternField *field = array_get(pattern->fields, i);
+        char *field_expr = out_format("%s->%s", expr, field->id);
+
+        if (field->child)
+            collect_child_tests(config, field, field_expr, tests);
+        else
+            collect_attr_test(config, field, field_expr, tests);
+
+        mem_free(field_expr);
+    }
+}
+
+static Row *create_row(Rule *rule, array *tests, Test *skip) {
+    Row *row = mem_alloc(sizeof(Row));
+    row->rule = rule;
+    row->tests = array_init(8);
+
+    for (int i = 0; i < array_size(tests); i++) {
+        Test *test = array_get(tests, i);
+        if (test != skip)
+            array_append(row->tests, test);
+    }
+    return row;
+}
+
+static void free_row(void *p) {
+    Row *row = p;
+    array_cleanup(row->tests, NULL);
+    mem_free(row);
+}
+
+static Test *row_test(Row *row, char *key) {
+    for (int i = 0; i < array_size(row->tests); i++) {
+        Test *test = array_get(row->tests, i);
+        if (strcmp(test->key, key) == 0)
+            return test;
+    }
+    return NULL;
+}
+
+// Rows which can still match if the test with 'key' has 'value', or if none
+// of the values of 'key' hold when 'value' is NULL.
+static array *branch_rows(array *rows, char *key, char *value) {
+    array *branch = array_init(8);
+
+    for (int i = 0; i < array_size(rows); i++) {
+        Row *row = array_get(rows, i);
+        Test *test = row_test(row, key);
+
+        if (test == NULL)
+            array_append(branch, create_row(row->rule, row->tests, NULL));
+        else if (value != NULL && strcmp(test->value, value) == 0)
+            array_append(branch, create_row(row->rule, row->tests, test));
+    }
+    return branch;
+}
+
+static void out_indent(FILE *fp, int level) {
+    for (int i = 0; i < level; i++)
+        out("    ");
+}
+
+// Every branch tests a field once, the rules which do not test it are
+// copied into every branch. Rules are tried in order of priority, a rule
+// whose action does not apply falls through to the next rule.
+static void generate_decision_tree(Rules *rules, array *rows, int level,
+                                   FILE *fp) {
+    if (array_size(rows) == 0)
+        return;
+
+    Row *first = array_get(rows, 0);
+
+    if (array_size(first->tests) == 0) {
+        out_indent(fp, level);
+        out("res = " RULE_ACTION_FORMAT "(node, info);\n", rules->id,
+            first->rule->id);
+        out_indent(fp, level);
+        out("if (res != NULL)\n");
+        out_indent(fp, level + 1);
+        out("return res;\n");
+
+        array *rest = array_init(8);
+        for (int i = 1; i < array_size(rows); i++) {
+            Row *row = array_get(rows, i);
+            array_append(rest, create_row(row->rule, row->tests, NULL));
+        }
+        generate_decision_tree(rules, rest, level, fp);
+        array_cleanup(rest, free_row);
+        return;
+    }
+
+    char *key = ((Test *)array_get(first->tests, 0))->key;
+    array *values = array_init(8);
+
+    for (int i = 0; i < array_size(rows); i++) {
+        Test *test = row_test(array_get(rows, i), key);
+        if (test == NULL)
+            continue;
+
+        bool seen = false;
+        for (int j = 0; j < array_size(values); j++) {
+            if (strcmp(((Test *)array_get(values, j))->value, test->value) ==
+                0)
+                seen = true;
+        }
+        if (!seen)
+            array_append(values, test);
+    }
+
+    for (int i = 0; i < array_size(values); i++) {
+        Test *test = array_get(values, i);
+        out_indent(fp, level);
+        out("%sif (%s) {\n", i > 0 ? "} else " : "", test->cond);
+
+        array *branch = branch_rows(rows, key, test->value);
+        generate_decision_tree(rules, branch, level + 1, fp);
+        array_cleanup(branch, free_row);
+    }
+
+    array *others = branch_rows(rows, key, NULL);
+    if (array_size(others) > 0) {
+        out_indent(fp, level);
+        out("} else {\n");
+        generate_decision_tree(rules, others, level + 1, fp);
+    }
+    array_cleanup(others, free_row);
+
+    out_indent(fp, level);
+    out("}\n");
+
+    array_cleanup(values, NULL);
+}
+
+// Returns the result of the first action that applies, NULL if none does.
+static void generate_match(Config *config, Rules *rules, char *node,
+                           FILE *fp) {
+    array *rows = array_init(8);
+    array *tests = array_init(16);
+
+    for (int i = 0; i < array_size(rules->rules); i++) {
+        Rule *rule = array_get(rules->rules, i);
+        if (strcmp(rule->pattern->type, node) != 0)
+            continue;
+
+        array *rule_tests = array_init(8);
+        collect_tests(config, rule->pattern, "node", rule_tests);
+        array_append(rows, create_row(rule, rule_tests, NULL));
+
+        for (int j = 0; j < array_size(rule_tests); j++)
+            array_append(tests, array_get(rule_tests, j));
+        array_cleanup(rule_tests, NULL);
+    }
+
+    out("static struct %s *match_%s(struct %s *node, struct Info *info) {\n",
+        node, node, node);
+    out("    struct %s *res;\n\n", node);
+    generate_decision_tree(rules, rows, 1, fp);
+    out("    return NULL;\n");
+    out("}\n\n");
+
+    array_cleanup(rows, free_row);
+    array_cleanup(tests, free_test);
+}
+
+static void generate_handler(Config *config, Rules *rules, char *id,
+                             FILE *fp) {
+    Node *node = NULL;
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *n = array_get(config->nodes, i);
+        if (strcmp(n->id, id) == 0)
+            node = n;
+    }
+
+    generate_match(config, rules, id, fp);
+
+    out("struct %s *" TRAVERSAL_HANDLER_FORMAT
+        "(struct %s *node, struct Info *info) {\n",
+        id, rules->id, id, id);
+
+    // The children are rewritten first, so the patterns see the result.
+    for (int i = 0; i < array_size(node->children); i++) {
+        Child *child = array_get(node->children, i);
+        out("    " TRAV_PREFIX "%s_%s(node, info);\n", id, child->id);
+    }
+    if (array_size(node->children) > 0)
+        out("\n");
+
+    // An action that returns the node itself has rewritten it in place, or
+    // replaced it with replace_<Node>. Either way it is a rewrite.
+    out("    // Match the node again after every rewrite, until no rule "
+        "applies.\n");
+    out("    for (;;) {\n");
+    out("        struct %s *res = match_%s(node, info);\n", id, id);
+    out("        if (res == NULL)\n");
+    out("            return node;\n\n");
+    out("        " RULES_PREFIX "changes++;\n");
+    out_count_change(config, fp, "        ");
+    out("        if (node_replacement != NULL)\n");
+    out("            return res;\n");
+    out("        node = res;\n");
+    out("    }\n");
+    out("}\n\n");
+}
+
+void generate_rules_definitions(Config *config, FILE *fp, Rules *rules) {
+    char *root = config->root_node->id;
+    Traversal *trav = rules->traversal;
+
+    out("#include <string.h>\n");
+    out("#include \"generated/trav-core.h\"\n");
+    out("#include \"generated/trav-%s.h\"\n", root);
+    out("#include \"generated/traversal-%s.h\"\n", rules->id);
+    out("\n");
+
+    out("// Number of rewrites in the current run over the tree.\n");
+    out("static %sint " RULES_PREFIX "changes;\n\n",
+        out_thread_local(config));
+
+    // The rules have no state of their own.
+    out("struct Info *%s_createinfo(void) {\n", rules->id);
+    out("    return NULL;\n");
+    out("}\n\n");
+    out("void %s_freeinfo(struct Info *info) {}\n\n", rules->id);
+
+    for (int i = 0; i < array_size(trav->nodes); i++)
+        generate_handler(config, rules, array_get(trav->nodes, i), fp);
+
+    out("struct %s *" RULES_RUN_FORMAT "(struct %s *node) {\n", root,
+        rules->id, root);
+    out("    do {\n");
+    out("        " RULES_PREFIX "changes = 0;\n");
+    out("        node = " TRAV_START_FORMAT "(node, " TRAV_FORMAT ");\n",
+        root, rules->id);
+    out("    } while (" RULES_PREFIX "changes > 0);\n");
+    out("    return node;\n");
+    out("}\n");
+}
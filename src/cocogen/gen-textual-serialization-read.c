@@ -55,6 +55,7 @@ void generate_textual_serialization_read_node(Config *config, FILE *fp,
     out("#include \"lib/smap.h\"\n");
     out("#include \"lib/memory.h\"\n");
     out("#include \"lib/print.h\"\n");
+    out_track_includes(config, fp);
     out("\n");
 
     for (int i = 0; i < array_size(node->children); i++) {
@@ -72,6 +73,7 @@ void generate_textual_serialization_read_node(Config *config, FILE *fp,
     out("    bool error = false;\n");
     out("    %s *res = mem_alloc(sizeof(%s));\n", node->id, node->id);
     out("    memset(res, 0, sizeof(%s));\n", node->id);
+    out_track_init(config, fp, "    ", "res", node);
     out("    AST_TXT_Node *node = imap_retrieve(file->node_id_map, (void*) "
         "node_id);\n");
     out("\n");
@@ -100,6 +102,7 @@ void generate_textual_serialization_read_node(Config *config, FILE *fp,
                 "c->id);\n",
                 c->type, c->type);
             out("            res->%s = child;\n", c->id);
+            out_track_child(config, fp, "            ", "res", node, c);
 
             out("        }\n");
         }
@@ -0,0 +1,443 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cocogen/ast.h"
+#include "cocogen/config.h"
+#include "cocogen/filegen-util.h"
+#include "cocogen/gen-tiles-functions.h"
+
+#include "lib/array.h"
+#include "lib/memory.h"
+#include "lib/smap.h"
+
+// Node types in the patterns of the tiles, the labeler computes the states
+// of these nodes.
+static void collect_nodes(Pattern *pattern, smap_t *nodes) {
+    if (pattern->node != NULL)
+        smap_insert(nodes, pattern->node->id, pattern->node);
+
+    for (int i = 0; i < array_size(pattern->fields); i++) {
+        PatternField *field = array_get(pattern->fields, i);
+        if (field->pattern != NULL)
+            collect_nodes(field->pattern, nodes);
+    }
+}
+
+static bool nodeset_labeled(Nodeset *nodeset, smap_t *nodes) {
+    for (int i = 0; i < array_size(nodeset->nodes); i++) {
+        Node *node = array_get(nodeset->nodes, i);
+        if (smap_retrieve(nodes, node->id) != NULL)
+            return true;
+    }
+    return false;
+}
+
+static bool child_labeled(Child *child, smap_t *nodes) {
+    if (child->node != NULL)
+        return smap_retrieve(nodes, child->node->id) != NULL;
+    return nodeset_labeled(child->nodeset, nodes);
+}
+
+static int child_index(Node *node, Child *child) {
+    for (int i = 0; i < array_size(node->children); i++) {
+        if (array_get(node->children, i) == child)
+            return i;
+    }
+    return -1;
+}
+
+static bool is_chain_rule(Rule *rule) {
+    return rule->pattern->nonterminal;
+}
+
+static void out_nonterminal(FILE *fp, Tiles *tiles, char *nonterminal) {
+    out(TILES_NT_FORMAT, tiles->id, nonterminal);
+}
+
+// Conditions under which the pattern matches the node 'expr' with state
+// 'state', and the costs of the nonterminals at its leaves.
+static void collect_match(Tiles *tiles, Config *config, Pattern *pattern,
+                          char *expr, char *state, array *conds,
+                          array *costs) {
+    for (int i = 0; i < array_size(pattern->fields); i++) {
+        PatternField *field = array_get(pattern->fields, i);
+        char *field_expr = out_format("%s->%s", expr, field->id);
+
+        if (field->attr) {
+            array_append(conds, out_attr_cond(config, field, field_expr));
+            mem_free(field_expr);
+            continue;
+        }
+
+        Pattern *sub = field->pattern;
+        Child *child = field->child;
+        char *kid = out_format("%s->kids[%d]", state,
+                               child_index(pattern->node, child));
+
+        if (sub == NULL) {
+            array_append(conds, out_format("%s == NULL", field_expr));
+        } else if (sub->nonterminal) {
+            char *cost = out_format(TILES_NT_FORMAT, tiles->id, sub->type);
+            array_append(conds,
+                         out_format("%s != NULL && %s->cost[%s] < INF_COST",
+                                    kid, kid, cost));
+            array_append(costs, out_format("%s->cost[%s]", kid, cost));
+            mem_free(cost);
+        } else if (child->node != NULL) {
+            array_append(conds, out_format("%s != NULL", field_expr));
+            collect_match(tiles, config, sub, field_expr, kid, conds, costs);
+        } else if (sub->nodeset != NULL) {
+            array_append(conds, out_format("%s != NULL", field_expr));
+        } else {
+            array_append(conds,
+                         out_format("%s != NULL && %s->type == " NS_FORMAT,
+                                    field_expr, field_expr,
+                                    child->nodeset->id, sub->type));
+
+            char *node_expr =
+                out_format("%s->value.val_%s", field_expr, sub->type);
+            collect_match(tiles, config, sub, node_expr, kid, conds, costs);
+            mem_free(node_expr);
+        }
+
+        mem_free(kid);
+        mem_free(field_expr);
+    }
+}
+
+// Nonterminals at the leaves of the pattern, in the order they are reduced.
+static void collect_leaves(Tiles *tiles, Pattern *pattern, char *state,
+                           array *leaves) {
+    for (int i = 0; i < array_size(pattern->fields); i++) {
+        PatternField *field = array_get(pattern->fields, i);
+        Pattern *sub = field->pattern;
+        if (sub == NULL || sub->nodeset != NULL)
+            continue;
+
+        char *kid = out_format("%s->kids[%d]", state,
+                               child_index(pattern->node, field->child));
+        if (sub->nonterminal) {
+            array_append(leaves,
+                         out_format("reduce(%s, " TILES_NT_FORMAT ", info);",
+                                    kid, tiles->id, sub->type));
+        } else {
+            collect_leaves(tiles, sub, kid, leaves);
+        }
+        mem_free(kid);
+    }
+}
+
+static void generate_rule_label(Config *config, Tiles *tiles, Rule *rule,
+                                int index, FILE *fp) {
+    array *conds = array_init(8);
+    array *costs = array_init(8);
+
+    collect_match(tiles, config, rule->pattern, "node", "s", conds, costs);
+
+    out("    // Rule %s.\n", rule->id);
+    if (array_size(conds) > 0) {
+        bool parens = array_size(conds) > 1;
+        out("    if (");
+        for (int i = 0; i < array_size(conds); i++) {
+            out(parens ? "%s(%s)" : "%s%s", i > 0 ? " &&\n        " : "",
+                (char *)array_get(conds, i));
+        }
+        out(")\n    ");
+    }
+
+    out("    record(s, ");
+    out_nonterminal(fp, tiles, rule->nonterminal);
+    out(", %" PRIu64, rule->cost);
+    for (int i = 0; i < array_size(costs); i++)
+        out(" + %s", (char *)array_get(costs, i));
+    out(", %d);\n", index);
+
+    array_cleanup(conds, mem_free);
+    array_cleanup(costs, mem_free);
+}
+
+// The chain rules derive a nonterminal from another nonterminal of the same
+// node, they are applied until no cost improves. Costs are never negative,
+// so this ends.
+static void generate_closure(Tiles *tiles, FILE *fp) {
+    out("static void closure(struct State *s) {\n");
+    out("    bool changed = true;\n");
+    out("    while (changed) {\n");
+    out("        changed = false;\n");
+    for (int i = 0; i < array_size(tiles->rules); i++) {
+        Rule *rule = array_get(tiles->rules, i);
+        if (!is_chain_rule(rule))
+            continue;
+
+        out("        // Rule %s.\n", rule->id);
+        out("        if (s->cost[");
+        out_nonterminal(fp, tiles, rule->pattern->type);
+        out("] < INF_COST)\n");
+        out("            changed |= record(s, ");
+        out_nonterminal(fp, tiles, rule->nonterminal);
+        out(", s->cost[");
+        out_nonterminal(fp, tiles, rule->pattern->type);
+        out("] + %" PRIu64 ", %d);\n", rule->cost, i + 1);
+    }
+    out("    }\n");
+    out("}\n\n");
+}
+
+static bool has_chain_rules(Tiles *tiles) {
+    for (int i = 0; i < array_size(tiles->rules); i++) {
+        if (is_chain_rule(array_get(tiles->rules, i)))
+            return true;
+    }
+    return false;
+}
+
+static void generate_node_label(Config *config, Tiles *tiles, Node *node,
+                                smap_t *nodes, FILE *fp) {
+    int num_kids = array_size(node->children);
+
+    out("static struct State *label_%s(%s *node) {\n", node->id, node->id);
+    out("    if (node == NULL)\n");
+    out("        return NULL;\n\n");
+    out("    struct State *s = state_new(node, %d);\n", num_kids);
+    for (int i = 0; i < num_kids; i++) {
+        Child *child = array_get(node->children, i);
+        if (child_labeled(child, nodes))
+            out("    s->kids[%d] = label_%s(node->%s);\n", i, child->type,
+                child->id);
+    }
+    out("\n");
+
+    for (int i = 0; i < array_size(tiles->rules); i++) {
+        Rule *rule = array_get(tiles->rules, i);
+        if (rule->pattern->node == node)
+            generate_rule_label(config, tiles, rule, i + 1, fp);
+    }
+
+    if (has_chain_rules(tiles))
+        out("\n    closure(s);\n");
+    out("    return s;\n");
+    out("}\n\n");
+}
+
+static void generate_nodeset_label(Nodeset *nodeset, smap_t *nodes,
+                                   FILE *fp) {
+    out("static struct State *label_%s(%s *node) {\n", nodeset->id,
+        nodeset->id);
+    out("    if (node == NULL)\n");
+    out("        return NULL;\n\n");
+    out("    switch (node->type) {\n");
+    for (int i = 0; i < array_size(nodeset->nodes); i++) {
+        Node *node = array_get(nodeset->nodes, i);
+        if (smap_retrieve(nodes, node->id) == NULL)
+            continue;
+        out("    case " NS_FORMAT ":\n", nodeset->id, node->id);
+        out("        return label_%s(node->value.val_%s);\n", node->id,
+            node->id);
+    }
+    out("    default:\n");
+    out("        return NULL;\n");
+    out("    }\n");
+    out("}\n\n");
+}
+
+static void generate_reduce(Tiles *tiles, FILE *fp) {
+    out("// Calls the actions of the rules deriving 'nt', children first.\n");
+    out("static void reduce(struct State *s, int nt, struct Info *info) {\n");
+    out("    switch (s->rule[nt]) {\n");
+    for (int i = 0; i < array_size(tiles->rules); i++) {
+        Rule *rule = array_get(tiles->rules, i);
+        Pattern *pattern = rule->pattern;
+
+        out("    case %d: // %s\n", i + 1, rule->id);
+        if (is_chain_rule(rule)) {
+            out("        reduce(s, ");
+            out_nonterminal(fp, tiles, pattern->type);
+            out(", info);\n");
+            out("        %s_%s(info);\n", tiles->id, rule->id);
+            out("        break;\n");
+            continue;
+        }
+
+        array *leaves = array_init(8);
+        collect_leaves(tiles, pattern, "s", leaves);
+        for (int j = 0; j < array_size(leaves); j++)
+            out("        %s\n", (char *)array_get(leaves, j));
+        array_cleanup(leaves, mem_free);
+
+        out("        %s_%s(s->node, info);\n", tiles->id, rule->id);
+        out("        break;\n");
+    }
+    out("    }\n");
+    out("}\n\n");
+}
+
+static void generate_select(Tiles *tiles, char *type, bool header,
+                            FILE *fp) {
+    out("bool " TILES_SELECT_FORMAT "(%s *node, " TILES_NT_ENUM_FORMAT
+        " goal, Info *info)",
+        tiles->id, type, type, tiles->id);
+    if (header) {
+        out(";\n");
+        return;
+    }
+
+    out(" {\n");
+    out("    struct State *s = label_%s(node);\n", type);
+    out("    bool covered = s != NULL && s->cost[goal] < INF_COST;\n\n");
+    out("    if (covered)\n");
+    out("        reduce(s, goal, info);\n");
+    out("    state_free(s);\n");
+    out("    return covered;\n");
+    out("}\n\n");
+}
+
+// Every node and nodeset which can be labeled has a function selecting the
+// tiles of its tree.
+static void generate_selects(Config *config, Tiles *tiles, smap_t *nodes,
+                             bool header, FILE *fp) {
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+        if (smap_retrieve(nodes, node->id) != NULL)
+            generate_select(tiles, node->id, header, fp);
+    }
+    for (int i = 0; i < array_size(config->nodesets); i++) {
+        Nodeset *nodeset = array_get(config->nodesets, i);
+        if (nodeset_labeled(nodeset, nodes))
+            generate_select(tiles, nodeset->id, header, fp);
+    }
+}
+
+static smap_t *labeled_nodes(Tiles *tiles) {
+    smap_t *nodes = smap_init(16);
+    for (int i = 0; i < array_size(tiles->rules); i++) {
+        Rule *rule = array_get(tiles->rules, i);
+        collect_nodes(rule->pattern, nodes);
+    }
+    return nodes;
+}
+
+void generate_tiles_header(Config *config, FILE *fp, Tiles *tiles) {
+    smap_t *nodes = labeled_nodes(tiles);
+
+    out("#pragma once\n");
+    out("#include <stdbool.h>\n");
+    out("#include \"generated/ast.h\"\n\n");
+    out("typedef struct Info Info;\n\n");
+
+    out("typedef enum {\n");
+    for (int i = 0; i < array_size(tiles->nonterminals); i++) {
+        out("    ");
+        out_nonterminal(fp, tiles, array_get(tiles->nonterminals, i));
+        out(",\n");
+    }
+    out("} " TILES_NT_ENUM_FORMAT ";\n\n", tiles->id);
+
+    out("// Actions of the rules, called when a tree is reduced.\n");
+    for (int i = 0; i < array_size(tiles->rules); i++) {
+        Rule *rule = array_get(tiles->rules, i);
+        if (is_chain_rule(rule))
+            out("void %s_%s(Info *info);\n", tiles->id, rule->id);
+        else
+            out("void %s_%s(%s *node, Info *info);\n", tiles->id, rule->id,
+                rule->pattern->type);
+    }
+    out("\n");
+
+    out("// Cover the tree with rules of minimal cost deriving 'goal' and "
+        "call their\n");
+    out("// actions, or return false if the tree cannot derive 'goal'.\n");
+    generate_selects(config, tiles, nodes, true, fp);
+
+    smap_free(nodes);
+}
+
+void generate_tiles_definitions(Config *config, FILE *fp, Tiles *tiles) {
+    smap_t *nodes = labeled_nodes(tiles);
+
+    out("#include <stdint.h>\n");
+    out("#include <string.h>\n");
+    out("#include \"lib/memory.h\"\n");
+    out("#include \"generated/tiles-%s.h\"\n\n", tiles->id);
+
+    out("#define NUM_NONTERMINALS %d\n", array_size(tiles->nonterminals));
+    out("#define INF_COST INT64_MAX\n\n");
+
+    out("// The cheapest rule deriving every nonterminal from a node, 0 if "
+        "none does.\n");
+    out("struct State {\n");
+    out("    void *node;\n");
+    out("    int64_t cost[NUM_NONTERMINALS];\n");
+    out("    int rule[NUM_NONTERMINALS];\n");
+    out("    int num_kids;\n");
+    out("    struct State *kids[];\n");
+    out("};\n\n");
+
+    out("static struct State *state_new(void *node, int num_kids) {\n");
+    out("    struct State *s = mem_alloc(sizeof(struct State) +\n");
+    out("                                num_kids * sizeof(struct State "
+        "*));\n");
+    out("    s->node = node;\n");
+    out("    for (int i = 0; i < NUM_NONTERMINALS; i++) {\n");
+    out("        s->cost[i] = INF_COST;\n");
+    out("        s->rule[i] = 0;\n");
+    out("    }\n");
+    out("    s->num_kids = num_kids;\n");
+    out("    for (int i = 0; i < num_kids; i++)\n");
+    out("        s->kids[i] = NULL;\n");
+    out("    return s;\n");
+    out("}\n\n");
+
+    out("static void state_free(struct State *s) {\n");
+    out("    if (s == NULL)\n");
+    out("        return;\n");
+    out("    for (int i = 0; i < s->num_kids; i++)\n");
+    out("        state_free(s->kids[i]);\n");
+    out("    mem_free(s);\n");
+    out("}\n\n");
+
+    out("static bool record(struct State *s, int nt, int64_t cost, int rule) "
+        "{\n");
+    out("    if (cost >= s->cost[nt])\n");
+    out("        return false;\n");
+    out("    s->cost[nt] = cost;\n");
+    out("    s->rule[nt] = rule;\n");
+    out("    return true;\n");
+    out("}\n\n");
+
+    if (has_chain_rules(tiles))
+        generate_closure(tiles, fp);
+
+    // The labels of a node depend on the labels of its children, which are
+    // computed first.
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+        if (smap_retrieve(nodes, node->id) != NULL)
+            out("static struct State *label_%s(%s *node);\n", node->id,
+                node->id);
+    }
+    for (int i = 0; i < array_size(config->nodesets); i++) {
+        Nodeset *nodeset = array_get(config->nodesets, i);
+        if (nodeset_labeled(nodeset, nodes))
+            out("static struct State *label_%s(%s *node);\n", nodeset->id,
+                nodeset->id);
+    }
+    out("\n");
+
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *node = array_get(config->nodes, i);
+        if (smap_retrieve(nodes, node->id) != NULL)
+            generate_node_label(config, tiles, node, nodes, fp);
+    }
+    for (int i = 0; i < array_size(config->nodesets); i++) {
+        Nodeset *nodeset = array_get(config->nodesets, i);
+        if (nodeset_labeled(nodeset, nodes))
+            generate_nodeset_label(nodeset, nodes, fp);
+    }
+
+    generate_reduce(tiles, fp);
+    generate_selects(config, tiles, nodes, false, fp);
+
+    smap_free(nodes);
+}
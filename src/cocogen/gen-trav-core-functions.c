@@ -7,11 +7,108 @@
 #include "cocogen/filegen-util.h"
 #include "cocogen/gen-trav-core-functions.h"
 
-static void generate_stack_functions(FILE *fp, bool header) {
+static int num_traversal_types(Config *config) {
+    int num = array_size(config->traversals) + array_size(config->fusions);
+
+    // The traversal enum always has a value, a placeholder if needed.
+    return num > 0 ? num : 1;
+}
+
+// Handlers of rewrite traversals return the node to store in the parent,
+// the child edges check node_replacement_returned to pick the convention.
+static void generate_rewrite_table(Config *config, FILE *fp) {
+    out("static const bool rewrite_traversals[%d] = {\n",
+        num_traversal_types(config));
+    if (array_size(config->traversals) == 0)
+        out("    false,\n");
+    for (int i = 0; i < array_size(config->traversals); i++) {
+        Traversal *t = array_get(config->traversals, i);
+        out("    %s,\n", t->rewrite ? "true" : "false");
+    }
+    for (int i = 0; i < array_size(config->fusions); i++)
+        out("    false,\n");
+    out("};\n\n");
+}
+
+// The child edges of readonly traversals skip the bookkeeping of
+// node_replacement. A fusion is readonly if all its members are.
+static void generate_readonly_table(Config *config, FILE *fp) {
+    out("static const bool readonly_traversals[%d] = {\n",
+        num_traversal_types(config));
+    if (array_size(config->traversals) == 0)
+        out("    false,\n");
+    for (int i = 0; i < array_size(config->traversals); i++) {
+        Traversal *t = array_get(config->traversals, i);
+        out("    %s,\n", t->readonly ? "true" : "false");
+    }
+    for (int i = 0; i < array_size(config->fusions); i++) {
+        Fusion *f = array_get(config->fusions, i);
+        bool readonly = true;
+        for (int j = 0; j < array_size(f->traversals); j++) {
+            Traversal *t = array_get(f->traversals, j);
+            readonly = readonly && t->readonly;
+        }
+        out("    %s,\n", readonly ? "true" : "false");
+    }
+    out("};\n\n");
+}
+
+// The child edges return at once unless the control is TC_continue, so an
+// aborted traversal unwinds through the normal returns.
+static void generate_control_functions(Config *config, FILE *fp,
+                                       bool header) {
+    out("void " TRAV_PREFIX "abort(void)");
+    if (header) {
+        out(";\n");
+    } else {
+        // The members of a fused traversal share one walk, aborting it
+        // would skip the nodes of the other members.
+        out(" {\n");
+        if (array_size(config->fusions) > 0) {
+            out("    if (current_traversal->current >= %d) {\n",
+                array_size(config->traversals));
+            out("        print_user_error(\"traversal-driver\", \"Cannot "
+                "abort a fused traversal.\");\n");
+            out("        return;\n");
+            out("    }\n");
+        }
+        out("    " TRAV_PREFIX "control = " TC_ENUM_PREFIX "abort;\n");
+        out("}\n\n");
+    }
+
+    out("bool " TRAV_PREFIX "aborted(void)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    return " TRAV_PREFIX "control == " TC_ENUM_PREFIX "abort;\n");
+        out("}\n\n");
+    }
+
+    out("void " TRAV_PREFIX "skip_children(void)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    if (" TRAV_PREFIX "control == " TC_ENUM_PREFIX "continue)\n");
+        out("        " TRAV_PREFIX "control = " TC_ENUM_PREFIX
+            "skip_children;\n");
+        out("}\n\n");
+    }
+}
+
+static void generate_stack_functions(Config *config, FILE *fp,
+                                     bool header) {
     if (!header) {
         out("struct TravStack {\n");
         out("    struct TravStack *prev;\n");
         out("    " TRAV_ENUM_NAME " current;\n");
+        out("    void **infos;\n");
+        out("    // Control of the traversal that started this one.\n");
+        out("    " TC_ENUM_NAME " control;\n");
+        out("    const TypeMask *scope;\n");
+        if (config->incremental)
+            out("    unsigned long since;\n");
         out("};\n\n");
     }
 
@@ -23,8 +120,17 @@ static void generate_stack_functions(FILE *fp, bool header) {
         out("    struct TravStack *new = (struct "
             "TravStack*)mem_alloc(sizeof(struct TravStack));\n");
         out("    new->current = trav;\n");
+        out("    new->infos = NULL;\n");
+        if (config->incremental)
+            out("    new->since = 0;\n");
+        out("    new->control = " TRAV_PREFIX "control;\n");
+        out("    new->scope = " TRAV_PREFIX "scope;\n");
         out("    new->prev = current_traversal;\n");
         out("    current_traversal = new;\n");
+        out("    " TRAV_PREFIX "control = " TC_ENUM_PREFIX "continue;\n");
+        out("    " TRAV_PREFIX "scope = NULL;\n");
+        out("    node_replacement_returned = rewrite_traversals[trav];\n");
+        out("    " TRAV_PREFIX "readonly = readonly_traversals[trav];\n");
         out("}\n\n");
     }
 
@@ -39,8 +145,14 @@ static void generate_stack_functions(FILE *fp, bool header) {
         out("        return;\n");
         out("    }\n");
         out("    struct TravStack *prev = current_traversal->prev;\n");
+        out("    " TRAV_PREFIX "control = current_traversal->control;\n");
+        out("    " TRAV_PREFIX "scope = current_traversal->scope;\n");
         out("    mem_free(current_traversal);\n");
         out("    current_traversal = prev;\n");
+        out("    node_replacement_returned =\n");
+        out("        prev != NULL && rewrite_traversals[prev->current];\n");
+        out("    " TRAV_PREFIX "readonly =\n");
+        out("        prev != NULL && readonly_traversals[prev->current];\n");
         out("}\n\n");
     }
 
@@ -52,26 +164,299 @@ static void generate_stack_functions(FILE *fp, bool header) {
         out("    return current_traversal->current;\n");
         out("}\n\n");
     }
+
+    // A fused traversal keeps the info of every member traversal.
+    out("void " TRAV_PREFIX "fuse(void **infos)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    current_traversal->infos = infos;\n");
+        out("}\n\n");
+    }
+
+    out("void *" TRAV_PREFIX "fused_info(int index)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    return current_traversal->infos[index];\n");
+        out("}\n\n");
+    }
+
+    generate_control_functions(config, fp, header);
+
+    if (!config->incremental)
+        return;
+
+    // Epoch from which changed nodes are visited by an incremental traversal.
+    out("void " TRAV_PREFIX "set_since(unsigned long since)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    current_traversal->since = since;\n");
+        out("}\n\n");
+    }
+
+    out("unsigned long " TRAV_PREFIX "since(void)");
+    if (header) {
+        out(";\n");
+    } else {
+        out(" {\n");
+        out("    return current_traversal->since;\n");
+        out("}\n\n");
+    }
+}
+
+static void generate_profile_names(Config *config, FILE *fp) {
+    out("static const char *profile_trav_names[%d] = {\n",
+        num_traversal_types(config));
+    if (array_size(config->traversals) == 0)
+        out("    \"PLACEHOLDER\",\n");
+    for (int i = 0; i < array_size(config->traversals); i++) {
+        Traversal *t = array_get(config->traversals, i);
+        out("    \"%s\",\n", t->id);
+    }
+    for (int i = 0; i < array_size(config->fusions); i++) {
+        Fusion *f = array_get(config->fusions, i);
+        out("    \"%s\",\n", f->id);
+    }
+    out("};\n\n");
+
+    out("static const char *profile_node_names[%d] = {\n",
+        array_size(config->nodes) + array_size(config->nodesets));
+    for (int i = 0; i < array_size(config->nodes); i++) {
+        Node *n = array_get(config->nodes, i);
+        out("    \"%s\",\n", n->id);
+    }
+    for (int i = 0; i < array_size(config->nodesets); i++) {
+        Nodeset *n = array_get(config->nodesets, i);
+        out("    \"%s\",\n", n->id);
+    }
+    out("};\n\n");
+}
+
+// Visit counters and timers of every (traversal, node type) pair, which only
+// exist when the generated code is compiled with PROFILE_MACRO defined.
+static void generate_profile_functions(Config *config, FILE *fp,
+                                       bool header) {
+    int num_travs = num_traversal_types(config);
+    int num_types = array_size(config->nodes) + array_size(config->nodesets);
+    char *tl = out_thread_local(config);
+
+    if (header) {
+        out("\n#ifdef " PROFILE_CYCLES_MACRO "\n");
+        out("#ifndef " PROFILE_MACRO "\n");
+        out("#define " PROFILE_MACRO "\n");
+        out("#endif\n");
+        out("#endif\n\n");
+
+        out("#ifdef " PROFILE_MACRO "\n");
+        out("#include <stdint.h>\n\n");
+        out("// Bookkeeping of one visit of a node, lives on the stack of "
+            "_trav_<Node>.\n");
+        out("typedef struct TravProfileFrame {\n");
+        out("    " TRAV_ENUM_NAME " trav;\n");
+        out("    uint64_t start;\n");
+        out("    uint64_t saved_children;\n");
+        out("} TravProfileFrame;\n\n");
+        out("void " PROFILE_PREFIX "enter(TravProfileFrame *frame);\n");
+        out("void " PROFILE_PREFIX "leave(TravProfileFrame *frame, "
+            NT_ENUM_NAME " type);\n");
+        out("void " PROFILE_PREFIX "reset(void);\n");
+        out("void " PROFILE_PREFIX "dump(const char *csv_fn);\n");
+        out("#endif\n");
+        return;
+    }
+
+    out("\n#ifdef " PROFILE_MACRO "\n");
+    out("#include <stdint.h>\n");
+    out("#include <stdlib.h>\n");
+    out("#include <string.h>\n\n");
+
+    out("#ifdef " PROFILE_CYCLES_MACRO "\n");
+    out("#if defined(__x86_64__) || defined(__i386__)\n");
+    out("#include <x86intrin.h>\n");
+    out("static inline uint64_t profile_now(void) { return __rdtsc(); }\n");
+    out("#else\n");
+    out("#include <time.h>\n");
+    out("static inline uint64_t profile_now(void) {\n");
+    out("    struct timespec ts;\n");
+    out("    clock_gettime(CLOCK_MONOTONIC, &ts);\n");
+    out("    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;\n");
+    out("}\n");
+    out("#endif\n");
+    out("#else\n");
+    out("static inline uint64_t profile_now(void) { return 0; }\n");
+    out("#endif\n\n");
+
+    generate_profile_names(config, fp);
+
+    out("static %suint64_t profile_visits[%d][%d];\n", tl, num_travs,
+        num_types);
+    out("static %suint64_t profile_cycles[%d][%d];\n", tl, num_travs,
+        num_types);
+    out("// Cycles spent in the children of the node visited at the "
+        "moment.\n");
+    out("static %suint64_t profile_children;\n\n", tl);
+
+    out("void " PROFILE_PREFIX "enter(TravProfileFrame *frame) {\n");
+    out("    frame->trav = current_traversal->current;\n");
+    out("    frame->saved_children = profile_children;\n");
+    out("    profile_children = 0;\n");
+    out("    frame->start = profile_now();\n");
+    out("}\n\n");
+
+    // Only the cycles spent in the node itself are accounted to its type,
+    // the cycles of its children are accounted to their own types.
+    out("void " PROFILE_PREFIX "leave(TravProfileFrame *frame, "
+        NT_ENUM_NAME " type) {\n");
+    out("    uint64_t elapsed = profile_now() - frame->start;\n");
+    out("    profile_visits[frame->trav][type]++;\n");
+    out("    profile_cycles[frame->trav][type] += elapsed - "
+        "profile_children;\n");
+    out("    profile_children = frame->saved_children + elapsed;\n");
+    out("}\n\n");
+
+    out("void " PROFILE_PREFIX "reset(void) {\n");
+    out("    memset(profile_visits, 0, sizeof(profile_visits));\n");
+    out("    memset(profile_cycles, 0, sizeof(profile_cycles));\n");
+    out("}\n\n");
+
+    out("typedef struct ProfileEntry {\n");
+    out("    int trav;\n");
+    out("    int type;\n");
+    out("} ProfileEntry;\n\n");
+
+    out("static int profile_compare(const void *a, const void *b) {\n");
+    out("    const ProfileEntry *e1 = a, *e2 = b;\n");
+    out("    uint64_t c1 = profile_cycles[e1->trav][e1->type];\n");
+    out("    uint64_t c2 = profile_cycles[e2->trav][e2->type];\n");
+    out("    if (c1 != c2) return c1 < c2 ? 1 : -1;\n");
+    out("    uint64_t v1 = profile_visits[e1->trav][e1->type];\n");
+    out("    uint64_t v2 = profile_visits[e2->trav][e2->type];\n");
+    out("    if (v1 != v2) return v1 < v2 ? 1 : -1;\n");
+    out("    return 0;\n");
+    out("}\n\n");
+
+    out("// Print a table sorted on cycles and visits to stderr, or write "
+        "CSV\n");
+    out("// with the columns traversal,node,visits,cycles to csv_fn.\n");
+    out("void " PROFILE_PREFIX "dump(const char *csv_fn) {\n");
+    out("    ProfileEntry entries[%d];\n", num_travs * num_types);
+    out("    int num_entries = 0;\n");
+    out("    for (int i = 0; i < %d; i++) {\n", num_travs);
+    out("        for (int j = 0; j < %d; j++) {\n", num_types);
+    out("            if (profile_visits[i][j] == 0) continue;\n");
+    out("            entries[num_entries].trav = i;\n");
+    out("            entries[num_entries].type = j;\n");
+    out("            num_entries++;\n");
+    out("        }\n");
+    out("    }\n");
+    out("    qsort(entries, num_entries, sizeof(ProfileEntry), "
+        "profile_compare);\n\n");
+
+    out("    FILE *fp = stderr;\n");
+    out("    if (csv_fn != NULL) {\n");
+    out("        fp = fopen(csv_fn, \"w\");\n");
+    out("        if (fp == NULL) {\n");
+    out("            print_user_error(\"traversal-profile\", \"Cannot open "
+        "%%s.\", csv_fn);\n");
+    out("            return;\n");
+    out("        }\n");
+    out("        fprintf(fp, \"traversal,node,visits,cycles\\n\");\n");
+    out("    } else {\n");
+    out("        fprintf(fp, \"%%-24s %%-24s %%12s %%16s\\n\", "
+        "\"traversal\", \"node\", \"visits\", \"cycles\");\n");
+    out("    }\n\n");
+
+    out("    for (int i = 0; i < num_entries; i++) {\n");
+    out("        int t = entries[i].trav, n = entries[i].type;\n");
+    out("        fprintf(fp, csv_fn != NULL ? \"%%s,%%s,%%llu,%%llu\\n\" "
+        ": \"%%-24s %%-24s %%12llu %%16llu\\n\",\n");
+    out("                profile_trav_names[t], profile_node_names[n],\n");
+    out("                (unsigned long long)profile_visits[t][n],\n");
+    out("                (unsigned long long)profile_cycles[t][n]);\n");
+    out("    }\n\n");
+    out("    if (csv_fn != NULL)\n");
+    out("        fclose(fp);\n");
+    out("}\n");
+    out("#endif\n");
+}
+
+// Hints for the dispatch ordered on the visit counts of a profile run.
+static void generate_layout_macros(FILE *fp) {
+    out("\n#if defined(__GNUC__)\n");
+    out("#define " EXPECT_MACRO "(x, v) __builtin_expect((x), (v))\n");
+    out("#define " HOT_MACRO " __attribute__((hot))\n");
+    out("#define " COLD_MACRO " __attribute__((cold))\n");
+    out("#else\n");
+    out("#define " EXPECT_MACRO "(x, v) (x)\n");
+    out("#define " HOT_MACRO "\n");
+    out("#define " COLD_MACRO "\n");
+    out("#endif\n\n");
+
+    // Only GCC supports the cold attribute on labels.
+    out("#if defined(__GNUC__) && !defined(__clang__)\n");
+    out("#define " COLD_LABEL_MACRO " __attribute__((cold, unused))\n");
+    out("#elif defined(__GNUC__)\n");
+    out("#define " COLD_LABEL_MACRO " __attribute__((unused))\n");
+    out("#else\n");
+    out("#define " COLD_LABEL_MACRO "\n");
+    out("#endif\n\n");
 }
 
 void generate_trav_core_header(Config *config, FILE *fp) {
+    char *tl = out_thread_local(config);
+
     out("#pragma once\n");
 
+    out("#include <stdbool.h>\n");
     out("#include \"generated/enum.h\"\n");
-    for (int i = 0; i < array_size(config->traversals); i++) {
-        Traversal *t = array_get(config->traversals, i);
-        out("#include \"generated/traversal-%s.h\"\n", t->id);
-    }
+    out("#include \"generated/reach.h\"\n");
 
     out("// Stack of traversals, so that new traversals can be started "
         "inside other traversals. \n");
-    out(NT_ENUM_NAME " node_replacement_type;\n");
-    out("void *node_replacement;\n");
+    out("extern %s" NT_ENUM_NAME " node_replacement_type;\n", tl);
+    out("extern %svoid *node_replacement;\n", tl);
+    out("// Handlers of the current traversal return the replacement node.\n");
+    out("extern %sbool node_replacement_returned;\n", tl);
+    out("// Handlers of the current traversal do not replace nodes.\n");
+    out("extern %sbool " TRAV_PREFIX "readonly;\n", tl);
+    out("// Number of changes to the tree, counted when there are cycle "
+        "phases.\n");
+    out("extern %sunsigned long " TRAV_PREFIX "changes;\n\n", tl);
+
+    out("typedef enum {\n");
+    out("    " TC_ENUM_PREFIX "continue,\n");
+    out("    " TC_ENUM_PREFIX "skip_children,\n");
+    out("    " TC_ENUM_PREFIX "abort,\n");
+    out("} " TC_ENUM_NAME ";\n");
+    out("// Checked by every child edge, set through " TRAV_PREFIX "abort and "
+        TRAV_PREFIX "skip_children.\n");
+    out("extern %s" TC_ENUM_NAME " " TRAV_PREFIX "control;\n", tl);
+    out("// Types of the nodes a scoped traversal enters, NULL for all "
+        "nodes.\n");
+    out("extern %sconst TypeMask *" TRAV_PREFIX "scope;\n", tl);
+
+    if (config->profile != NULL)
+        generate_layout_macros(fp);
 
-    generate_stack_functions(fp, true);
+    generate_stack_functions(config, fp, true);
+    generate_profile_functions(config, fp, true);
+
+    // Included last, the node headers they pull in can define inline child
+    // edges that use the declarations above.
+    for (int i = 0; i < array_size(config->traversals); i++) {
+        Traversal *t = array_get(config->traversals, i);
+        out("#include \"generated/traversal-%s.h\"\n", t->id);
+    }
 }
 
 void generate_trav_core_definitions(Config *config, FILE *fp) {
+    char *tl = out_thread_local(config);
+
     out("#include <stdio.h>\n");
     out("#include \"generated/enum.h\"\n");
     out("#include \"generated/trav-core.h\"\n");
@@ -79,11 +464,19 @@ void generate_trav_core_definitions(Config *config, FILE *fp) {
     out("#include \"lib/print.h\"\n");
     out("// Stack of traversals, so that new traversals can be started "
         "inside other traversals. \n");
-    out("static struct TravStack *current_traversal;\n");
+    out("static %sstruct TravStack *current_traversal;\n", tl);
 
     out("// Replacement node holder\n");
-    out(NT_ENUM_NAME " node_replacement_type;\n");
-    out("void *node_replacement;\n");
+    out("%s" NT_ENUM_NAME " node_replacement_type;\n", tl);
+    out("%svoid *node_replacement;\n", tl);
+    out("%sbool node_replacement_returned;\n", tl);
+    out("%sbool " TRAV_PREFIX "readonly;\n", tl);
+    out("%sunsigned long " TRAV_PREFIX "changes;\n\n", tl);
+    out("%s" TC_ENUM_NAME " " TRAV_PREFIX "control;\n", tl);
+    out("%sconst TypeMask *" TRAV_PREFIX "scope;\n\n", tl);
 
-    generate_stack_functions(fp, false);
+    generate_rewrite_table(config, fp);
+    generate_readonly_table(config, fp);
+    generate_stack_functions(config, fp, false);
+    generate_profile_functions(config, fp, false);
 }
@@ -1,6 +1,7 @@
 #include "cocogen/ast.h"
 #include "cocogen/filegen-driver.h"
 #include "cocogen/filegen-util.h"
+#include "cocogen/profile-ast.h"
 #include "cocogen/str-ast.h"
 #include "lib/imap.h"
 #include "lib/memory.h"
@@ -8,6 +9,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 // Map from node name to index in reachability matrix
@@ -20,6 +22,17 @@ static bool **traversal_node_handles = NULL;
 
 #define ERROR_HEADER "traversal-driver"
 
+static int traversal_index(Config *config, Traversal *trav) {
+    for (int i = 0; i < array_size(config->traversals); i++) {
+        if (array_get(config->traversals, i) == trav)
+            return i;
+    }
+
+    // Members of a fusion are always part of the config.
+    assert(0);
+    return -1;
+}
+
 static void compute_reachable_nodes(Config *config) {
     if (node_reachability && traversal_node_handles) {
         return;
@@ -92,8 +105,10 @@ static void compute_reachable_nodes(Config *config) {
     // Fill traversal_node_handles table
 
     size_t num_traversals = array_size(config->traversals);
+    size_t num_fusions = array_size(config->fusions);
 
-    traversal_node_handles = mem_alloc(sizeof(bool *) * num_traversals);
+    traversal_node_handles =
+        mem_alloc(sizeof(bool *) * (num_traversals + num_fusions));
 
     for (int i = 0; i < num_traversals; i++) {
         Traversal *traversal = array_get(config->traversals, i);
@@ -127,68 +142,389 @@ static void compute_reachable_nodes(Config *config) {
             }
         }
     }
+
+    // A fused traversal needs to visit the nodes of all its members, which
+    // are stored after the traversals in the table.
+    for (int i = 0; i < num_fusions; i++) {
+        Fusion *fusion = array_get(config->fusions, i);
+        bool *handles = mem_alloc(sizeof(bool) * num_total);
+        memset(handles, 0, sizeof(bool) * num_total);
+
+        for (int j = 0; j < array_size(fusion->traversals); j++) {
+            bool *member_handles = traversal_node_handles[traversal_index(
+                config, array_get(fusion->traversals, j))];
+
+            for (int k = 0; k < num_total; k++) {
+                if (member_handles[k])
+                    handles[k] = true;
+            }
+        }
+
+        traversal_node_handles[num_traversals + i] = handles;
+    }
+}
+
+// True if a node or nodeset of type 'to' can occur below a node or nodeset
+// of type 'from'.
+bool node_reachable(Config *config, char *from, char *to) {
+    compute_reachable_nodes(config);
+
+    int *from_index = smap_retrieve(node_index, from);
+    int *to_index = smap_retrieve(node_index, to);
+    return node_reachability[*to_index][*from_index];
+}
+
+static bool traversal_handles_node(Traversal *t, Node *node) {
+    if (t->nodes == NULL)
+        return true;
+
+    for (int i = 0; i < array_size(t->nodes); i++) {
+        char *node_name = array_get(t->nodes, i);
+        if (strcmp(node->id, node_name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Kinds of traversals with their own child edges. The kind of the current
+// traversal is known in its case of the dispatch in _trav_<Node>, so the
+// edge is picked when the dispatch is generated.
+typedef enum EdgeKind {
+    EDGE_REPLACE,
+    EDGE_READONLY,
+    EDGE_REWRITE,
+} EdgeKind;
+
+static char *edge_kind_names[] = {"replace", "readonly", "rewrite"};
+
+static bool config_has_edge_kind(Config *config, EdgeKind kind) {
+    for (int i = 0; i < array_size(config->traversals); i++) {
+        Traversal *t = array_get(config->traversals, i);
+        if ((kind == EDGE_READONLY && t->readonly) ||
+            (kind == EDGE_REWRITE && t->rewrite))
+            return true;
+    }
+    return kind == EDGE_REPLACE;
+}
+
+// Without readonly and rewrite traversals, the public child edge is the
+// only edge and has the body of a normal traversal.
+static bool separate_edges(Config *config) {
+    return config_has_edge_kind(config, EDGE_READONLY) ||
+           config_has_edge_kind(config, EDGE_REWRITE);
+}
+
+static EdgeKind traversal_edge_kind(Traversal *t) {
+    if (t->rewrite)
+        return EDGE_REWRITE;
+    return t->readonly ? EDGE_READONLY : EDGE_REPLACE;
 }
 
-static void generate_replace_node(Node *node, FILE *fp, bool header) {
+// A fusion is readonly if all its members are, and never has rewrite
+// members.
+static EdgeKind fusion_edge_kind(Fusion *f) {
+    for (int i = 0; i < array_size(f->traversals); i++) {
+        Traversal *t = array_get(f->traversals, i);
+        if (!t->readonly)
+            return EDGE_REPLACE;
+    }
+    return EDGE_READONLY;
+}
+
+// A case of the dispatch on the current traversal or on the type of a
+// nodeset child, with its visits in a profile run, or -1 without a profile.
+typedef struct DispatchCase {
+    int index;
+    long visits;
+} DispatchCase;
+
+static int compare_cases(const void *a, const void *b) {
+    const DispatchCase *c1 = a, *c2 = b;
+
+    if (c1->visits != c2->visits)
+        return c1->visits < c2->visits ? 1 : -1;
+    return c1->index - c2->index;
+}
+
+// Order the cases hottest first, keeping the order of the ast file for equal
+// visits. Returns the index of the case taken in more than half of the
+// visits, or -1 if there is no such case.
+static int order_cases(DispatchCase *cases, int num_cases) {
+    long total = 0;
+
+    for (int i = 0; i < num_cases; i++) {
+        if (cases[i].visits > 0)
+            total += cases[i].visits;
+    }
+
+    qsort(cases, num_cases, sizeof(DispatchCase), compare_cases);
+
+    if (num_cases > 0 && total > 0 && cases[0].visits > total / 2)
+        return cases[0].index;
+    return -1;
+}
+
+// Mark a case which was never taken in the profile run as cold. The suffix
+// keeps the labels of two dispatches in one function apart.
+static void out_cold_label(FILE *fp, char *indent, char *id, char *suffix,
+                           long visits) {
+    if (visits == 0)
+        out("%scold_%s%s: " COLD_LABEL_MACRO ";\n", indent, id, suffix);
+}
+
+// Functions of nodes which were visited in the profile run are grouped
+// together, those of nodes which were not are moved out of the way.
+static void out_layout_attribute(Config *config, FILE *fp, long visits) {
+    if (config->profile != NULL)
+        out("%s ", visits > 0 ? HOT_MACRO : COLD_MACRO);
+}
+
+static void generate_replace_node_body(Config *config, Node *node,
+                                       FILE *fp) {
+    out(" {\n");
+    if (config_has_edge_kind(config, EDGE_READONLY)) {
+        out("    if (" TRAV_PREFIX "readonly) {\n");
+        out("        print_user_error(\"" ERROR_HEADER "\", \""
+            REPLACE_NODE_FORMAT
+            ": Cannot replace a node in a readonly traversal.\");\n",
+            node->id);
+        out("        return;\n");
+        out("    }\n");
+    }
+    out("    if (node_replacement == NULL) {\n");
+    out("        node_replacement_type = " NT_FORMAT ";\n", node->id);
+    out("        node_replacement = node;\n");
+    out_count_change(config, fp, "        ");
+    out("    } else {\n");
+    out("        print_user_error(\"" ERROR_HEADER "\", \"" REPLACE_NODE_FORMAT
+        ": "
+        "Not making a node replacement, since another replacement "
+        "function "
+        "was already called previously.\");\n",
+        node->id);
+    out("    }\n");
+    out("}\n");
+}
+
+static bool inline_replace_node(Config *config, Node *node) {
+    FILE *measure = out_measure_start();
+    generate_replace_node_body(config, node, measure);
+    return out_inline(config, out_measure_end(measure));
+}
+
+static void generate_replace_node(Config *config, Node *node, FILE *fp,
+                                  bool header) {
+    bool inline_body = inline_replace_node(config, node);
+
+    // Inlined functions are defined in the header only.
+    if (inline_body && !header)
+        return;
+
     // Generate replace functions
-    out("void " REPLACE_NODE_FORMAT "(struct %s *node)", node->id, node->id);
-    if (header) {
+    out("%svoid " REPLACE_NODE_FORMAT "(struct %s *node)",
+        inline_body ? "static inline " : "", node->id, node->id);
+    if (header && !inline_body) {
         out(";\n");
     } else {
-        out(" {\n");
-        out("    if (node_replacement == NULL) {\n");
-        out("        node_replacement_type = " NT_FORMAT ";\n", node->id);
-        out("        node_replacement = node;\n");
-        out("    } else {\n");
-        out("        print_user_error(\"" ERROR_HEADER
-            "\", \"" REPLACE_NODE_FORMAT ": "
-            "Not making a node replacement, since another replacement "
-            "function "
-            "was already called previously.\");\n",
-            node->id);
+        generate_replace_node_body(config, node, fp);
+    }
+}
+
+// Start a traversal which only enters the nodes with a type in 'scope', or
+// all nodes if it is NULL.
+static void generate_start_node_scope(Config *config, FILE *fp, Node *node) {
+    out("static struct %s *start_%s(struct %s *node, TraversalType trav,\n",
+        node->id, node->id, node->id);
+    out("                            const TypeMask *scope) {\n");
+    out("    // Inside of the struct Info* is unknown, thus hide "
+        "under void.\n");
+    out("    void* info;\n");
+    out("\n");
+    out("    // Set the new traversal as current traversal.\n");
+    out("    " TRAV_PREFIX "push(trav);\n");
+    out("    " TRAV_PREFIX "scope = scope;\n");
+    out("\n");
+    out("    switch(trav) {\n");
+    for (int j = 0; j < array_size(config->traversals); ++j) {
+        Traversal *trav = (Traversal *)array_get(config->traversals, j);
+        out("    case " TRAV_FORMAT ":\n", trav->id);
+        if (trav->incremental)
+            out("        " TRAV_PREFIX "set_since(" INCREMENTAL_PREFIX
+                "begin(%s, " TRAV_FORMAT "));\n",
+                node == config->root_node ? "node->_last_run" : "NULL",
+                trav->id);
+        out("        info = %s_createinfo();\n", trav->id);
+        out("        node = _" TRAV_PREFIX "%s(node, info);\n", node->id);
+        out("        %s_freeinfo(info);\n", trav->id);
+        out("        break;\n");
+    }
+    for (int j = 0; j < array_size(config->fusions); ++j) {
+        Fusion *fusion = array_get(config->fusions, j);
+        int num_members = array_size(fusion->traversals);
+
+        out("    case " TRAV_FORMAT ": {\n", fusion->id);
+        out("        void *infos[%d];\n", num_members);
+        for (int k = 0; k < num_members; k++) {
+            Traversal *trav = array_get(fusion->traversals, k);
+            out("        infos[%d] = %s_createinfo();\n", k, trav->id);
+        }
+        out("        " TRAV_PREFIX "fuse(infos);\n");
+        out("        _" TRAV_PREFIX "%s(node, NULL);\n", node->id);
+        for (int k = 0; k < num_members; k++) {
+            Traversal *trav = array_get(fusion->traversals, k);
+            out("        %s_freeinfo(infos[%d]);\n", trav->id, k);
+        }
+        out("        break;\n");
         out("    }\n");
-        out("}\n");
     }
+    out("    }\n");
+    out("    " TRAV_PREFIX "pop();\n");
+    out("    return node;\n");
+    out("}\n\n");
 }
 
 static void generate_start_node(Config *config, FILE *fp, bool header,
                                 Node *node) {
     // Generate start functions
-    out("void " TRAV_START_FORMAT "(struct %s *node, TraversalType trav)",
-        node->id, node->id);
+    out("struct %s *" TRAV_START_FORMAT
+        "(struct %s *node, TraversalType trav)",
+        node->id, node->id, node->id);
     if (header) {
         out(";\n");
     } else {
         out(" {\n");
-        out("    // Inside of the struct Info* is unknown, thus hide "
-            "under void.\n");
-        out("    void* info;\n");
-        out("\n");
-        out("    // Set the new traversal as current traversal.\n");
-        out("    " TRAV_PREFIX "push(trav);\n");
-        out("\n");
-        out("    switch(trav) {\n");
-        for (int j = 0; j < array_size(config->traversals); ++j) {
-            Traversal *trav = (Traversal *)array_get(config->traversals, j);
-            out("    case " TRAV_FORMAT ":\n", trav->id);
-            out("        info = %s_createinfo();\n", trav->id);
-            out("        _" TRAV_PREFIX "%s(node, info);\n", node->id);
-            out("        %s_freeinfo(info);\n", trav->id);
-            out("        break;\n");
-        }
-        out("    }\n");
-        out("    " TRAV_PREFIX "pop();\n");
+        out("    return start_%s(node, trav, NULL);\n", node->id);
+        out("}\n\n");
+    }
+
+    // Only nodes from which a node with a type in 'types' can be reached are
+    // visited.
+    out("struct %s *" TRAV_START_SCOPED_FORMAT
+        "(struct %s *node, TraversalType trav,\n",
+        node->id, node->id, node->id);
+    out("                             const TypeMask *types)");
+    if (header) {
+        out(";\n");
+        return;
+    }
+
+    // Only the dispatch of scoped traversals checks the scope.
+    out(" {\n");
+    bool scoped = false;
+    for (int j = 0; j < array_size(config->traversals); ++j) {
+        Traversal *trav = array_get(config->traversals, j);
+        if (!trav->scoped)
+            continue;
+        if (!scoped)
+            out("    switch (trav) {\n");
+        out("    case " TRAV_FORMAT ":\n", trav->id);
+        scoped = true;
+    }
+    if (scoped) {
+        out("        break;\n");
+        out("    default:\n");
+    }
+    out("%s    print_user_error(\"" ERROR_HEADER "\", \""
+        TRAV_START_SCOPED_FORMAT ": Traversal is not scoped.\");\n",
+        scoped ? "    " : "", node->id);
+    out("%s    return node;\n", scoped ? "    " : "");
+    if (!scoped) {
         out("}\n");
+        return;
+    }
+    out("    }\n\n");
+    out("    TypeMask scope;\n");
+    out("    " REACH_PREFIX "scope(&scope, types);\n");
+    out("    return start_%s(node, trav, &scope);\n", node->id);
+    out("}\n");
+}
+
+// The replacement node gets a new parent, and both count as changed.
+static void generate_mark_replacement(Config *config, Node *node,
+                                      Child *child, FILE *fp, char *indent,
+                                      char *var) {
+    if (config->parents)
+        out("%s" PARENT_PREFIX "set(%s, node, " CS_FORMAT ");\n", indent, var,
+            node->id, child->id);
+    if (config->incremental) {
+        out("%s" INCREMENTAL_PREFIX "mark(%s);\n", indent, var);
+        out("%s" INCREMENTAL_PREFIX "mark(node);\n", indent);
     }
 }
 
-static void generate_node_child_node(Node *node, Child *child, FILE *fp) {
-    out("    _" TRAV_PREFIX "%s(node->%s, info);\n", child->type, child->id);
+// Index of the node in the child in the census, stored before its handler
+// runs. The handler may free the node, which removes it from the census.
+static void generate_census_capture(Config *config, Child *child, FILE *fp) {
+    if (!config->census)
+        return;
+
+    if (child->node != NULL) {
+        out("    int replaced_census = node->%s != NULL ? node->%s->_census "
+            ": -1;\n",
+            child->id, child->id);
+        return;
+    }
+
+    Nodeset *nodeset = child->nodeset;
+    Node *first = array_get(nodeset->nodes, 0);
+    out("    int replaced_census = -1;\n");
+    out("    " NT_ENUM_NAME " replaced_type = " NT_FORMAT ";\n", first->id);
+    out("    switch (node->%s->type) {\n", child->id);
+    for (int i = 0; i < array_size(nodeset->nodes); i++) {
+        Node *cnode = array_get(nodeset->nodes, i);
+        out("    case " NS_FORMAT ":\n", nodeset->id, cnode->id);
+        out("        replaced_type = " NT_FORMAT ";\n", cnode->id);
+        out("        if (node->%s->value.val_%s != NULL)\n", child->id,
+            cnode->id);
+        out("            replaced_census = node->%s->value.val_%s->_census;\n",
+            child->id, cnode->id);
+        out("        break;\n");
+    }
+    out("    }\n\n");
+}
 
-    out("    if (node_replacement != NULL) {\n");
+// The node in 'var' is replaced in the child by the node of type 'new_type'
+// in 'new_var', and leaves the census. A rollback of the journal puts it
+// back, and takes out the replacement.
+static void generate_census_detach(Config *config, Child *child, FILE *fp,
+                                   char *indent, char *var, char *new_type,
+                                   char *new_var) {
+    if (!config->census)
+        return;
+
+    if (child->node != NULL)
+        out("%s" CENSUS_PREFIX "detach(" NT_FORMAT ", %s, replaced_census);\n",
+            indent, child->type, var);
+    else
+        out("%s" CENSUS_PREFIX "detach(replaced_type, %s, "
+            "replaced_census);\n",
+            indent, var);
+    if (config->journal)
+        out("%s" TX_PREFIX "log_census(" NT_FORMAT ", %s, false);\n", indent,
+            new_type, new_var);
+}
+
+// Store the node passed to replace_<Node> in a node child. In a rewrite
+// traversal, a replacement that was pending before the child was traversed
+// belongs to an ancestor, so only a new one is stored, and then consumed.
+static void generate_node_child_replacement(Config *config, Node *node,
+                                           Child *child, FILE *fp,
+                                           bool returned) {
+    out("    if (node_replacement != %s) {\n", returned ? "pending" : "NULL");
     out("        if (node_replacement_type == " NT_FORMAT ") {\n",
         child->type);
+    out_journal(config, fp, "            ", "node", child->id);
+    if (config->census) {
+        char *old = out_format("node->%s", child->id);
+        out("            if (%s != node_replacement) {\n", old);
+        generate_census_detach(config, child, fp, "                ", old,
+                               child->type, "node_replacement");
+        out("            }\n");
+        mem_free(old);
+    }
     out("            node->%s = node_replacement;\n", child->id);
+    generate_mark_replacement(config, node, child, fp, "            ",
+                              "node_replacement");
     out("        } else {\n");
     out("            print_user_error(\"" ERROR_HEADER
         "\",  \"Replacement node for %s->%s is not of "
@@ -196,35 +532,73 @@ static void generate_node_child_node(Node *node, Child *child, FILE *fp) {
         "%s.\");\n",
         node->id, child->id, child->type);
     out("        }\n");
+    if (returned)
+        out("        node_replacement = NULL;\n");
     out("    }\n");
 }
 
-static void generate_node_child_nodeset(Node *node, Child *child, FILE *fp) {
-    out("    if (!node->%s) return;\n", child->id);
-    out("    switch (node->%s->type) {\n", child->id);
-
-    Nodeset *nodeset = child->nodeset;
+static void generate_node_child_node(Config *config, Node *node,
+                                     Child *child, FILE *fp) {
+    out("    _" TRAV_PREFIX "%s(node->%s, info);\n", child->type, child->id);
+    generate_node_child_replacement(config, node, child, fp, false);
+}
 
-    for (int i = 0; i < array_size(nodeset->nodes); ++i) {
-        Node *cnode = (Node *)array_get(nodeset->nodes, i);
-        out("    case " NS_FORMAT ":\n", nodeset->id, cnode->id);
-        out("        _" TRAV_PREFIX "%s(node->%s->value.val_%s, info);\n",
-            cnode->id, child->id, cnode->id);
-        out("        break;\n");
+// The handler returned the node to store, which has the type of the child.
+static void generate_node_child_node_returned(Config *config, Node *node,
+                                              Child *child, FILE *fp) {
+    out("    struct %s *res = _" TRAV_PREFIX "%s(node->%s, info);\n",
+        child->type, child->type, child->id);
+    if (config->parents || config->journal || config->cycles ||
+        config->census) {
+        char *old = out_format("node->%s", child->id);
+        out("    if (res != %s) {\n", old);
+        out_journal(config, fp, "        ", "node", child->id);
+        out_count_change(config, fp, "        ");
+        generate_census_detach(config, child, fp, "        ", old,
+                               child->type, "res");
+        mem_free(old);
+        generate_mark_replacement(config, node, child, fp, "        ", "res");
+        out("    }\n");
     }
+    out("    node->%s = res;\n", child->id);
+}
 
-    out("    }\n\n");
+// Store the node passed to replace_<Node> in a nodeset child, which can
+// change the type of the child. As for a node child, a rewrite traversal
+// only stores and consumes a new replacement.
+static void generate_nodeset_child_replacement(Config *config, Node *node,
+                                               Child *child, FILE *fp,
+                                               bool returned) {
+    Nodeset *nodeset = child->nodeset;
+    char *value = out_format("%s->value", child->id);
+    char *type = out_format("%s->type", child->id);
+
+    // All members of the nodeset union are node pointers, so the replaced
+    // node can be read through any of them.
+    Node *first = array_get(nodeset->nodes, 0);
+    char *old = out_format("node->%s->value.val_%s", child->id, first->id);
 
-    out("    if (node_replacement != NULL) {\n");
+    out("    if (node_replacement != %s) {\n", returned ? "pending" : "NULL");
 
     out("        switch (node_replacement_type) {\n");
     for (int i = 0; i < array_size(nodeset->nodes); ++i) {
         Node *cnode = (Node *)array_get(nodeset->nodes, i);
         out("        case " NT_FORMAT ":\n", cnode->id);
+        out_journal(config, fp, "            ", "node", value);
+        out_journal(config, fp, "            ", "node", type);
+        if (config->census) {
+            out("            if ((void *)%s != node_replacement) {\n",
+                old);
+            generate_census_detach(config, child, fp, "                ",
+                                   old, cnode->id, "node_replacement");
+            out("            }\n");
+        }
         out("            node->%s->value.val_%s = node_replacement;\n",
             child->id, cnode->id);
         out("            node->%s->type = " NS_FORMAT ";\n", child->id,
             child->type, cnode->id);
+        generate_mark_replacement(config, node, child, fp, "            ",
+                                  "node_replacement");
         out("            break;\n");
     }
 
@@ -235,89 +609,442 @@ static void generate_node_child_nodeset(Node *node, Child *child, FILE *fp) {
         node->id, child->id, child->type);
     out("            break;\n");
     out("        }\n");
-
+    if (returned)
+        out("        node_replacement = NULL;\n");
     out("    }\n");
+
+    mem_free(old);
+    mem_free(value);
+    mem_free(type);
 }
 
-static void generate_trav_node(Node *node, FILE *fp, Config *config,
-                               bool header) {
+static void generate_node_child_nodeset(Config *config, Node *node,
+                                        Child *child, FILE *fp,
+                                        bool returned) {
+    Nodeset *nodeset = child->nodeset;
+    char *value = out_format("%s->value", child->id);
+    int num_cases = array_size(nodeset->nodes);
+    DispatchCase *cases = mem_alloc(sizeof(DispatchCase) * num_cases);
+
+    for (int i = 0; i < num_cases; i++) {
+        Node *cnode = array_get(nodeset->nodes, i);
+        cases[i].index = i;
+        cases[i].visits = profile_node_visits(config, cnode->id);
+    }
+    int likely = order_cases(cases, num_cases);
 
-    if (!header) {
-        out("void _" TRAV_PREFIX "%s(struct %s *node, struct Info *info) {\n",
-            node->id, node->id);
-        out("   if (!node) return;\n");
-        out("   switch (" TRAV_PREFIX "current()) {\n");
-        for (int i = 0; i < array_size(config->traversals); i++) {
-            Traversal *t = array_get(config->traversals, i);
-
-            bool handles_node = t->nodes == NULL;
-            for (int j = 0; j < array_size(t->nodes); j++) {
-                char *node_name = array_get(t->nodes, j);
-                if (strcmp(node->id, node_name) == 0) {
-                    handles_node = true;
-                    break;
-                }
+    if (likely >= 0) {
+        Node *cnode = array_get(nodeset->nodes, likely);
+        out("    switch (" EXPECT_MACRO "(node->%s->type, " NS_FORMAT ")) {\n",
+            child->id, nodeset->id, cnode->id);
+    } else {
+        out("    switch (node->%s->type) {\n", child->id);
+    }
+
+    for (int i = 0; i < num_cases; ++i) {
+        Node *cnode = (Node *)array_get(nodeset->nodes, cases[i].index);
+        out("    case " NS_FORMAT ": {\n", nodeset->id, cnode->id);
+        out_cold_label(fp, "    ", cnode->id, returned ? "_returned" : "",
+                       cases[i].visits);
+        if (returned) {
+            out("        struct %s *res = _" TRAV_PREFIX
+                "%s(node->%s->value.val_%s, info);\n",
+                cnode->id, cnode->id, child->id, cnode->id);
+            if (config->parents || config->journal || config->cycles ||
+                config->census) {
+                char *old =
+                    out_format("node->%s->value.val_%s", child->id, cnode->id);
+                out("        if (res != %s) {\n", old);
+                out_journal(config, fp, "            ", "node", value);
+                out_count_change(config, fp, "            ");
+                generate_census_detach(config, child, fp, "            ", old,
+                                       cnode->id, "res");
+                mem_free(old);
+                generate_mark_replacement(config, node, child, fp,
+                                          "            ", "res");
+                out("        }\n");
             }
+            out("        node->%s->value.val_%s = res;\n", child->id,
+                cnode->id);
+        } else {
+            out("        _" TRAV_PREFIX "%s(node->%s->value.val_%s, info);\n",
+                cnode->id, child->id, cnode->id);
+        }
+        out("        break;\n");
+        out("    }\n");
+    }
+    mem_free(cases);
+    mem_free(value);
 
-            out("   case " TRAV_FORMAT ":\n", t->id);
+    out("    }\n\n");
 
-            if (handles_node) {
-                out("       " TRAVERSAL_HANDLER_FORMAT "(node, info);\n",
-                    t->id, node->id);
-            } else {
+    generate_nodeset_child_replacement(config, node, child, fp, returned);
+}
 
-                for (int j = 0; j < array_size(node->children); j++) {
-                    Child *c = array_get(node->children, j);
+// An aborted traversal, or one that skips the children, enters no more
+// children.
+static void generate_trav_child_checks(Child *child, FILE *fp) {
+    out("    if (!node || " TRAV_PREFIX "control != " TC_ENUM_PREFIX
+        "continue) return;\n");
+    if (child->nodeset != NULL)
+        out("    if (!node->%s) return;\n", child->id);
+}
 
-                    int *index = smap_retrieve(node_index, c->type);
-                    bool handles_child = traversal_node_handles[i][*index];
+// Child edge of a normal traversal, which stores the node passed to
+// replace_<Node> in the child.
+static void generate_trav_child_replace(Config *config, Node *node,
+                                        Child *child, FILE *fp) {
+    generate_census_capture(config, child, fp);
+
+    out("    void *orig_node_replacement = node_replacement;\n");
+    out("    node_replacement = NULL;\n");
+
+    if (child->node != NULL) {
+        // Child is a node
+        generate_node_child_node(config, node, child, fp);
+    } else if (child->nodeset != NULL) {
+        // Child is a nodeset
+        generate_node_child_nodeset(config, node, child, fp, false);
+    } else {
+        // Should not have passed the context analysis.
+        assert(0);
+    }
+    out("    node_replacement = orig_node_replacement;\n");
+}
 
-                    if (handles_child)
-                        out("       " TRAV_PREFIX "%s_%s(node, info);\n",
-                            node->id, c->id);
-                }
-            }
-            out("       break;\n");
+// Child edge of a rewrite traversal, which stores the node returned by the
+// handler. A replace_<Node> call in the handlers of the child is still
+// honoured. node_replacement is only read, unless such a call was made.
+static void generate_trav_child_returned(Config *config, Node *node,
+                                         Child *child, FILE *fp) {
+    generate_census_capture(config, child, fp);
+    out("    void *pending = node_replacement;\n");
+    if (child->node != NULL) {
+        generate_node_child_node_returned(config, node, child, fp);
+        generate_node_child_replacement(config, node, child, fp, true);
+    } else {
+        generate_node_child_nodeset(config, node, child, fp, true);
+    }
+}
+
+// Child edge of a readonly traversal, which never has a replacement to
+// store.
+static void generate_trav_child_readonly(Child *child, FILE *fp) {
+    if (child->node != NULL) {
+        out("    _" TRAV_PREFIX "%s(node->%s, info);\n", child->type,
+            child->id);
+        return;
+    }
+
+    Nodeset *nodeset = child->nodeset;
+    out("    switch (node->%s->type) {\n", child->id);
+    for (int i = 0; i < array_size(nodeset->nodes); i++) {
+        Node *cnode = array_get(nodeset->nodes, i);
+        out("    case " NS_FORMAT ":\n", nodeset->id, cnode->id);
+        out("        _" TRAV_PREFIX "%s(node->%s->value.val_%s, info);\n",
+            cnode->id, child->id, cnode->id);
+        out("        break;\n");
+    }
+    out("    }\n");
+}
+
+static void generate_trav_child_kind(Config *config, Node *node,
+                                     Child *child, FILE *fp, EdgeKind kind) {
+    out(" {\n");
+    generate_trav_child_checks(child, fp);
+    switch (kind) {
+    case EDGE_REPLACE:
+        generate_trav_child_replace(config, node, child, fp);
+        break;
+    case EDGE_READONLY:
+        generate_trav_child_readonly(child, fp);
+        break;
+    case EDGE_REWRITE:
+        generate_trav_child_returned(config, node, child, fp);
+        break;
+    }
+    out("}\n\n");
+}
+
+// The public child edge, called by the handlers and by traversals that are
+// not known when the dispatch is generated. It picks the edge of the kind of
+// the current traversal from the kinds in the ast file.
+static void generate_trav_child_body(Config *config, Node *node,
+                                     Child *child, FILE *fp) {
+    if (!separate_edges(config)) {
+        generate_trav_child_kind(config, node, child, fp, EDGE_REPLACE);
+        return;
+    }
+
+    out(" {\n");
+    char *branch = "if";
+    if (config_has_edge_kind(config, EDGE_READONLY)) {
+        out("    %s (" TRAV_PREFIX "readonly)\n", branch);
+        out("        " TRAV_EDGE_FORMAT "(node, info);\n", node->id,
+            child->id, edge_kind_names[EDGE_READONLY]);
+        branch = "else if";
+    }
+    if (config_has_edge_kind(config, EDGE_REWRITE)) {
+        out("    %s (node_replacement_returned)\n", branch);
+        out("        " TRAV_EDGE_FORMAT "(node, info);\n", node->id,
+            child->id, edge_kind_names[EDGE_REWRITE]);
+    }
+    out("    else\n");
+    out("        " TRAV_EDGE_FORMAT "(node, info);\n", node->id, child->id,
+        edge_kind_names[EDGE_REPLACE]);
+    out("}\n\n");
+}
+
+// The edges of the kinds of traversals in the ast file, called directly from
+// the cases of _trav_<Node>.
+static void generate_trav_child_kinds(Config *config, Node *node,
+                                      Child *child, FILE *fp,
+                                      bool inline_body) {
+    if (!separate_edges(config))
+        return;
+
+    for (EdgeKind kind = EDGE_REPLACE; kind <= EDGE_REWRITE; kind++) {
+        if (!config_has_edge_kind(config, kind))
+            continue;
+
+        if (inline_body) {
+            out("static inline ");
+        } else {
+            out("static ");
+            out_layout_attribute(config, fp,
+                                 profile_node_visits(config, node->id));
         }
+        out("void " TRAV_EDGE_FORMAT "(struct %s *node, struct Info *info)",
+            node->id, child->id, edge_kind_names[kind], node->id);
+        generate_trav_child_kind(config, node, child, fp, kind);
+    }
+}
 
-        out("   default:\n");
-        for (int i = 0; i < array_size(node->children); i++) {
-            Child *c = array_get(node->children, i);
-            out("       " TRAV_PREFIX "%s_%s(node, info);\n", node->id, c->id);
+// Skipping the children only applies to the node whose handler asked for it.
+static void generate_end_skip_children(FILE *fp) {
+    out("       if (" TRAV_PREFIX "control == " TC_ENUM_PREFIX
+        "skip_children)\n");
+    out("           " TRAV_PREFIX "control = " TC_ENUM_PREFIX "continue;\n");
+}
+
+// Traverse the children from which nodes handled by the traversal, or fused
+// traversal, at row trav_index of traversal_node_handles can be reached,
+// through the edges of its kind.
+static void generate_trav_node_children(Config *config, Node *node,
+                                        int trav_index, EdgeKind kind,
+                                        FILE *fp) {
+    for (int i = 0; i < array_size(node->children); i++) {
+        Child *c = array_get(node->children, i);
+
+        int *index = smap_retrieve(node_index, c->type);
+        bool handles_child = traversal_node_handles[trav_index][*index];
+
+        if (!handles_child)
+            continue;
+        if (separate_edges(config))
+            out("       " TRAV_EDGE_FORMAT "(node, info);\n", node->id,
+                c->id, edge_kind_names[kind]);
+        else
+            out("       " TRAV_PREFIX "%s_%s(node, info);\n", node->id,
+                c->id);
+    }
+}
+
+static void generate_traversal_case(Config *config, Node *node, int index,
+                                    FILE *fp) {
+    Traversal *t = array_get(config->traversals, index);
+
+    // Skip nodes outside the scope of a scoped start, by the bit of
+    // NT_<Node> in it.
+    if (t->scoped) {
+        int type = *(int *)smap_retrieve(node_index, node->id);
+        out("       if (" TRAV_PREFIX "scope && !((" TRAV_PREFIX
+            "scope->bits[%d] >> %d) & 1))\n",
+            type / 8, type % 8);
+        out("           break;\n");
+    }
+
+    // Skip subtrees without changes since the previous run.
+    if (t->incremental)
+        out("       if (!" INCREMENTAL_PREFIX "visit(node)) break;\n");
+
+    if (traversal_handles_node(t, node)) {
+        out("       %s" TRAVERSAL_HANDLER_FORMAT "(node, info);\n",
+            t->rewrite ? "node = " : "", t->id, node->id);
+        generate_end_skip_children(fp);
+    } else {
+        generate_trav_node_children(config, node, index,
+                                    traversal_edge_kind(t), fp);
+    }
+}
+
+static void generate_fusion_case(Config *config, Node *node, int index,
+                                 FILE *fp) {
+    Fusion *f = array_get(config->fusions, index);
+    Traversal *handler = NULL;
+    int handler_index = 0;
+
+    // The members of a fusion handle disjoint sets of nodes, so at most one
+    // of them handles this node.
+    for (int j = 0; j < array_size(f->traversals); j++) {
+        Traversal *t = array_get(f->traversals, j);
+        if (traversal_handles_node(t, node)) {
+            handler = t;
+            handler_index = j;
+            break;
         }
-        out("       break;\n");
-        out("   }\n");
-        out("}\n\n");
     }
 
+    if (handler != NULL) {
+        out("       " TRAVERSAL_HANDLER_FORMAT "(node, " TRAV_PREFIX
+            "fused_info(%d));\n",
+            handler->id, node->id, handler_index);
+        generate_end_skip_children(fp);
+    } else {
+        generate_trav_node_children(config, node,
+                                    array_size(config->traversals) + index,
+                                    fusion_edge_kind(f), fp);
+    }
+}
+
+static bool inline_trav_child(Config *config, Node *node, Child *child) {
+    if (config->inline_limit == 0)
+        return false;
+
+    FILE *measure = out_measure_start();
+    generate_trav_child_kinds(config, node, child, measure, true);
+    generate_trav_child_body(config, node, child, measure);
+    return out_inline(config, out_measure_end(measure));
+}
+
+static bool inline_trav_children(Config *config, Node *node) {
+    for (int i = 0; i < array_size(node->children); i++) {
+        if (inline_trav_child(config, node, array_get(node->children, i)))
+            return true;
+    }
+    return false;
+}
+
+// Declare the traversal functions of the nodes in the children of a node.
+static void generate_child_trav_declarations(Node *node, FILE *fp) {
+    for (int i = 0; i < array_size(node->children); i++) {
+        Child *child = array_get(node->children, i);
+
+        if (child->node) {
+            out("struct %s *_" TRAV_PREFIX
+                "%s(struct %s *node, struct Info *info);\n",
+                child->type, child->type, child->type);
+        } else if (child->nodeset) {
+            for (int j = 0; j < array_size(child->nodeset->nodes); j++) {
+                Node *nodechild = array_get(child->nodeset->nodes, j);
+                out("struct %s *_" TRAV_PREFIX
+                    "%s(struct %s *node, struct Info *info);\n",
+                    nodechild->id, nodechild->id, nodechild->id);
+            }
+        }
+    }
+    out("\n");
+}
+
+static char *case_traversal_id(Config *config, int index) {
+    int num_traversals = array_size(config->traversals);
+
+    if (index < num_traversals)
+        return ((Traversal *)array_get(config->traversals, index))->id;
+    return ((Fusion *)array_get(config->fusions, index - num_traversals))->id;
+}
+
+static void generate_trav_node(Node *node, FILE *fp, Config *config,
+                               bool header) {
+
     for (int i = 0; i < array_size(node->children); ++i) {
         Child *child = (Child *)array_get(node->children, i);
+        bool inline_body = inline_trav_child(config, node, child);
+
+        // Inlined functions are defined in the header only.
+        if (inline_body && !header)
+            continue;
+
+        // The edges of the kinds of traversals go with the public edge, and
+        // are defined before the dispatch that calls them.
+        if (inline_body || !header)
+            generate_trav_child_kinds(config, node, child, fp, inline_body);
+        if (inline_body)
+            out("static inline ");
+        else if (!header)
+            out_layout_attribute(config, fp,
+                                 profile_node_visits(config, node->id));
         out("void " TRAV_PREFIX "%s_%s(struct %s *node, struct Info *info)",
             node->id, child->id, node->id);
 
-        if (header) {
+        if (header && !inline_body) {
             out(";\n");
         } else {
-            out(" {\n");
-            out("    if (!node) return;\n");
-            out("    void *orig_node_replacement = node_replacement;\n");
-            out("    node_replacement = NULL;\n");
-
-            if (child->node != NULL) {
-                // Child is a node
-                generate_node_child_node(node, child, fp);
-            } else if (child->nodeset != NULL) {
-                // Child is a nodeset
-                generate_node_child_nodeset(node, child, fp);
-            } else {
-                // Should not have passed the context analysis.
-                assert(0);
-            }
-            out("    node_replacement = orig_node_replacement;\n");
+            generate_trav_child_body(config, node, child, fp);
+        }
+    }
 
-            out("}\n\n");
+    if (!header) {
+        int num_traversals = array_size(config->traversals);
+        int num_cases = num_traversals + array_size(config->fusions);
+        DispatchCase *cases =
+            mem_alloc(sizeof(DispatchCase) * (num_cases + 1));
+
+        for (int i = 0; i < num_cases; i++) {
+            cases[i].index = i;
+            cases[i].visits =
+                profile_visits(config, case_traversal_id(config, i), node->id);
         }
+        int likely = order_cases(cases, num_cases);
+
+        out_layout_attribute(config, fp,
+                             profile_node_visits(config, node->id));
+        out("struct %s *_" TRAV_PREFIX
+            "%s(struct %s *node, struct Info *info) {\n",
+            node->id, node->id, node->id);
+        out("   if (!node) return node;\n");
+        out("#ifdef " PROFILE_MACRO "\n");
+        out("   TravProfileFrame profile_frame;\n");
+        out("   " PROFILE_PREFIX "enter(&profile_frame);\n");
+        out("#endif\n");
+        if (likely >= 0) {
+            out("   switch (" EXPECT_MACRO "(" TRAV_PREFIX
+                "current(), " TRAV_FORMAT ")) {\n",
+                case_traversal_id(config, likely));
+        } else {
+            out("   switch (" TRAV_PREFIX "current()) {\n");
+        }
+
+        for (int i = 0; i < num_cases; i++) {
+            int index = cases[i].index;
+            char *id = case_traversal_id(config, index);
+
+            out("   case " TRAV_FORMAT ":\n", id);
+            out_cold_label(fp, "   ", id, "", cases[i].visits);
+            if (index < num_traversals)
+                generate_traversal_case(config, node, index, fp);
+            else
+                generate_fusion_case(config, node, index - num_traversals,
+                                     fp);
+            out("       break;\n");
+        }
+        mem_free(cases);
+
+        out("   default:\n");
+        for (int i = 0; i < array_size(node->children); i++) {
+            Child *c = array_get(node->children, i);
+            out("       " TRAV_PREFIX "%s_%s(node, info);\n", node->id, c->id);
+        }
+        out("       break;\n");
+        out("   }\n");
+        out("#ifdef " PROFILE_MACRO "\n");
+        out("   " PROFILE_PREFIX "leave(&profile_frame, " NT_FORMAT ");\n",
+            node->id);
+        out("#endif\n");
+        out("   return node;\n");
+        out("}\n\n");
     }
+
 }
 
 void generate_trav_header(Config *config, FILE *fp) {
@@ -334,9 +1061,18 @@ void generate_trav_node_header(Config *config, FILE *fp, Node *node) {
 
     out("struct Info;\n");
 
+    // Inlined functions need the nodes and the functions they call.
+    if (inline_trav_children(config, node) ||
+        inline_replace_node(config, node)) {
+        out("#include \"lib/print.h\"\n");
+        out("#include \"generated/ast.h\"\n");
+        out_track_includes(config, fp);
+        generate_child_trav_declarations(node, fp);
+    }
+
     generate_trav_node(node, fp, config, true);
     generate_start_node(config, fp, true, node);
-    generate_replace_node(node, fp, true);
+    generate_replace_node(config, node, fp, true);
 }
 
 void generate_trav_node_definitions(Config *config, FILE *fp, Node *node) {
@@ -346,30 +1082,17 @@ void generate_trav_node_definitions(Config *config, FILE *fp, Node *node) {
     out("#include \"lib/print.h\"\n");
     out("#include \"generated/trav-%s.h\"\n", node->id);
     out("// generated/trav-core.h is included by my header.\n");
+    out_track_includes(config, fp);
 
-    out("extern " NT_ENUM_NAME " node_replacement_type;\n");
-    out("extern void *node_replacement;\n");
+    out("extern %s" NT_ENUM_NAME " node_replacement_type;\n",
+        out_thread_local(config));
+    out("extern %svoid *node_replacement;\n", out_thread_local(config));
     out("\n");
 
-    for (int i = 0; i < array_size(node->children); i++) {
-        Child *child = array_get(node->children, i);
-
-        if (child->node) {
-            out("void _" TRAV_PREFIX
-                "%s(struct %s *node, struct Info *info);\n",
-                child->type, child->type);
-        } else if (child->nodeset) {
-            for (int j = 0; j < array_size(child->nodeset->nodes); j++) {
-                Node *nodechild = array_get(child->nodeset->nodes, j);
-                out("void _" TRAV_PREFIX
-                    "%s(struct %s *node, struct Info *info);\n",
-                    nodechild->id, nodechild->id);
-            }
-        }
-    }
-    out("\n");
+    generate_child_trav_declarations(node, fp);
 
     generate_trav_node(node, fp, config, false);
+    generate_start_node_scope(config, fp, node);
     generate_start_node(config, fp, false, node);
-    generate_replace_node(node, fp, false);
+    generate_replace_node(config, node, fp, false);
 }
@@ -7,6 +7,29 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+// Handlers of a rewrite traversal return the node to store in the parent.
+static void generate_handler(Traversal *trav, char *node, FILE *fp) {
+    if (trav->rewrite)
+        out("%s *", node);
+    else
+        out("void ");
+    out(TRAVERSAL_HANDLER_FORMAT "(%s *node, Info *info);\n", trav->id, node,
+        node);
+}
+
+// The actions of rules are written by the user, the handlers are generated.
+static void generate_rule_actions(Config *config, Rules *rules, FILE *fp) {
+    for (int i = 0; i < array_size(rules->rules); i++) {
+        Rule *rule = array_get(rules->rules, i);
+        char *type = rule->pattern->type;
+        out("%s *" RULE_ACTION_FORMAT "(%s *node, Info *info);\n", type,
+            rules->id, rule->id, type);
+    }
+
+    out("%s *" RULES_RUN_FORMAT "(%s *node);\n", config->root_node->id,
+        rules->id, config->root_node->id);
+}
+
 void generate_user_trav_header(Config *config, FILE *fp, Traversal *trav) {
 
     out("#pragma once\n\n");
@@ -28,15 +51,16 @@ void generate_user_trav_header(Config *config, FILE *fp, Traversal *trav) {
     if (trav->nodes != NULL) {
         for (int i = 0; i < array_size(trav->nodes); i++) {
             char *node = array_get(trav->nodes, i);
-            out("void " TRAVERSAL_HANDLER_FORMAT "(%s *node, Info *info);\n",
-                trav->id, node, node);
+            generate_handler(trav, node, fp);
         }
 
     } else {
         for (int i = 0; i < array_size(config->nodes); i++) {
             Node *n = array_get(config->nodes, i);
-            out("void " TRAVERSAL_HANDLER_FORMAT "(%s *node, Info *info);\n",
-                trav->id, n->id, n->id);
+            generate_handler(trav, n->id, fp);
         }
     }
+
+    if (trav->rules != NULL)
+        generate_rule_actions(config, trav->rules, fp);
 }
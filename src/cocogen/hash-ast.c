@@ -1,4 +1,5 @@
 #include "cocogen/hash-ast.h"
+#include "cocogen/profile-ast.h"
 #include "cocogen/str-ast.h"
 
 #include "lib/errors.h"
@@ -31,7 +32,37 @@ static void set_hash(NodeCommonInfo *info, bool config) {
     }
 }
 
-static void hash_node(Node *n) {
+// The order of the dispatch in the traversal functions of a node follows the
+// visits of the node and of the nodes in its nodeset children.
+static void hash_node_profile(Node *n, Config *c) {
+    long visits;
+
+    for (int i = 0; i < array_size(c->traversals); ++i) {
+        Traversal *t = array_get(c->traversals, i);
+        visits = profile_visits(c, t->id, n->id);
+        mhash(td, &visits, sizeof(long));
+    }
+
+    for (int i = 0; i < array_size(c->fusions); ++i) {
+        Fusion *f = array_get(c->fusions, i);
+        visits = profile_visits(c, f->id, n->id);
+        mhash(td, &visits, sizeof(long));
+    }
+
+    for (int i = 0; i < array_size(n->children); ++i) {
+        Child *child = array_get(n->children, i);
+        if (child->nodeset == NULL)
+            continue;
+
+        for (int j = 0; j < array_size(child->nodeset->nodes); ++j) {
+            Node *node = array_get(child->nodeset->nodes, j);
+            visits = profile_node_visits(c, node->id);
+            mhash(td, &visits, sizeof(long));
+        }
+    }
+}
+
+static void hash_node(Node *n, Config *c) {
 
     td = mhash_init(MHASH_MD5);
     if (td == MHASH_FAILED) {
@@ -41,6 +72,17 @@ static void hash_node(Node *n) {
 
     hash(n->id, char);
     hash(n->root ? "y" : "n", char);
+    hash(c->incremental ? "y" : "n", char);
+    hash(c->parents ? "y" : "n", char);
+    hash(c->census ? "y" : "n", char);
+    hash(c->journal ? "y" : "n", char);
+    hash(c->presence ? "y" : "n", char);
+    hash(c->cycles ? "y" : "n", char);
+    hash(c->batch ? "y" : "n", char);
+    hash(c->parallel ? "y" : "n", char);
+    mhash(td, &c->inline_limit, sizeof(int));
+    if (c->profile != NULL)
+        hash_node_profile(n, c);
     for (int i = 0; i < array_size(n->children); ++i) {
         Child *child = array_get(n->children, i);
         hash(child->id, char);
@@ -57,6 +99,7 @@ static void hash_node(Node *n) {
         hash(attr->id, char);
         hash(str_attr_type(attr), char);
         hash(attr->construct ? "y" : "n", char);
+        hash(attr->column ? "y" : "n", char);
         if (attr->default_value) {
             AttrValue *val = attr->default_value;
 
@@ -85,11 +128,17 @@ static void hash_node(Node *n) {
             }
         }
     }
+
+    for (int i = 0; i < array_size(n->computed); ++i) {
+        Attr *attr = array_get(n->computed, i);
+        hash(attr->id, char);
+        hash(str_attr_type(attr), char);
+    }
     mhash_deinit(td, hash);
     set_hash(n->common_info, false);
 }
 
-static void hash_nodeset(Nodeset *nodeset) {
+static void hash_nodeset(Nodeset *nodeset, Config *c) {
     td = mhash_init(MHASH_MD5);
     if (td == MHASH_FAILED) {
         print_error(nodeset->id, "Error generating hashes.");
@@ -97,6 +146,7 @@ static void hash_nodeset(Nodeset *nodeset) {
     }
 
     hash(nodeset->id, char);
+    mhash(td, &c->inline_limit, sizeof(int));
 
     for (int i = 0; i < array_size(nodeset->nodes); ++i) {
         Node *node = array_get(nodeset->nodes, i);
@@ -107,6 +157,114 @@ static void hash_nodeset(Nodeset *nodeset) {
     set_hash(nodeset->common_info, false);
 }
 
+static void hash_attrval(AttrValue *val) {
+    switch (val->type) {
+    case AV_string:
+        hash(val->value.string_value, char);
+        break;
+    case AV_int:
+        mhash(td, &val->value.int_value, sizeof(int64_t));
+        break;
+    case AV_uint:
+        mhash(td, &val->value.uint_value, sizeof(uint64_t));
+        break;
+    case AV_float:
+        mhash(td, &val->value.float_value, sizeof(float));
+        break;
+    case AV_double:
+        mhash(td, &val->value.double_value, sizeof(double));
+        break;
+    case AV_bool:
+        hash(val->value.bool_value ? "y" : "n", char);
+        break;
+    case AV_id:
+        hash(val->value.string_value, char);
+        break;
+    }
+}
+
+// The matcher depends on the children and attributes of the matched nodes,
+// which are part of the hashes of the nodes.
+static void hash_pattern(Pattern *pattern, Config *c) {
+    hash(pattern->type, char);
+    if (pattern->node)
+        hash(pattern->node->common_info->hash, char);
+    else if (pattern->nodeset)
+        hash(pattern->nodeset->common_info->hash, char);
+    else
+        hash("nonterminal", char);
+
+    for (int i = 0; i < array_size(pattern->fields); ++i) {
+        PatternField *field = array_get(pattern->fields, i);
+        hash(field->id, char);
+        if (field->pattern) {
+            hash_pattern(field->pattern, c);
+        } else if (field->value) {
+            hash_attrval(field->value);
+        } else {
+            hash("NULL", char);
+        }
+
+        // Enum values are prefixed in the generated code.
+        if (field->attr && field->attr->type == AT_enum) {
+            for (int j = 0; j < array_size(c->enums); ++j) {
+                Enum *e = array_get(c->enums, j);
+                if (strcmp(e->id, field->attr->type_id) == 0)
+                    hash(e->prefix, char);
+            }
+        }
+    }
+}
+
+static void hash_rules(Rules *rules, Config *c) {
+    td = mhash_init(MHASH_MD5);
+    if (td == MHASH_FAILED) {
+        print_error(rules->id, "Error generating hashes.");
+        exit(HASH_ERROR);
+    }
+
+    hash(rules->id, char);
+    hash(c->root_node->id, char);
+    hash(c->cycles ? "y" : "n", char);
+    hash(c->batch ? "y" : "n", char);
+    hash(c->parallel ? "y" : "n", char);
+    for (int i = 0; i < array_size(rules->rules); ++i) {
+        Rule *rule = array_get(rules->rules, i);
+        hash(rule->id, char);
+        hash_pattern(rule->pattern, c);
+    }
+
+    mhash_deinit(td, hash);
+    set_hash(rules->common_info, false);
+}
+
+// The labeler visits the children of the matched nodes, and dispatches on
+// the nodes in the nodesets of the children.
+static void hash_tiles(Tiles *tiles, Config *c) {
+    td = mhash_init(MHASH_MD5);
+    if (td == MHASH_FAILED) {
+        print_error(tiles->id, "Error generating hashes.");
+        exit(HASH_ERROR);
+    }
+
+    hash(tiles->id, char);
+    for (int i = 0; i < array_size(tiles->rules); ++i) {
+        Rule *rule = array_get(tiles->rules, i);
+        hash(rule->id, char);
+        hash(rule->nonterminal, char);
+        mhash(td, &rule->cost, sizeof(uint64_t));
+        hash_pattern(rule->pattern, c);
+    }
+
+    for (int i = 0; i < array_size(c->nodesets); ++i) {
+        Nodeset *nodeset = array_get(c->nodesets, i);
+        hash(nodeset->common_info->hash, char);
+    }
+
+    mhash_deinit(td, hash);
+    set_hash(tiles->common_info, false);
+}
+
 static void hash_traversal(Traversal *trav) {
     td = mhash_init(MHASH_MD5);
     if (td == MHASH_FAILED) {
@@ -115,6 +273,9 @@ static void hash_traversal(Traversal *trav) {
     }
 
     hash(trav->id, char);
+    hash(trav->incremental ? "y" : "n", char);
+    hash(trav->rewrite ? "y" : "n", char);
+    hash(trav->readonly ? "y" : "n", char);
     if (trav->func)
         hash(trav->func ? "y" : "n", char);
 
@@ -123,6 +284,10 @@ static void hash_traversal(Traversal *trav) {
         hash(node, char);
     }
 
+    // The header declares the actions of the rules.
+    if (trav->rules)
+        hash(trav->rules->common_info->hash, char);
+
     mhash_deinit(td, hash);
     set_hash(trav->common_info, false);
 }
@@ -137,6 +302,9 @@ static void hash_phase(Phase *phase) {
     hash(phase->id, char);
     hash(phase->cycle ? "y" : "n", char);
     hash(phase->root ? "y" : "n", char);
+    hash(phase->fuse ? "y" : "n", char);
+    hash(phase->checkpoint ? "y" : "n", char);
+    hash(phase->parallel ? "y" : "n", char);
 
     for (int i = 0; i < array_size(phase->passes); ++i) {
         char *pass = array_get(phase->passes, i);
@@ -189,6 +357,8 @@ void hash_config(Config *c) {
     Node *node;
     Nodeset *nodeset;
     Traversal *trav;
+    Rules *rules;
+    Tiles *tiles;
     Phase *phase;
     Pass *pass;
     Enum *e;
@@ -201,14 +371,24 @@ void hash_config(Config *c) {
 
     for (int i = 0; i < array_size(c->nodes); ++i) {
         node = array_get(c->nodes, i);
-        hash_node(node);
+        hash_node(node, c);
         hashc(node->common_info->hash, char);
     }
     for (int i = 0; i < array_size(c->nodesets); ++i) {
         nodeset = array_get(c->nodesets, i);
-        hash_nodeset(nodeset);
+        hash_nodeset(nodeset, c);
         hashc(nodeset->common_info->hash, char);
     }
+    for (int i = 0; i < array_size(c->rules); ++i) {
+        rules = array_get(c->rules, i);
+        hash_rules(rules, c);
+        hashc(rules->common_info->hash, char);
+    }
+    for (int i = 0; i < array_size(c->tiles); ++i) {
+        tiles = array_get(c->tiles, i);
+        hash_tiles(tiles, c);
+        hashc(tiles->common_info->hash, char);
+    }
     for (int i = 0; i < array_size(c->traversals); ++i) {
         trav = array_get(c->traversals, i);
         hash_traversal(trav);
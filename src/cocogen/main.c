@@ -1,5 +1,6 @@
 #include <errno.h>
 #include <getopt.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,21 +14,35 @@
 #include "cocogen/create-ast.h"
 #include "cocogen/filegen-driver.h"
 #include "cocogen/free-ast.h"
+#include "cocogen/fuse-ast.h"
 #include "cocogen/hash-ast.h"
 #include "cocogen/print-ast.h"
+#include "cocogen/profile-ast.h"
 #include "cocogen/sort-ast.h"
 
 #include "cocogen/gen-ast-definition.h"
 #include "cocogen/gen-binary-serialization.h"
+#include "cocogen/gen-census-functions.h"
+#include "cocogen/gen-presence-functions.h"
+#include "cocogen/gen-column-functions.h"
+#include "cocogen/gen-computed-functions.h"
 #include "cocogen/gen-consistency-functions.h"
 #include "cocogen/gen-copy-functions.h"
 #include "cocogen/gen-create-functions.h"
+#include "cocogen/gen-cursor-functions.h"
 #include "cocogen/gen-dot-definition.h"
 #include "cocogen/gen-free-functions.h"
+#include "cocogen/gen-incremental-functions.h"
+#include "cocogen/gen-journal-functions.h"
+#include "cocogen/gen-mutate-functions.h"
+#include "cocogen/gen-parent-functions.h"
 #include "cocogen/gen-pass-header.h"
 #include "cocogen/gen-phase-driver.h"
+#include "cocogen/gen-reach-functions.h"
+#include "cocogen/gen-rules-functions.h"
 #include "cocogen/gen-serialization-headers.h"
 #include "cocogen/gen-textual-serialization.h"
+#include "cocogen/gen-tiles-functions.h"
 #include "cocogen/gen-trav-core-functions.h"
 #include "cocogen/gen-trav-functions.h"
 #include "cocogen/gen-user-trav-header.h"
@@ -54,6 +69,35 @@ static void usage(char *program) {
            "would be (re)generated,\n");
     printf("                               but does not actually modify any "
            "files.\n");
+    printf("  --parent-pointers            Give every node a pointer to its "
+           "parent.\n");
+    printf("  --census                     Keep an index of all live nodes "
+           "per type.\n");
+    printf("  --presence                   Count the live nodes per type and "
+           "skip traversals\n");
+    printf("                               of which no node type is "
+           "present.\n");
+    printf("  --journal                    Log mutations of the AST, so that "
+           "they can be\n");
+    printf("                               rolled back.\n");
+    printf("  --batch                      Generate phasedriver_run_batch, "
+           "which runs the\n");
+    printf("                               phases on many trees in "
+           "parallel.\n");
+    printf("  --checkpoints                Generate phasedriver_run_cached, "
+           "which resumes the\n");
+    printf("                               phases from the tree written "
+           "after a phase.\n");
+    printf("  --cycle-limit <n>            Stop a cycle phase after <n> "
+           "iterations, 100 by\n");
+    printf("                               default.\n");
+    printf("  --inline <lines>             Define generated functions of at "
+           "most <lines> lines\n");
+    printf("                               static inline in the headers.\n");
+    printf("  --profile <file>             Order the traversal dispatch on "
+           "the visit counts\n");
+    printf("                               in <file>, written by "
+           "trav_profile_dump.\n");
     printf("  --verbose/-v                 Enable verbose mode.\n");
     printf("  --dot <directory>            Will produce ast.dot in "
            "<directory>.\n");
@@ -91,6 +135,25 @@ static FILE *open_input_file(char *path) {
     return f;
 }
 
+// Parse the integer argument of a numeric option, which has to be at least
+// min. Returns false after printing an error when it is not.
+static bool parse_limit(char *option, char *arg, int min, int *limit) {
+    char *end;
+    errno = 0;
+    long value = strtol(arg, &end, 10);
+
+    if (end == arg || *end != '\0' || errno == ERANGE || value < min ||
+        value > INT_MAX) {
+        print_error_no_loc("%s: invalid value '%s', expected an integer of "
+                           "at least %d.",
+                           option, arg, min);
+        return false;
+    }
+
+    *limit = value;
+    return true;
+}
+
 void exit_compile_error(void) {
     PRINT_COLOR(MAGENTA);
     fprintf(stderr, "Errors where found, code generation terminated.\n");
@@ -101,19 +164,37 @@ void exit_compile_error(void) {
 int main(int argc, char *argv[]) {
     int verbose_flag = 0;
     int list_gen_files_flag = 0;
+    int parent_pointers_flag = 0;
+    int census_flag = 0;
+    int presence_flag = 0;
+    int batch_flag = 0;
+    int checkpoints_flag = 0;
+    int journal_flag = 0;
     int ret = 0;
     int option_index;
     int c = 0;
     char *header_dir = NULL;
     char *source_dir = NULL;
     char *dot_dir = NULL;
+    char *profile_file = NULL;
+    int inline_limit = 0;
+    int cycle_limit = 0;
 
     struct option long_options[] = {
         {"verbose", no_argument, &verbose_flag, 1},
         {"header-dir", required_argument, 0, 21},
         {"source-dir", required_argument, 0, 22},
         {"list-gen-files", no_argument, &list_gen_files_flag, 1},
+        {"parent-pointers", no_argument, &parent_pointers_flag, 1},
+        {"census", no_argument, &census_flag, 1},
+        {"presence", no_argument, &presence_flag, 1},
+        {"batch", no_argument, &batch_flag, 1},
+        {"checkpoints", no_argument, &checkpoints_flag, 1},
+        {"journal", no_argument, &journal_flag, 1},
         {"dot", required_argument, 0, 23},
+        {"profile", required_argument, 0, 24},
+        {"inline", required_argument, 0, 25},
+        {"cycle-limit", required_argument, 0, 26},
         {"help", no_argument, 0, 'h'},
         {"version", no_argument, 0, 20},
         {0, 0, 0, 0}};
@@ -141,6 +222,17 @@ int main(int argc, char *argv[]) {
         case 23: // ast.dot output directory.
             dot_dir = optarg;
             break;
+        case 24: // Visit counts of a profile run.
+            profile_file = optarg;
+            break;
+        case 25: // Size up to which functions are inlined.
+            if (!parse_limit("--inline", optarg, 0, &inline_limit))
+                return 1;
+            break;
+        case 26: // Iterations after which a cycle phase stops.
+            if (!parse_limit("--cycle-limit", optarg, 1, &cycle_limit))
+                return 1;
+            break;
         case 'h':
             usage(argv[0]);
             return 0;
@@ -172,9 +264,55 @@ int main(int argc, char *argv[]) {
         exit_compile_error();
     }
 
+    if (parent_pointers_flag)
+        parse_result->parents = true;
+    if (census_flag)
+        parse_result->census = true;
+    if (presence_flag)
+        parse_result->presence = true;
+    if (batch_flag)
+        parse_result->batch = true;
+    if (checkpoints_flag)
+        parse_result->checkpoints = true;
+
+    // The index and the counts of live nodes are shared by all trees.
+    if (parse_result->batch &&
+        (parse_result->census || parse_result->presence)) {
+        print_error_no_loc("--batch cannot be combined with --census or "
+                           "--presence.");
+        exit_compile_error();
+    }
+
+    // The binary serialization writes the checkpoints with global state.
+    if (parse_result->batch && parse_result->checkpoints) {
+        print_error_no_loc("--batch cannot be combined with checkpoints.");
+        exit_compile_error();
+    }
+    if (journal_flag)
+        parse_result->journal = true;
+    if (inline_limit > 0)
+        parse_result->inline_limit = inline_limit;
+    if (cycle_limit > 0)
+        parse_result->cycle_limit = cycle_limit;
+
+    // The steps of a parallel phase would share the index, the counts of
+    // live nodes, the log of mutations and the epoch of incremental
+    // traversals, which computed attributes use as well.
+    if (parse_result->parallel &&
+        (parse_result->census || parse_result->presence ||
+         parse_result->journal || parse_result->incremental)) {
+        print_error_no_loc("Parallel phases cannot be combined with --census, "
+                           "--presence, --journal, incremental traversals "
+                           "or computed attributes.");
+        exit_compile_error();
+    }
+
     // Sort to prevent changes in order of attributes trigger regeneration of
     // code.
     sort_config(parse_result);
+    fuse_config(parse_result);
+    if (profile_file)
+        profile_config(parse_result, profile_file);
     hash_config(parse_result);
 
     if (verbose_flag) {
@@ -210,14 +348,36 @@ int main(int argc, char *argv[]) {
     filegen_all_nodes("copy-%s.h", generate_copy_node_header);
     filegen_all_nodesets("copy-%s.h", generate_copy_nodeset_header);
 
+    filegen_generate("mutate-ast.h", generate_mutate_header);
+    filegen_all_nodes("mutate-%s.h", generate_mutate_node_header);
+
+    if (parse_result->parents)
+        filegen_generate("parent.h", generate_parent_header);
+    if (parse_result->census)
+        filegen_generate("census.h", generate_census_header);
+    if (parse_result->presence)
+        filegen_generate("presence.h", generate_presence_header);
+    if (parse_result->journal)
+        filegen_generate("journal.h", generate_journal_header);
+    if (parse_result->columns)
+        filegen_generate("columns.h", generate_column_header);
+    if (parse_result->incremental)
+        filegen_generate("incremental.h", generate_incremental_header);
+    if (parse_result->computed)
+        filegen_generate("computed.h", generate_computed_header);
+
+    filegen_generate("reach.h", generate_reach_header);
+    filegen_generate("cursor.h", generate_cursor_header);
+
     filegen_generate("trav-ast.h", generate_trav_header);
     filegen_generate("trav-core.h", generate_trav_core_header);
     filegen_all_nodes("trav-%s.h", generate_trav_node_header);
-    // filegen_generate("consistency-ast.h", generate_consistency_header);
+    filegen_generate("consistency-ast.h", generate_consistency_header);
     filegen_generate("phase-driver.h", generate_phase_driver_header);
 
     filegen_all_traversals("traversal-%s.h", generate_user_trav_header);
     filegen_all_passes("pass-%s.h", generate_pass_header);
+    filegen_all_tiles("tiles-%s.h", generate_tiles_header);
 
     filegen_generate("binary-serialization-util.h",
                      generate_binary_serialization_util_header);
@@ -248,10 +408,32 @@ int main(int argc, char *argv[]) {
     filegen_all_nodes("copy-%s.c", generate_copy_node_definitions);
     filegen_all_nodesets("copy-%s.c", generate_copy_nodeset_definitions);
 
+    filegen_all_nodes("mutate-%s.c", generate_mutate_node_definitions);
+
+    if (parse_result->parents)
+        filegen_generate("parent.c", generate_parent_definitions);
+    if (parse_result->census)
+        filegen_generate("census.c", generate_census_definitions);
+    if (parse_result->presence)
+        filegen_generate("presence.c", generate_presence_definitions);
+    if (parse_result->journal)
+        filegen_generate("journal.c", generate_journal_definitions);
+    if (parse_result->columns)
+        filegen_generate("columns.c", generate_column_definitions);
+    if (parse_result->incremental)
+        filegen_generate("incremental.c", generate_incremental_definitions);
+    if (parse_result->computed)
+        filegen_generate("computed.c", generate_computed_definitions);
+
+    filegen_generate("reach.c", generate_reach_definitions);
+    filegen_generate("cursor.c", generate_cursor_definitions);
+
     /* filegen_generate("trav-ast.c", generate_trav_definitions); */
     filegen_generate("trav-core.c", generate_trav_core_definitions);
     filegen_all_nodes("trav-%s.c", generate_trav_node_definitions);
-    // filegen_generate("consistency-ast.c", generate_consistency_definitions);
+    filegen_all_rules("rules-%s.c", generate_rules_definitions);
+    filegen_all_tiles("tiles-%s.c", generate_tiles_definitions);
+    filegen_generate("consistency-ast.c", generate_consistency_definitions);
     filegen_generate("phase-driver.c", generate_phase_driver_definitions);
 
     filegen_generate("binary-serialization-util.c",
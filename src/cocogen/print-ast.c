@@ -13,10 +13,16 @@
 #define IND5 IND IND IND IND IND
 
 static void print_phase(Phase *phase) {
+    if (phase->fuse)
+        printf("fuse ");
     if (phase->root)
         printf("root ");
     if (phase->cycle)
         printf("cycle ");
+    if (phase->checkpoint)
+        printf("checkpoint ");
+    if (phase->parallel)
+        printf("parallel ");
 
     printf("phase %s {\n", phase->id);
 
@@ -67,7 +73,45 @@ static void print_pass(Pass *pass) {
     }
 }
 
+static void print_attrval(AttrValue *value) {
+    switch (value->type) {
+    case AV_string:
+        printf("\"%s\"", value->value.string_value);
+        break;
+    case AV_id:
+        printf("%s", value->value.string_value);
+        break;
+    case AV_int:
+        printf("%" PRId64, value->value.int_value);
+        break;
+    case AV_uint:
+        printf("%" PRIu64, value->value.uint_value);
+        break;
+    case AV_float:
+        printf("%f", value->value.float_value);
+        break;
+    case AV_double:
+        printf("%f", value->value.double_value);
+        break;
+    case AV_bool:
+        printf(value->value.bool_value ? "true" : "false");
+        break;
+    }
+}
+
 static void print_traversal(Traversal *traversal) {
+    // The traversal of rules is printed as the rules.
+    if (traversal->rules != NULL)
+        return;
+
+    if (traversal->incremental)
+        printf("incremental ");
+    if (traversal->rewrite)
+        printf("rewrite ");
+    if (traversal->readonly)
+        printf("readonly ");
+    if (traversal->scoped)
+        printf("scoped ");
     printf("traversal %s", traversal->id);
     if (traversal->nodes == NULL)
         printf(";\n\n");
@@ -85,6 +129,65 @@ static void print_traversal(Traversal *traversal) {
     }
 }
 
+static void print_pattern(Pattern *pattern) {
+    printf("%s", pattern->type);
+    if (pattern->fields == NULL)
+        return;
+
+    printf("(");
+    for (int i = 0; i < array_size(pattern->fields); i++) {
+        PatternField *field = array_get(pattern->fields, i);
+        if (i > 0)
+            printf(", ");
+
+        printf("%s = ", field->id);
+        if (field->pattern != NULL)
+            print_pattern(field->pattern);
+        else if (field->value != NULL)
+            print_attrval(field->value);
+        else
+            printf("NULL");
+    }
+    printf(")");
+}
+
+static void print_rules(Rules *rules) {
+    printf("rules %s {\n", rules->id);
+    if (rules->info)
+        printf(IND "info = \"%s\",\n", rules->info);
+
+    int num_rules = array_size(rules->rules);
+    for (int i = 0; i < num_rules; i++) {
+        Rule *rule = array_get(rules->rules, i);
+        printf(IND "rule %s = ", rule->id);
+        print_pattern(rule->pattern);
+        if (i < num_rules - 1)
+            printf(",\n");
+        else
+            printf("\n");
+    }
+    printf("};\n\n");
+}
+
+static void print_tiles(Tiles *tiles) {
+    printf("tiles %s {\n", tiles->id);
+    if (tiles->info)
+        printf(IND "info = \"%s\",\n", tiles->info);
+
+    int num_rules = array_size(tiles->rules);
+    for (int i = 0; i < num_rules; i++) {
+        Rule *rule = array_get(tiles->rules, i);
+        printf(IND "rule %s : %s = ", rule->id, rule->nonterminal);
+        print_pattern(rule->pattern);
+        printf(" cost %" PRIu64, rule->cost);
+        if (i < num_rules - 1)
+            printf(",\n");
+        else
+            printf("\n");
+    }
+    printf("};\n\n");
+}
+
 static void print_enum(Enum *attr_enum) {
     printf("enum %s {\n", attr_enum->id);
     printf(IND "prefix = %s,\n", attr_enum->prefix);
@@ -218,30 +321,19 @@ static void print_attr(Attr *a) {
     if (a->default_value != NULL) {
 
         printf(" = ");
+        print_attrval(a->default_value);
+        if (a->column)
+            printf(" { column }");
+        return;
+    }
 
-        switch (a->default_value->type) {
-        case AV_string:
-            printf("\"%s\"", a->default_value->value.string_value);
-            break;
-        case AV_id:
-            printf("%s", a->default_value->value.string_value);
-            break;
-        case AV_int:
-            printf("%" PRId64, a->default_value->value.int_value);
-            break;
-        case AV_uint:
-            printf("%" PRIu64, a->default_value->value.uint_value);
-            break;
-        case AV_float:
-            printf("%f", a->default_value->value.float_value);
-            break;
-        case AV_double:
-            printf("%f", a->default_value->value.double_value);
-            break;
-        case AV_bool:
-            printf(a->default_value->value.bool_value ? "true" : "false");
-            break;
-        }
+    if (a->column) {
+        printf(a->construct ? " { constructor, column }" : " { column }");
+        return;
+    }
+
+    if (a->computed) {
+        printf(" { computed }");
         return;
     }
 
@@ -279,15 +371,19 @@ static void print_node(Node *node) {
         previous_block = 1;
     }
 
-    if (node->attrs) {
+    if (node->attrs || node->computed) {
         if (previous_block)
             printf(",\n");
 
         printf(IND "attributes {\n");
 
-        int num_attrs = array_size(node->attrs);
+        // The computed attributes follow the others after checking the ast.
+        int num_set = array_size(node->attrs);
+        int num_attrs = num_set + array_size(node->computed);
         for (int i = 0; i < num_attrs; i++) {
-            Attr *attr = array_get(node->attrs, i);
+            Attr *attr = i < num_set
+                             ? array_get(node->attrs, i)
+                             : array_get(node->computed, i - num_set);
             print_attr(attr);
             if (i < num_attrs - 1)
                 printf(",\n");
@@ -314,6 +410,14 @@ void print_config(Config *config) {
         print_traversal(array_get(config->traversals, i));
     }
 
+    for (int i = 0; i < array_size(config->rules); i++) {
+        print_rules(array_get(config->rules, i));
+    }
+
+    for (int i = 0; i < array_size(config->tiles); i++) {
+        print_tiles(array_get(config->tiles, i));
+    }
+
     for (int i = 0; i < array_size(config->enums); i++) {
         print_enum(array_get(config->enums, i));
     }
@@ -0,0 +1,88 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cocogen/ast.h"
+#include "cocogen/profile-ast.h"
+
+#include "lib/errors.h"
+#include "lib/memory.h"
+#include "lib/print.h"
+#include "lib/smap.h"
+
+#define PROFILE_HEADER "traversal,node,visits,cycles"
+
+// Key of the visits of a node type in a traversal, or of the total visits of
+// a node type when traversal is NULL. Identifiers cannot contain a slash.
+static char *profile_key(char *traversal, char *node) {
+    static char key[512];
+    snprintf(key, sizeof(key), "%s/%s", traversal ? traversal : "", node);
+    return key;
+}
+
+static void add_visits(Config *config, char *key, long visits) {
+    long *count = smap_retrieve(config->profile, key);
+    if (count == NULL) {
+        count = mem_alloc(sizeof(long));
+        *count = 0;
+        smap_insert(config->profile, key, count);
+    }
+    *count += visits;
+}
+
+// Read the visit counts written by trav_profile_dump. Rows of traversals and
+// node types which are no longer in the config are ignored.
+void profile_config(Config *config, char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        print_error_no_loc("%s: cannot open file: %s", filename,
+                           strerror(errno));
+        exit(CANNOT_OPEN_FILE);
+    }
+
+    config->profile = smap_init(64);
+
+    char line[1024];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        lineno++;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (line[0] == '\0' ||
+            (lineno == 1 && strcmp(line, PROFILE_HEADER) == 0))
+            continue;
+
+        char *traversal = strtok(line, ",");
+        char *node = strtok(NULL, ",");
+        char *visits = strtok(NULL, ",");
+        char *end = NULL;
+        long count = visits != NULL ? strtol(visits, &end, 10) : -1;
+
+        if (node == NULL || end == visits || count < 0) {
+            print_error_no_loc("%s:%d: expected a row of the form '%s'.",
+                               filename, lineno, PROFILE_HEADER);
+            fclose(fp);
+            exit(INVALID_CONFIG);
+        }
+
+        add_visits(config, profile_key(traversal, node), count);
+        add_visits(config, profile_key(NULL, node), count);
+    }
+
+    fclose(fp);
+}
+
+// The visits of a node type in a traversal, or -1 without a profile.
+long profile_visits(Config *config, char *traversal, char *node) {
+    if (config->profile == NULL)
+        return -1;
+
+    long *count = smap_retrieve(config->profile, profile_key(traversal, node));
+    return count != NULL ? *count : 0;
+}
+
+// The visits of a node type in all traversals, or -1 without a profile.
+long profile_node_visits(Config *config, char *node) {
+    return profile_visits(config, NULL, node);
+}
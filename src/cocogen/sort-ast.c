@@ -45,6 +45,8 @@ static int compare_strings(const void *n1, const void *n2) {
 static void sort_node(Node *n) {
     if (n->attrs)
         array_sort(n->attrs, compare_attributes);
+    if (n->computed)
+        array_sort(n->computed, compare_attributes);
     if (n->children)
         array_sort(n->children, compare_children);
 }
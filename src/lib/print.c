@@ -11,6 +11,11 @@ static char *yy_filename;
 static array *yy_lines;
 static imap_t *yy_parser_locations;
 
+// Stream of the messages of print_user_error in this thread, stderr if NULL,
+// and the number of messages printed.
+static _Thread_local FILE *user_stream;
+static _Thread_local int user_errors;
+
 static void print_header(char *header) {
     if (header) {
         PRINT_COLOR(BOLD MAGENTA);
@@ -208,6 +213,21 @@ void print_note_no_loc(char *format, ...) {
 }
 
 void print_user_error(char *header, const char *format, ...) {
+    user_errors++;
+
+    va_list ap;
+    va_start(ap, format);
+
+    if (user_stream != NULL) {
+        if (header)
+            fprintf(user_stream, "[%s] ", header);
+        fprintf(user_stream, "error: ");
+        vfprintf(user_stream, format, ap);
+        fprintf(user_stream, "\n");
+        va_end(ap);
+        return;
+    }
+
     print_header(header);
 
     PRINT_COLOR(BOLD RED);
@@ -218,8 +238,15 @@ void print_user_error(char *header, const char *format, ...) {
 
     PRINT_COLOR(RESET_COLOR);
 
-    va_list ap;
-    va_start(ap, format);
     vfprintf(stderr, format, ap);
     fprintf(stderr, "\n");
+    va_end(ap);
+}
+
+void print_user_stream(FILE *fp) {
+    user_stream = fp;
+}
+
+int print_user_errors(void) {
+    return user_errors;
 }
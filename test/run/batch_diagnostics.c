@@ -0,0 +1,84 @@
+// Runs a traversal reporting errors on many trees with the batch
+// phasedriver. The errors of every tree have to be collected in its own
+// result, whichever thread ran it.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "generated/ast.h"
+#include "generated/create-ast.h"
+#include "generated/free-ast.h"
+#include "generated/phase-driver.h"
+#include "generated/traversal-Check.h"
+#include "lib/print.h"
+
+#define UNITS 16
+
+Info *Check_createinfo(void) { return NULL; }
+void Check_freeinfo(Info *info) {}
+void Check_Num(Num *node, Info *info) {
+    if (node->value < 0)
+        print_user_error("check", "negative %d", node->value);
+}
+
+// Unit i has i % 4 negative numbers, -(100 * i + 1) and on.
+static Program *create_unit(int i) {
+    Expr *expr = create_Expr_Num(create_Num(1));
+
+    for (int j = 0; j < i % 4; j++) {
+        Expr *num = create_Expr_Num(create_Num(-(100 * i + j + 1)));
+        expr = create_Expr_BinOp(create_BinOp(expr, num));
+    }
+    return create_Program(expr);
+}
+
+static int check_result(int i, PhaseUnitResult *result) {
+    int found = 0;
+
+    for (char *msg = result->diagnostics; msg != NULL;
+         msg = strchr(msg + 1, '\n')) {
+        char *negative = strstr(msg, "negative -");
+        int value;
+        if (negative == NULL ||
+            sscanf(negative, "negative -%d", &value) != 1)
+            break;
+        if ((value - 1) / 100 != i) {
+            fprintf(stderr, "unit %d has the error of number -%d\n", i,
+                    value);
+            return 1;
+        }
+        found++;
+    }
+
+    if (result->errors == i % 4 && found == i % 4 &&
+        (found > 0 || result->diagnostics == NULL))
+        return 0;
+    fprintf(stderr, "unit %d: %d errors and %d messages, expected %d\n", i,
+            result->errors, found, i % 4);
+    return 1;
+}
+
+int main(void) {
+    Program *units[UNITS];
+    PhaseUnitResult results[UNITS];
+    int errors = 0;
+
+    for (int i = 0; i < UNITS; i++)
+        units[i] = create_unit(i);
+
+    phasedriver_run_batch(units, UNITS, 4, results);
+
+    for (int i = 0; i < UNITS; i++) {
+        errors += check_result(i, &results[i]);
+        free(results[i].diagnostics);
+        free_Program_tree(units[i]);
+    }
+
+    // The messages of the batch are not counted for the calling thread.
+    if (print_user_errors() != 0) {
+        fprintf(stderr, "%d errors counted for the calling thread\n",
+                print_user_errors());
+        errors++;
+    }
+    return errors;
+}
@@ -0,0 +1,72 @@
+// Runs an incremental traversal with the batch phasedriver. Every tree has
+// to be visited completely on its first run, and a tree run by one thread
+// and changed by another has to see the change.
+#include <pthread.h>
+#include <stdio.h>
+
+#include "generated/ast.h"
+#include "generated/create-ast.h"
+#include "generated/free-ast.h"
+#include "generated/mutate-ast.h"
+#include "generated/phase-driver.h"
+#include "generated/traversal-Count.h"
+
+#define UNITS 4
+
+static int visits = 0;
+
+Info *Count_createinfo(void) { return NULL; }
+void Count_freeinfo(Info *info) {}
+void Count_Num(Num *node, Info *info) {
+    __atomic_add_fetch(&visits, 1, __ATOMIC_RELAXED);
+}
+
+static int check(char *name, int expected) {
+    if (visits == expected)
+        return 0;
+    fprintf(stderr, "%s: %d nodes visited, expected %d\n", name, visits,
+            expected);
+    return 1;
+}
+
+// Runs the phases on a tree many times, so that the epochs of this thread
+// get ahead of the ones of the main thread.
+static void *run_often(void *unit) {
+    for (int i = 0; i < 10; i++)
+        phasedriver_run(unit);
+    return NULL;
+}
+
+int main(void) {
+    Program *units[UNITS];
+    int errors = 0;
+
+    for (int i = 0; i < UNITS; i++) {
+        units[i] = create_Program(create_Expr_BinOp(
+            create_BinOp(create_Expr_Num(create_Num(i)),
+                         create_Expr_Num(create_Num(i + 1)))));
+    }
+
+    visits = 0;
+    phasedriver_run_batch(units, UNITS, 1, NULL);
+    errors += check("first run", 2 * UNITS);
+
+    visits = 0;
+    phasedriver_run_batch(units, UNITS, 2, NULL);
+    errors += check("unchanged", 0);
+
+    pthread_t thread;
+    visits = 0;
+    pthread_create(&thread, NULL, run_often, units[0]);
+    pthread_join(thread, NULL);
+    errors += check("unchanged on another thread", 0);
+
+    visits = 0;
+    set_Num_value(units[0]->expr->value.val_BinOp->left->value.val_Num, 7);
+    phasedriver_run(units[0]);
+    errors += check("changed after another thread", 1);
+
+    for (int i = 0; i < UNITS; i++)
+        free_Program_tree(units[i]);
+    return errors;
+}
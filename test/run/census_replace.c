@@ -0,0 +1,100 @@
+// Replaces nodes with replace_<Node> and with a rewrite traversal, in node
+// and nodeset children. The replaced nodes have to leave the census, whether
+// the handler frees them or not.
+#include <stdio.h>
+
+#include "generated/ast.h"
+#include "generated/census.h"
+#include "generated/create-ast.h"
+#include "generated/free-ast.h"
+#include "generated/phase-driver.h"
+#include "generated/trav-ast.h"
+#include "generated/traversal-Bump.h"
+#include "generated/traversal-Double.h"
+#include "generated/traversal-Fold.h"
+
+static Num *replaced[8];
+static int num_replaced = 0;
+
+Info *Fold_createinfo(void) { return NULL; }
+void Fold_freeinfo(Info *info) {}
+void Fold_BinOp(BinOp *node, Info *info) {
+    trav_BinOp_left(node, info);
+    trav_BinOp_right(node, info);
+    if (node->left->type == NS_Expr_Num && node->right->type == NS_Expr_Num)
+        replace_Num(create_Num(node->left->value.val_Num->value +
+                               node->right->value.val_Num->value));
+}
+
+// Frees the replaced node in the handler.
+Info *Bump_createinfo(void) { return NULL; }
+void Bump_freeinfo(Info *info) {}
+void Bump_Num(Num *node, Info *info) {
+    replace_Num(create_Num(node->value + 1));
+    free_Num_tree(node);
+}
+
+// Keeps the replaced node, which is freed after the phases.
+Info *Double_createinfo(void) { return NULL; }
+void Double_freeinfo(Info *info) {}
+Num *Double_Num(Num *node, Info *info) {
+    replaced[num_replaced++] = node;
+    return create_Num(node->value * 2);
+}
+
+static int check(NodeType type, int expected) {
+    if (census_size(type) == expected)
+        return 0;
+    fprintf(stderr, "%d live nodes of type %d, expected %d\n",
+            census_size(type), type, expected);
+    return 1;
+}
+
+static bool in_census(NodeType type, void *node) {
+    for (int i = 0; i < census_size(type); i++) {
+        if (census_nodes(type)[i] == node)
+            return true;
+    }
+    return false;
+}
+
+int main(void) {
+    // (1 + 2) + -3
+    Expr *sum = create_Expr_BinOp(create_BinOp(
+        create_Expr_Num(create_Num(1)), create_Expr_Num(create_Num(2))));
+    Expr *neg = create_Expr_Neg(create_Neg(create_Num(3)));
+    Program *program =
+        create_Program(create_Expr_BinOp(create_BinOp(sum, neg)));
+    int errors = 0;
+
+    // The inner sum is folded, and the old one is kept to free it later.
+    BinOp *folded = sum->value.val_BinOp;
+    phasedriver_run(program);
+
+    // 8 + -8
+    BinOp *root = program->expr->value.val_BinOp;
+    Num *left = root->left->value.val_Num;
+    Num *operand = root->right->value.val_Neg->operand;
+    if (left->value != 8 || operand->value != 8)
+        errors++;
+
+    errors += check(NT_BinOp, 1);
+    errors += check(NT_Neg, 1);
+    errors += check(NT_Num, 4);
+    if (in_census(NT_BinOp, folded) || !in_census(NT_Num, left) ||
+        !in_census(NT_Num, operand))
+        errors++;
+
+    // Detached nodes are not removed again when they are freed.
+    for (int i = 0; i < num_replaced; i++)
+        free_Num_tree(replaced[i]);
+    free_BinOp_tree(folded);
+    errors += check(NT_BinOp, 1);
+    errors += check(NT_Num, 2);
+
+    free_Program_tree(program);
+    errors += check(NT_BinOp, 0);
+    errors += check(NT_Neg, 0);
+    errors += check(NT_Num, 0);
+    return errors;
+}
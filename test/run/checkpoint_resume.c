@@ -0,0 +1,85 @@
+// Runs the phases twice on the same input tree. The second run has to
+// resume from the checkpoint written by the first, instead of running the
+// passes again.
+#include <stdio.h>
+
+#include "generated/ast.h"
+#include "generated/create-ast.h"
+#include "generated/free-ast.h"
+#include "generated/pass-Bind.h"
+#include "generated/pass-Flatten.h"
+#include "generated/phase-driver.h"
+#include "generated/traversal-Check.h"
+#include "generated/traversal-Fold.h"
+
+static int bind_runs = 0;
+static int flatten_runs = 0;
+
+Info *Check_createinfo(void) { return NULL; }
+void Check_freeinfo(Info *info) {}
+void Check_Program(Program *node, Info *info) {
+    trav_Program_stmts(node, info);
+}
+void Check_Stmt(Stmt *node, Info *info) { trav_Stmt_next(node, info); }
+
+Info *Fold_createinfo(void) { return NULL; }
+void Fold_freeinfo(Info *info) {}
+void Fold_Program(Program *node, Info *info) {
+    trav_Program_stmts(node, info);
+}
+void Fold_Stmt(Stmt *node, Info *info) {
+    node->value *= 10;
+    trav_Stmt_next(node, info);
+}
+
+Program *pass_Bind_entry(Program *syntaxtree) {
+    bind_runs++;
+    syntaxtree->stmts->value += 1;
+    return syntaxtree;
+}
+
+Program *pass_Flatten_entry(Program *syntaxtree) {
+    flatten_runs++;
+    syntaxtree->stmts->value += 2;
+    return syntaxtree;
+}
+
+static Program *input(void) {
+    Program *program = create_Program();
+    program->stmts = create_Stmt(1);
+    program->stmts->next = create_Stmt(5);
+    return program;
+}
+
+static int check(Program *program, int bind, int flatten) {
+    if (program->stmts->value == 40 && program->stmts->next->value == 50 &&
+        program->stmts->next->next == NULL && bind_runs == bind &&
+        flatten_runs == flatten)
+        return 0;
+
+    fprintf(stderr, "values %d %d, Bind ran %d times, Flatten %d times\n",
+            program->stmts->value, program->stmts->next->value, bind_runs,
+            flatten_runs);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    int errors = 0;
+
+    Program *first = phasedriver_run_cached(input(), argv[1]);
+    errors += check(first, 1, 1);
+
+    // Resumes after the last phase, and frees the new input tree.
+    Program *second = phasedriver_run_cached(input(), argv[1]);
+    errors += check(second, 1, 1);
+
+    // Resumes after Analysis.
+    phasedriver_start_from(phasedriver_phase("Lower"));
+    Program *third = phasedriver_run_cached(input(), argv[1]);
+    errors += check(third, 1, 2);
+
+    free_Program_tree(first);
+    free_Program_tree(second);
+    free_Program_tree(third);
+    return errors;
+}
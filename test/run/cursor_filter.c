@@ -0,0 +1,59 @@
+// Counts the nodes a cursor returns, without a filter and filtered on a node
+// type and on a nodeset.
+#include <stdio.h>
+
+#include "generated/ast.h"
+#include "generated/create-ast.h"
+#include "generated/cursor.h"
+#include "generated/free-ast.h"
+#include "generated/traversal-Print.h"
+
+Info *Print_createinfo(void) { return NULL; }
+void Print_freeinfo(Info *info) {}
+void Print_Program(Program *node, Info *info) {}
+void Print_BinOp(BinOp *node, Info *info) {}
+void Print_Neg(Neg *node, Info *info) {}
+void Print_Num(Num *node, Info *info) {}
+
+static int count(Program *program, bool post_order, bool filtered,
+                 NodeType filter, int expected) {
+    Cursor cursor;
+    int nodes = 0;
+
+    cursor_init(&cursor, program, NT_Program, post_order);
+    if (filtered)
+        cursor_filter(&cursor, filter);
+
+    NodeType type;
+    while (cursor_next(&cursor, &type) != NULL) {
+        if (filtered && type != filter && filter != NT_Expr)
+            return 1;
+        nodes++;
+    }
+    cursor_free(&cursor);
+
+    if (nodes == expected)
+        return 0;
+    fprintf(stderr, "%d nodes, expected %d\n", nodes, expected);
+    return 1;
+}
+
+int main(void) {
+    // (1 + 2) + -3
+    Expr *sum = create_Expr_BinOp(create_BinOp(
+        create_Expr_Num(create_Num(1)), create_Expr_Num(create_Num(2))));
+    Expr *neg = create_Expr_Neg(create_Neg(create_Num(3)));
+    Program *program =
+        create_Program(create_Expr_BinOp(create_BinOp(sum, neg)));
+    int errors = 0;
+
+    for (int post_order = 0; post_order < 2; post_order++) {
+        errors += count(program, post_order, false, NT_Program, 7);
+        errors += count(program, post_order, true, NT_Num, 3);
+        errors += count(program, post_order, true, NT_Neg, 1);
+        errors += count(program, post_order, true, NT_Expr, 6);
+    }
+
+    free_Program_tree(program);
+    return errors;
+}
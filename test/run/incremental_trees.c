@@ -0,0 +1,58 @@
+// Runs an incremental traversal on two trees. Each tree keeps the epochs of
+// its own runs, so the first run visits the whole tree even when the other
+// tree was traversed after it was created.
+#include <stdio.h>
+
+#include "generated/ast.h"
+#include "generated/copy-ast.h"
+#include "generated/create-ast.h"
+#include "generated/free-ast.h"
+#include "generated/mutate-ast.h"
+#include "generated/phase-driver.h"
+#include "generated/traversal-Count.h"
+
+static int visits = 0;
+
+Info *Count_createinfo(void) { return NULL; }
+void Count_freeinfo(Info *info) {}
+void Count_Num(Num *node, Info *info) { visits++; }
+
+static Program *create_sum(int left, int right) {
+    return create_Program(create_Expr_BinOp(create_BinOp(
+        create_Expr_Num(create_Num(left)),
+        create_Expr_Num(create_Num(right)))));
+}
+
+static int run(Program *program, char *name, int expected) {
+    visits = 0;
+    phasedriver_run(program);
+    if (visits == expected)
+        return 0;
+    fprintf(stderr, "%s: %d nodes visited, expected %d\n", name, visits,
+            expected);
+    return 1;
+}
+
+int main(void) {
+    Program *a = create_sum(1, 2);
+    Program *b = create_sum(3, 4);
+    int errors = 0;
+
+    errors += run(a, "first run of a", 2);
+    errors += run(b, "first run of b", 2);
+    errors += run(a, "unchanged a", 0);
+
+    // Only the path to the changed node is visited.
+    set_Num_value(b->expr->value.val_BinOp->right->value.val_Num, 5);
+    errors += run(b, "changed b", 1);
+    errors += run(a, "unchanged a after b", 0);
+
+    // A copy is a new tree.
+    Program *c = copy_Program(a);
+    errors += run(c, "copy of a", 2);
+
+    free_Program_tree(a);
+    free_Program_tree(b);
+    free_Program_tree(c);
+    return errors;
+}
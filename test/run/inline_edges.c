@@ -0,0 +1,111 @@
+// Runs a normal, a rewrite and a readonly traversal through child edges
+// that are defined inline in the headers.
+#include <stdio.h>
+#include <string.h>
+
+#include "generated/ast.h"
+#include "generated/create-ast.h"
+#include "generated/free-ast.h"
+#include "generated/phase-driver.h"
+#include "generated/trav-ast.h"
+#include "generated/traversal-Fold.h"
+#include "generated/traversal-Print.h"
+#include "generated/traversal-Rename.h"
+
+static BinOp *folded[8];
+static int num_folded = 0;
+static int printed = 0;
+
+// x is renamed to z.
+Info *Rename_createinfo(void) { return NULL; }
+void Rename_freeinfo(Info *info) {}
+void Rename_Var(Var *node, Info *info) {
+    if (strcmp(node->name, "x") == 0)
+        node->name[0] = 'z';
+}
+
+// A sum of two numbers is replaced by a number.
+Info *Fold_createinfo(void) { return NULL; }
+void Fold_freeinfo(Info *info) {}
+BinOp *Fold_BinOp(BinOp *node, Info *info) {
+    trav_BinOp_left(node, info);
+    trav_BinOp_right(node, info);
+    if (node->left->type == NS_Expr_Num &&
+        node->right->type == NS_Expr_Num) {
+        folded[num_folded++] = node;
+        replace_Num(create_Num(node->left->value.val_Num->value +
+                               node->right->value.val_Num->value));
+    }
+    return node;
+}
+
+// Counts the nodes, through the default case of the dispatch.
+Info *Print_createinfo(void) { return NULL; }
+void Print_freeinfo(Info *info) {}
+void Print_Program(Program *node, Info *info) {
+    printed++;
+    trav_Program_stmts(node, info);
+}
+void Print_StmtList(StmtList *node, Info *info) {
+    printed++;
+    trav_StmtList_stmt(node, info);
+    trav_StmtList_next(node, info);
+}
+void Print_Assign(Assign *node, Info *info) {
+    printed++;
+    trav_Assign_var(node, info);
+    trav_Assign_expr(node, info);
+}
+void Print_Return(Return *node, Info *info) {
+    printed++;
+    trav_Return_expr(node, info);
+}
+void Print_BinOp(BinOp *node, Info *info) {
+    printed++;
+    trav_BinOp_left(node, info);
+    trav_BinOp_right(node, info);
+}
+void Print_Num(Num *node, Info *info) { printed++; }
+void Print_Var(Var *node, Info *info) { printed++; }
+
+static Expr *num(int value) { return create_Expr_Num(create_Num(value)); }
+
+int main(void) {
+    // x = (1 + 2) + 3; return x;
+    Expr *sum = create_Expr_BinOp(create_BinOp(
+        create_Expr_BinOp(create_BinOp(num(1), num(2))), num(3)));
+    Stmt *assign =
+        create_Stmt_Assign(create_Assign(sum, create_Var(strdup("x"))));
+    Return *ret = create_Return();
+    ret->expr = create_Expr_Var(create_Var(strdup("x")));
+    StmtList *stmts = create_StmtList(assign);
+    stmts->next = create_StmtList(create_Stmt_Return(ret));
+    Program *program = create_Program(stmts);
+    int errors = 0;
+
+    phasedriver_run(program);
+
+    // z = 6; return z;
+    Assign *folded_assign = stmts->stmt->value.val_Assign;
+    if (strcmp(folded_assign->var->name, "z") != 0 ||
+        ret->expr->type != NS_Expr_Var ||
+        strcmp(ret->expr->value.val_Var->name, "z") != 0) {
+        fprintf(stderr, "not renamed\n");
+        errors++;
+    }
+    if (folded_assign->expr->type != NS_Expr_Num ||
+        folded_assign->expr->value.val_Num->value != 6) {
+        fprintf(stderr, "not folded\n");
+        errors++;
+    }
+    // Program, 2 StmtList, Assign, Return, 2 Var and a Num.
+    if (printed != 8) {
+        fprintf(stderr, "printed %d nodes, expected 8\n", printed);
+        errors++;
+    }
+
+    for (int i = 0; i < num_folded; i++)
+        free_BinOp_tree(folded[i]);
+    free_Program_tree(program);
+    return errors;
+}
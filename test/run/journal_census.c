@@ -0,0 +1,99 @@
+// Replaces nodes in a transaction and rolls it back. The replaced nodes have
+// to be back in the census, and the replacements out of it.
+#include <stdio.h>
+
+#include "generated/ast.h"
+#include "generated/census.h"
+#include "generated/create-ast.h"
+#include "generated/free-ast.h"
+#include "generated/journal.h"
+#include "generated/trav-ast.h"
+#include "generated/traversal-Double.h"
+#include "generated/traversal-Negate.h"
+
+static void *created[4];
+static int num_created = 0;
+
+Info *Double_createinfo(void) { return NULL; }
+void Double_freeinfo(Info *info) {}
+Num *Double_Num(Num *node, Info *info) {
+    Num *res = create_Num(node->value * 2);
+    created[num_created++] = res;
+    return res;
+}
+
+// Changes the type of the node in the nodeset child.
+Info *Negate_createinfo(void) { return NULL; }
+void Negate_freeinfo(Info *info) {}
+void Negate_Num(Num *node, Info *info) {
+    Neg *res = create_Neg(create_Num(node->value));
+    created[num_created++] = res;
+    replace_Neg(res);
+}
+
+static bool in_census(NodeType type, void *node) {
+    for (int i = 0; i < census_size(type); i++) {
+        if (census_nodes(type)[i] == node)
+            return true;
+    }
+    return false;
+}
+
+static int check(char *name, NodeType type, int expected) {
+    if (census_size(type) == expected)
+        return 0;
+    fprintf(stderr, "%s: %d live nodes of type %d, expected %d\n", name,
+            census_size(type), type, expected);
+    return 1;
+}
+
+int main(void) {
+    Num *one = create_Num(1);
+    Num *two = create_Num(2);
+    BinOp *sum = create_BinOp(create_Expr_Num(one), create_Expr_Num(two));
+    Program *program = create_Program(create_Expr_BinOp(sum));
+    int errors = 0;
+
+    tx_begin();
+    program = trav_start_Program(program, TRAV_Double);
+    tx_rollback();
+    if (sum->left->value.val_Num != one || sum->right->value.val_Num != two)
+        errors++;
+    if (!in_census(NT_Num, one) || !in_census(NT_Num, two) ||
+        in_census(NT_Num, created[0]) || in_census(NT_Num, created[1]))
+        errors++;
+    errors += check("rolled back rewrite", NT_Num, 2);
+    for (int i = 0; i < num_created; i++)
+        free_Num_tree(created[i]);
+    errors += check("freed replacements", NT_Num, 2);
+
+    num_created = 0;
+    tx_begin();
+    program = trav_start_Program(program, TRAV_Negate);
+    tx_rollback();
+    if (sum->left->type != NS_Expr_Num || sum->left->value.val_Num != one)
+        errors++;
+    if (!in_census(NT_Num, one) || !in_census(NT_Num, two))
+        errors++;
+    errors += check("rolled back replace", NT_Neg, 0);
+    for (int i = 0; i < num_created; i++)
+        free_Neg_tree(created[i]);
+    errors += check("freed replacements", NT_Num, 2);
+
+    // A committed rewrite keeps the replacements in the census.
+    num_created = 0;
+    tx_begin();
+    program = trav_start_Program(program, TRAV_Double);
+    tx_commit();
+    if (in_census(NT_Num, one) || in_census(NT_Num, two) ||
+        !in_census(NT_Num, created[0]) || !in_census(NT_Num, created[1]))
+        errors++;
+    free_Num_tree(one);
+    free_Num_tree(two);
+    errors += check("committed rewrite", NT_Num, 2);
+
+    free_Program_tree(program);
+    errors += check("freed tree", NT_BinOp, 0);
+    errors += check("freed tree", NT_Num, 0);
+    return errors;
+}
@@ -0,0 +1,96 @@
+// Changes a tree in transactions with set_<Node>_<field>, the list functions
+// and a rewrite traversal, and rolls them back. The fields and the parents
+// have to be restored, also after a nested transaction was committed.
+#include <stdio.h>
+#include <string.h>
+
+#include "generated/ast.h"
+#include "generated/create-ast.h"
+#include "generated/free-ast.h"
+#include "generated/journal.h"
+#include "generated/mutate-ast.h"
+#include "generated/parent.h"
+#include "generated/trav-ast.h"
+#include "generated/traversal-Fold.h"
+
+static void *created = NULL;
+
+// A sum of two numbers is replaced by a number.
+Info *Fold_createinfo(void) { return NULL; }
+void Fold_freeinfo(Info *info) {}
+BinOp *Fold_BinOp(BinOp *node, Info *info) {
+    if (node->left->type == NS_Expr_Num &&
+        node->right->type == NS_Expr_Num) {
+        created = create_Num(node->left->value.val_Num->value +
+                             node->right->value.val_Num->value);
+        replace_Num(created);
+    }
+    return node;
+}
+
+static int expect(char *what, int ok) {
+    if (ok)
+        return 0;
+    fprintf(stderr, "%s\n", what);
+    return 1;
+}
+
+int main(void) {
+    // x = 1 + 2;
+    Num *one = create_Num(1);
+    BinOp *sum =
+        create_BinOp(create_Expr_Num(one), create_Expr_Num(create_Num(2)));
+    Assign *assign = create_Assign(create_Expr_BinOp(sum),
+                                   create_Var(strdup("x")));
+    StmtList *stmts = create_StmtList(create_Stmt_Assign(assign));
+    Program *program = create_Program(stmts);
+    int errors = 0;
+
+    tx_begin();
+    errors += expect("no open transaction", tx_active());
+    set_Num_value(one, 5);
+    tx_rollback();
+    errors += expect("set not undone", one->value == 1);
+    errors += expect("transaction still open", !tx_active());
+
+    // A committed nested transaction is undone with the enclosing one.
+    StmtList *ret = create_StmtList(create_Stmt_Return(create_Return()));
+    tx_begin();
+    set_Num_value(one, 7);
+    tx_begin();
+    list_StmtList_next_insert_after(stmts, ret);
+    tx_commit();
+    errors += expect("insert not done", stmts->next == ret &&
+                                            parent_of(ret) == stmts);
+    tx_rollback();
+    errors += expect("nested set not undone", one->value == 1);
+    errors += expect("insert not undone", stmts->next == NULL);
+    errors += expect("parent of insert not undone",
+                     parent_of(ret) == NULL && parent_slot(ret) == CS_NULL);
+    free_StmtList_tree(ret);
+
+    // The replacement of a rewrite traversal.
+    tx_begin();
+    trav_start_Program(program, TRAV_Fold);
+    errors += expect("not folded", assign->expr->type == NS_Expr_Num &&
+                                       assign->expr->value.val_Num == created);
+    tx_rollback();
+    errors += expect("fold not undone",
+                     assign->expr->type == NS_Expr_BinOp &&
+                         assign->expr->value.val_BinOp == sum);
+    errors += expect("parent of fold not undone",
+                     parent_of(sum) == assign &&
+                         parent_slot(sum) == CS_Assign_expr);
+    free_Num_tree(created);
+
+    // Committed changes stay, and a rollback without a transaction does
+    // nothing.
+    tx_begin();
+    set_Num_value(one, 9);
+    tx_commit();
+    tx_rollback();
+    errors += expect("commit undone", one->value == 9);
+
+    free_Program_tree(program);
+    return errors;
+}
@@ -0,0 +1,103 @@
+// Checks the parent pointers set by the constructors, by set_<Node>_<child>,
+// by copy_<Node>, and by replacing nodes with replace_<Node> and with a
+// rewrite traversal.
+#include <stdio.h>
+
+#include "generated/ast.h"
+#include "generated/copy-ast.h"
+#include "generated/create-ast.h"
+#include "generated/free-ast.h"
+#include "generated/mutate-ast.h"
+#include "generated/parent.h"
+#include "generated/phase-driver.h"
+#include "generated/trav-ast.h"
+#include "generated/traversal-Double.h"
+#include "generated/traversal-Fold.h"
+
+static BinOp *folded = NULL;
+
+// A sum of two numbers is replaced by a number.
+Info *Fold_createinfo(void) { return NULL; }
+void Fold_freeinfo(Info *info) {}
+void Fold_BinOp(BinOp *node, Info *info) {
+    trav_BinOp_left(node, info);
+    trav_BinOp_right(node, info);
+    if (node->left->type == NS_Expr_Num &&
+        node->right->type == NS_Expr_Num) {
+        folded = node;
+        replace_Num(create_Num(node->left->value.val_Num->value +
+                               node->right->value.val_Num->value));
+    }
+}
+
+// Every number is replaced by a new number with twice its value.
+Info *Double_createinfo(void) { return NULL; }
+void Double_freeinfo(Info *info) {}
+Num *Double_Num(Num *node, Info *info) {
+    Num *res = create_Num(node->value * 2);
+    free_Num_tree(node);
+    return res;
+}
+
+static int check(char *what, void *node, void *parent, ChildSlot slot) {
+    if (parent_of(node) == parent && parent_slot(node) == slot)
+        return 0;
+    fprintf(stderr, "%s: parent %p slot %d, expected %p slot %d\n", what,
+            parent_of(node), parent_slot(node), parent, slot);
+    return 1;
+}
+
+int main(void) {
+    // (1 + 2) + -3
+    BinOp *sum = create_BinOp(create_Expr_Num(create_Num(1)),
+                              create_Expr_Num(create_Num(2)));
+    Num *three = create_Num(3);
+    Neg *neg = create_Neg(three);
+    BinOp *root =
+        create_BinOp(create_Expr_BinOp(sum), create_Expr_Neg(neg));
+    Program *program = create_Program(create_Expr_BinOp(root));
+    int errors = 0;
+
+    errors += check("program", program, NULL, CS_NULL);
+    errors += check("root", root, program, CS_Program_expr);
+    errors += check("sum", sum, root, CS_BinOp_left);
+    errors += check("neg", neg, root, CS_BinOp_right);
+    errors += check("3", three, neg, CS_Neg_operand);
+    if (parent_type(neg) != NT_BinOp ||
+        parent_find(three, NT_Program) != program ||
+        parent_find(three, NT_Num) != NULL) {
+        fprintf(stderr, "parent_type or parent_find of a leaf\n");
+        errors++;
+    }
+
+    // A copy has parents of its own.
+    Program *copy = copy_Program(program);
+    BinOp *copy_root = copy->expr->value.val_BinOp;
+    errors += check("copy", copy_root, copy, CS_Program_expr);
+    errors += check("copy of neg", copy_root->right->value.val_Neg, copy_root,
+                    CS_BinOp_right);
+    free_Program_tree(copy);
+
+    // 6 + -6
+    phasedriver_run(program);
+    if (root->left->type != NS_Expr_Num || root->right->type != NS_Expr_Neg) {
+        fprintf(stderr, "not folded\n");
+        return errors + 1;
+    }
+    Num *left = root->left->value.val_Num;
+    Num *operand = root->right->value.val_Neg->operand;
+    if (left->value != 6 || operand->value != 6)
+        errors++;
+    errors += check("folded sum", left, root, CS_BinOp_left);
+    errors += check("doubled operand", operand, neg, CS_Neg_operand);
+
+    // set_<Node>_<child> stores a new operand.
+    Num *moved = create_Num(4);
+    set_Neg_operand(neg, moved);
+    errors += check("set", moved, neg, CS_Neg_operand);
+
+    free_Num_tree(operand);
+    free_BinOp_tree(folded);
+    free_Program_tree(program);
+    return errors;
+}
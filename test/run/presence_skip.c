@@ -0,0 +1,51 @@
+// A traversal of Neg nodes is skipped while the program has no Neg node, and
+// runs again once one is created.
+#include <stdio.h>
+
+#include "generated/ast.h"
+#include "generated/create-ast.h"
+#include "generated/free-ast.h"
+#include "generated/phase-driver.h"
+#include "generated/trav-ast.h"
+#include "generated/traversal-CountNeg.h"
+
+static int infos = 0;
+static int negs = 0;
+
+Info *CountNeg_createinfo(void) {
+    infos++;
+    return NULL;
+}
+void CountNeg_freeinfo(Info *info) {}
+void CountNeg_Neg(Neg *node, Info *info) { negs++; }
+
+static int check(char *when, int expect_infos, int expect_negs) {
+    if (infos == expect_infos && negs == expect_negs)
+        return 0;
+    fprintf(stderr, "%s: %d runs and %d Neg visits, expected %d and %d\n",
+            when, infos, negs, expect_infos, expect_negs);
+    return 1;
+}
+
+int main(void) {
+    Program *program = create_Program(create_Expr_Num(create_Num(1)));
+    int errors = 0;
+
+    phasedriver_run(program);
+    errors += check("without Neg", 0, 0);
+
+    // -1 replaces 1.
+    free_Expr_tree(program->expr);
+    program->expr = create_Expr_Neg(create_Neg(create_Num(1)));
+    phasedriver_run(program);
+    errors += check("with Neg", 1, 1);
+
+    // Skipped again once the Neg is freed.
+    free_Expr_tree(program->expr);
+    program->expr = create_Expr_Num(create_Num(1));
+    phasedriver_run(program);
+    errors += check("after freeing the Neg", 1, 1);
+
+    free_Program_tree(program);
+    return errors;
+}
@@ -0,0 +1,73 @@
+// Calls replace_<Node> in the handlers of a rewrite traversal before the
+// children of the node are traversed. The replacement has to be stored in
+// the child that holds the node, not in one of its own children.
+#include <stdio.h>
+
+#include "generated/ast.h"
+#include "generated/create-ast.h"
+#include "generated/free-ast.h"
+#include "generated/phase-driver.h"
+#include "generated/trav-ast.h"
+#include "generated/traversal-Fold.h"
+
+static BinOp *replaced_sum = NULL;
+static Neg *replaced_neg = NULL;
+
+Info *Fold_createinfo(void) { return NULL; }
+void Fold_freeinfo(Info *info) {}
+
+// 0 + n is replaced by n, which changes the type in a nodeset child.
+BinOp *Fold_BinOp(BinOp *node, Info *info) {
+    if (node->left->type == NS_Expr_Num &&
+        node->left->value.val_Num->value == 0 &&
+        node->right->type == NS_Expr_Num) {
+        replaced_sum = node;
+        replace_Num(create_Num(node->right->value.val_Num->value));
+    }
+    trav_BinOp_left(node, info);
+    trav_BinOp_right(node, info);
+    return node;
+}
+
+// -n is replaced by the negated number, before the node child of the Neg is
+// traversed.
+Neg *Fold_Neg(Neg *node, Info *info) {
+    replaced_neg = node;
+    replace_Num(create_Num(-node->operand->value));
+    trav_Neg_operand(node, info);
+    return node;
+}
+
+int main(void) {
+    // (0 + 5) + -3
+    Expr *sum = create_Expr_BinOp(create_BinOp(
+        create_Expr_Num(create_Num(0)), create_Expr_Num(create_Num(5))));
+    Expr *neg = create_Expr_Neg(create_Neg(create_Num(3)));
+    Program *program =
+        create_Program(create_Expr_BinOp(create_BinOp(sum, neg)));
+    int errors = 0;
+
+    phasedriver_run(program);
+
+    // 5 + -3
+    BinOp *root = program->expr->value.val_BinOp;
+    if (program->expr->type != NS_Expr_BinOp ||
+        root->left->type != NS_Expr_Num || root->right->type != NS_Expr_Num) {
+        fprintf(stderr, "replacement stored in the wrong child\n");
+        return 1;
+    }
+    if (root->left->value.val_Num->value != 5 ||
+        root->right->value.val_Num->value != -3)
+        errors++;
+
+    // The replaced nodes keep their own children.
+    if (replaced_sum->left->value.val_Num->value != 0 ||
+        replaced_sum->right->value.val_Num->value != 5 ||
+        replaced_neg->operand->value != 3)
+        errors++;
+
+    free_BinOp_tree(replaced_sum);
+    free_Neg_tree(replaced_neg);
+    free_Program_tree(program);
+    return errors;
+}
@@ -0,0 +1,83 @@
+// Folds (2 * 3 + 0) - --7 with rules. The rules on a subtraction or addition
+// of a negation rewrite the node in place and return it, which has to count
+// as a rewrite, so that the node is matched again.
+#include <stdio.h>
+
+#include "generated/ast.h"
+#include "generated/create-ast.h"
+#include "generated/free-ast.h"
+#include "generated/phase-driver.h"
+#include "generated/trav-ast.h"
+#include "generated/traversal-Fold.h"
+
+static BinOp *folded[8];
+static int num_folded = 0;
+
+BinOp *Fold_FoldConst(BinOp *node, Info *info) {
+    int left = node->left->value.val_Num->value;
+    int right = node->right->value.val_Num->value;
+
+    switch (node->op) {
+    case BO_add:
+        replace_Num(create_Num(left + right));
+        break;
+    case BO_sub:
+        replace_Num(create_Num(left - right));
+        break;
+    case BO_mul:
+        replace_Num(create_Num(left * right));
+        break;
+    }
+    folded[num_folded++] = node;
+    return node;
+}
+
+// The operand of the negation becomes the right child of the node.
+static void drop_neg(BinOp *node) {
+    Expr *neg = node->right;
+
+    node->right = neg->value.val_Neg->operand;
+    free_Expr_node(neg);
+}
+
+// a - -b is rewritten in place to a + b.
+BinOp *Fold_SubNeg(BinOp *node, Info *info) {
+    drop_neg(node);
+    node->op = BO_add;
+    return node;
+}
+
+// a + -b is rewritten in place to a - b.
+BinOp *Fold_AddNeg(BinOp *node, Info *info) {
+    drop_neg(node);
+    node->op = BO_sub;
+    return node;
+}
+
+static Expr *num(int value) { return create_Expr_Num(create_Num(value)); }
+
+int main(void) {
+    Expr *mul = create_Expr_BinOp(create_BinOp(num(2), num(3), BO_mul));
+    Expr *add = create_Expr_BinOp(create_BinOp(mul, num(0), BO_add));
+    Expr *negneg = create_Expr_Neg(create_Neg(create_Expr_Neg(
+        create_Neg(num(7)))));
+    Program *program =
+        create_Program(create_Expr_BinOp(create_BinOp(add, negneg, BO_sub)));
+    int errors = 0;
+
+    phasedriver_run(program);
+
+    if (program->expr->type != NS_Expr_Num) {
+        fprintf(stderr, "not folded to a number\n");
+        errors++;
+    } else if (program->expr->value.val_Num->value != -1) {
+        fprintf(stderr, "folded to %d, expected -1\n",
+                program->expr->value.val_Num->value);
+        errors++;
+    }
+
+    for (int i = 0; i < num_folded; i++)
+        free_BinOp_tree(folded[i]);
+    free_Program_tree(program);
+    return errors;
+}
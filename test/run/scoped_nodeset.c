@@ -0,0 +1,84 @@
+// Counts the nodes a scoped traversal visits, scoped on a node type and on a
+// nodeset. A nodeset stands for the types of its nodes. A traversal that is
+// not scoped cannot be started scoped.
+#include <stdio.h>
+
+#include "generated/ast.h"
+#include "generated/create-ast.h"
+#include "generated/free-ast.h"
+#include "generated/reach.h"
+#include "generated/trav-ast.h"
+#include "generated/traversal-Plain.h"
+#include "generated/traversal-Visit.h"
+#include "lib/print.h"
+
+static int visits[NT_Expr + 1];
+
+Info *Visit_createinfo(void) { return NULL; }
+void Visit_freeinfo(Info *info) {}
+void Visit_Program(Program *node, Info *info) {
+    visits[NT_Program]++;
+    trav_Program_expr(node, info);
+}
+void Visit_BinOp(BinOp *node, Info *info) {
+    visits[NT_BinOp]++;
+    trav_BinOp_left(node, info);
+    trav_BinOp_right(node, info);
+}
+void Visit_Neg(Neg *node, Info *info) {
+    visits[NT_Neg]++;
+    trav_Neg_operand(node, info);
+}
+void Visit_Num(Num *node, Info *info) { visits[NT_Num]++; }
+
+Info *Plain_createinfo(void) { return NULL; }
+void Plain_freeinfo(Info *info) {}
+void Plain_Num(Num *node, Info *info) { visits[NT_Num]++; }
+
+static int count(Program *program, NodeType type, int binops, int negs,
+                 int nums) {
+    TypeMask types;
+    typemask_clear(&types);
+    typemask_add(&types, type);
+    for (int i = 0; i <= NT_Expr; i++)
+        visits[i] = 0;
+
+    trav_start_scoped_Program(program, TRAV_Visit, &types);
+
+    if (visits[NT_BinOp] == binops && visits[NT_Neg] == negs &&
+        visits[NT_Num] == nums)
+        return 0;
+    fprintf(stderr,
+            "scope %d: %d BinOp, %d Neg, %d Num, expected %d, %d, %d\n",
+            type, visits[NT_BinOp], visits[NT_Neg], visits[NT_Num], binops,
+            negs, nums);
+    return 1;
+}
+
+int main(void) {
+    // (1 + 2) + -3
+    Expr *sum = create_Expr_BinOp(create_BinOp(
+        create_Expr_Num(create_Num(1)), create_Expr_Num(create_Num(2))));
+    Expr *neg = create_Expr_Neg(create_Neg(create_Num(3)));
+    Program *program =
+        create_Program(create_Expr_BinOp(create_BinOp(sum, neg)));
+    int errors = 0;
+
+    errors += count(program, NT_Num, 2, 1, 3);
+    errors += count(program, NT_BinOp, 2, 0, 0);
+    errors += count(program, NT_Expr, 2, 1, 3);
+
+    TypeMask types;
+    typemask_clear(&types);
+    typemask_add(&types, NT_Num);
+    visits[NT_Num] = 0;
+    trav_start_scoped_Program(program, TRAV_Plain, &types);
+    if (visits[NT_Num] != 0 || print_user_errors() != 1) {
+        fprintf(stderr, "Plain started scoped: %d Num, %d errors\n",
+                visits[NT_Num], print_user_errors());
+        errors++;
+    }
+
+    free_Program_tree(program);
+    return errors;
+}
@@ -40,7 +40,8 @@ function check_return {
         cmd=$BIN
     fi
 
-    if $cmd $CFLAGS $file --header-dir ./test/generated_out/ \
+    if $cmd $CFLAGS $(cat ${file%.ast}.flags 2>/dev/null) $file \
+        --header-dir ./test/generated_out/ \
         --source-dir ./test/generated_out/ > tmp.out 2>&1
     then
         if [ $expect_failure -eq 1 ]; then
@@ -71,6 +72,40 @@ function check_return {
     rm -f tmp.out
 }
 
+# Functional tests, generate the code for a specification, compile it with a
+# program using it and check if the program returns 0
+function check_run {
+    file=$1
+    name=${file%.ast}
+    out=./test/generated_run
+
+    total_tests=$((total_tests+1))
+    printf "%-${ALIGN}s " $file:
+
+    rm -rf $out
+    mkdir -p $out/include/generated $out/src $out/cache
+
+    if $BIN $CFLAGS $(cat $name.flags 2>/dev/null) $file \
+        --header-dir $out/include/generated/ --source-dir $out/src/ \
+        > tmp.out 2>&1 &&
+        ${CC-cc} -std=gnu11 -pthread -I $out/include -I ./include -o $out/run \
+        $name.c $(ls $out/src/*.c | grep -v textual-serialization) \
+        src/lib/*.c src/framework/serialization-bin-read.c >> tmp.out 2>&1 &&
+        $out/run $out/cache >> tmp.out 2>&1
+    then
+        echo_pass
+    else
+        echo_fail
+        echo -------------------------------
+        cat tmp.out
+        echo -------------------------------
+        echo
+        fail_tests=$((fail_tests+1))
+    fi
+
+    rm -rf tmp.out $out
+}
+
 function run_dir {
     BASE=$1
 
@@ -81,6 +116,10 @@ function run_dir {
     for f in $BASE/fail/*.ast; do
         check_return $f 1
     done
+
+    for f in $BASE/run/*.ast; do
+        if [ -f $f ]; then check_run $f; fi
+    done
 }
 
 if [ $VALGRIND -eq 1 ]; then